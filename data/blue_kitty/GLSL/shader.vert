@@ -1,18 +1,18 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// The normal is octahedral encoded, see BKVK::pack_normal.
 layout(location = 0) in vec3 in_position;
-layout(location = 1) in vec3 in_normal;
-layout(location = 2) in vec3 in_color;
-layout(location = 3) in vec2 in_texture_coord;
+layout(location = 1) in vec2 in_normal;
+layout(location = 2) in vec2 in_texture_coord;
 
 layout(location = 0) out vec3 frag_color;
 layout(location = 1) out vec2 frag_texture_coord;
+layout(location = 2) flat out uint frag_texture_index;
 
-layout(set = 0, binding = 0) uniform UBOModelInstance
-{
-  mat4 model[128];
-} ubo_model_instance;
+// Set by the pipeline for QuantizedVertex, positions are then unorm16
+// relative to the bounds of the geometry.
+layout(constant_id = 0) const bool quantized_positions = false;
 
 layout(set = 1, binding = 0) uniform UBOViewProjection
 {
@@ -20,11 +20,35 @@ layout(set = 1, binding = 0) uniform UBOViewProjection
   mat4 proj;
 } ubo_view_projection;
 
+// Every instance drawn in the frame, each draw starts at its instance_base.
+layout(set = 1, binding = 1) readonly buffer Instances
+{
+  mat4 model[];
+} instances;
+
+layout(push_constant) uniform DrawConstants
+{
+  vec4 color;
+  vec4 position_scale;
+  vec4 position_offset;
+  uint draw_id;
+  uint instance_base;
+  uint texture_index;
+} draw_constants;
+
 void main()
 {
+  vec3 position = in_position;
+  if(quantized_positions)
+    position =
+        position * draw_constants.position_scale.xyz +
+        draw_constants.position_offset.xyz;
+
   gl_Position =
       ubo_view_projection.proj * ubo_view_projection.view *
-      ubo_model_instance.model[gl_InstanceIndex] * vec4(in_position, 1.0);
-  frag_color = in_color;
+      instances.model[draw_constants.instance_base + gl_InstanceIndex] *
+      vec4(position, 1.0);
+  frag_color = draw_constants.color.rgb;
   frag_texture_coord = in_texture_coord;
+  frag_texture_index = draw_constants.texture_index;
 }
@@ -0,0 +1,17 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 in_frag_color;
+layout(location = 1) in vec2 in_frag_texture_coord;
+layout(location = 2) flat in uint in_frag_texture_index;
+
+layout(location = 0) out vec4 out_color;
+
+layout(set = 2, binding = 0) uniform sampler2D textures[];
+
+void main()
+{
+  out_color = texture(
+      textures[nonuniformEXT(in_frag_texture_index)], in_frag_texture_coord);
+}
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MIT
+#include "allocation_counter.hpp"
+
+#ifdef BLUE_KITTY_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<uint64_t> allocations{0};
+}
+
+void *operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  void *ptr{std::malloc(size > 0 ? size : 1)};
+  if(!ptr) throw std::bad_alloc{};
+  return ptr;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+  std::free(ptr);
+}
+
+#endif
+
+namespace BKGE
+{
+namespace AllocationCounter
+{
+uint64_t count()
+{
+#ifdef BLUE_KITTY_COUNT_ALLOCATIONS
+  return allocations.load(std::memory_order_relaxed);
+#else
+  return 0;
+#endif
+}
+}
+}
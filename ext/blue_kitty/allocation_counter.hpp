@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_ALLOCATION_COUNTER_HPP
+#define BLUE_KITTY_ALLOCATION_COUNTER_HPP 1
+
+#include <cstdint>
+
+namespace BKGE
+{
+/*
+  Count calls to operator new, to check that the render loop does not touch
+  the heap once it reaches a steady state. Counting replaces the global
+  operator new, so it is only compiled when the extension is built with
+  "--enable-allocation-counter".
+*/
+namespace AllocationCounter
+{
+#ifdef BLUE_KITTY_COUNT_ALLOCATIONS
+const bool enabled{true};
+#else
+const bool enabled{false};
+#endif
+
+// Allocations since the extension was loaded, always 0 when not enabled.
+uint64_t count();
+}
+}
+
+#endif /* BLUE_KITTY_ALLOCATION_COUNTER_HPP */
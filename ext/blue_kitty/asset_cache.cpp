@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MIT
+#include "asset_cache.hpp"
+
+#include <filesystem>
+
+namespace BKGE
+{
+std::string AssetCache::make_key(const std::string &file_path)
+{
+  std::error_code error;
+
+  std::filesystem::path canonical_path{
+    std::filesystem::canonical(file_path, error)};
+  if(error) return "";
+
+  auto mtime{std::filesystem::last_write_time(canonical_path, error)};
+  if(error) return "";
+
+  return canonical_path.string() + "@" +
+      std::to_string(mtime.time_since_epoch().count());
+}
+}
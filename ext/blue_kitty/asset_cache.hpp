@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_ASSET_CACHE_HPP
+#define BLUE_KITTY_ASSET_CACHE_HPP 1
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+struct bk_sGeometry;
+struct bk_sTexture;
+
+namespace BKGE
+{
+/*
+  Map asset keys to resources that are already resident. Only weak references
+  are kept, so a resource is freed as soon as no Ruby object uses it anymore;
+  its entry is dropped by the next insert.
+*/
+template<typename T>
+class AssetTable
+{
+ public:
+  AssetTable();
+
+  inline uint64_t get_hits() const { return this->hits; };
+  inline uint64_t get_misses() const { return this->misses; };
+
+  // Return nullptr and count a miss if there is no live resource for the key.
+  std::shared_ptr<T> find(const std::string &key);
+  void insert(const std::string &key, const std::shared_ptr<T> &asset);
+  // Live resources that Residency has not evicted.
+  size_t resident() const;
+
+ private:
+  std::unordered_map<std::string, std::weak_ptr<T>> assets;
+  uint64_t hits, misses;
+};
+
+template<typename T>
+AssetTable<T>::AssetTable():
+    hits{0},
+    misses{0}
+{
+}
+
+template<typename T>
+std::shared_ptr<T> AssetTable<T>::find(const std::string &key)
+{
+  auto entry{this->assets.find(key)};
+  if(entry != this->assets.end())
+  {
+    std::shared_ptr<T> asset{entry->second.lock()};
+    if(asset)
+    {
+      this->hits++;
+      return asset;
+    }
+    this->assets.erase(entry);
+  }
+
+  this->misses++;
+  return nullptr;
+}
+
+template<typename T>
+void AssetTable<T>::insert(
+    const std::string &key, const std::shared_ptr<T> &asset)
+{
+  // Loading is rare next to drawing, a full pass here keeps keys of freed
+  // resources and old modification times from piling up.
+  for(auto entry{this->assets.begin()}; entry != this->assets.end();)
+    if(entry->second.expired()) entry = this->assets.erase(entry);
+    else entry++;
+
+  this->assets[key] = asset;
+}
+
+template<typename T>
+size_t AssetTable<T>::resident() const
+{
+  size_t count{0};
+  for(const auto& [key, asset]: this->assets)
+    if(std::shared_ptr<T> live{asset.lock()}; live && live->resident) count++;
+  return count;
+}
+
+class AssetCache
+{
+ public:
+  AssetTable<bk_sGeometry> geometries;
+  AssetTable<bk_sTexture> textures;
+
+  // Build a key from the canonical path and the modification time of a file,
+  // so a file changed on disk is loaded again. Return an empty string if the
+  // file can not be found, these assets must not be cached.
+  static std::string make_key(const std::string &file_path);
+};
+}
+
+#endif /* BLUE_KITTY_ASSET_CACHE_HPP */
@@ -0,0 +1,448 @@
+// SPDX-License-Identifier: MIT
+#include "bcn_decoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+// Pixels of one 4x4 block, 4 bytes each.
+typedef uint8_t Block[16][4];
+
+uint16_t read16(const uint8_t *data)
+{
+  return static_cast<uint16_t>(data[0] | data[1] << 8);
+}
+
+uint32_t read32(const uint8_t *data)
+{
+  return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+      static_cast<uint32_t>(data[2]) << 16 |
+      static_cast<uint32_t>(data[3]) << 24;
+}
+
+void unpack_565(uint16_t color, uint8_t *rgba)
+{
+  uint8_t r{static_cast<uint8_t>(color >> 11 & 0x1f)};
+  uint8_t g{static_cast<uint8_t>(color >> 5 & 0x3f)};
+  uint8_t b{static_cast<uint8_t>(color & 0x1f)};
+
+  rgba[0] = static_cast<uint8_t>(r << 3 | r >> 2);
+  rgba[1] = static_cast<uint8_t>(g << 2 | g >> 4);
+  rgba[2] = static_cast<uint8_t>(b << 3 | b >> 2);
+  rgba[3] = 255;
+}
+
+// "four_colors" is always true for the color part of BC3. Without it, blocks
+// with color0 <= color1 have three colors and black, which is transparent
+// only if the format has alpha.
+void decode_bc1(
+    const uint8_t *data, Block pixels, bool four_colors, bool has_alpha)
+{
+  uint16_t color0{read16(data)};
+  uint16_t color1{read16(data + 2)};
+  uint8_t colors[4][4];
+
+  unpack_565(color0, colors[0]);
+  unpack_565(color1, colors[1]);
+
+  for(uint32_t c{0}; c < 3; c++)
+  {
+    if(four_colors || color0 > color1)
+    {
+      colors[2][c] = static_cast<uint8_t>(
+          (2 * colors[0][c] + colors[1][c]) / 3);
+      colors[3][c] = static_cast<uint8_t>(
+          (colors[0][c] + 2 * colors[1][c]) / 3);
+    }
+    else
+    {
+      colors[2][c] = static_cast<uint8_t>((colors[0][c] + colors[1][c]) / 2);
+      colors[3][c] = 0;
+    }
+  }
+  colors[2][3] = 255;
+  colors[3][3] = (four_colors || color0 > color1 || !has_alpha) ? 255 : 0;
+
+  uint32_t indices{read32(data + 4)};
+  for(uint32_t i{0}; i < 16; i++)
+    memcpy(pixels[i], colors[indices >> 2 * i & 3], 4);
+}
+
+// Decode a single channel block into "channel" of every pixel. Signed values
+// are stored as two's complement bytes.
+void decode_bc4(
+    const uint8_t *data, Block pixels, uint32_t channel, bool is_signed)
+{
+  int32_t values[8];
+
+  if(is_signed)
+  {
+    values[0] = std::max<int32_t>(static_cast<int8_t>(data[0]), -127);
+    values[1] = std::max<int32_t>(static_cast<int8_t>(data[1]), -127);
+  }
+  else
+  {
+    values[0] = data[0];
+    values[1] = data[1];
+  }
+
+  if(values[0] > values[1])
+    for(int32_t i{1}; i < 7; i++)
+      values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7;
+  else
+  {
+    for(int32_t i{1}; i < 5; i++)
+      values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5;
+    values[6] = is_signed ? -127 : 0;
+    values[7] = is_signed ? 127 : 255;
+  }
+
+  uint64_t indices{0};
+  for(uint32_t i{0}; i < 6; i++)
+    indices |= static_cast<uint64_t>(data[2 + i]) << 8 * i;
+
+  for(uint32_t i{0}; i < 16; i++)
+    pixels[i][channel] = static_cast<uint8_t>(values[indices >> 3 * i & 7]);
+}
+
+struct BC7Mode
+{
+  uint8_t subsets;
+  uint8_t partition_bits;
+  uint8_t rotation_bits;
+  uint8_t index_selection_bits;
+  uint8_t color_bits;
+  uint8_t alpha_bits;
+  uint8_t endpoint_pbits;
+  uint8_t shared_pbits;
+  uint8_t index_bits;
+  uint8_t index_bits2;
+};
+
+const BC7Mode bc7_modes[8]{
+  {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+  {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+  {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+  {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+  {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+  {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+  {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+  {2, 6, 0, 0, 5, 5, 1, 0, 2, 0}
+};
+
+// Subset of each pixel, one bit per pixel.
+const uint16_t bc7_partitions2[64]{
+  0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+  0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+  0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+  0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+  0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+  0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+  0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+  0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+};
+
+// Subset of each pixel, two bits per pixel.
+const uint32_t bc7_partitions3[64]{
+  0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050,
+  0x5555a0a0, 0x5a5a5050, 0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090,
+  0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250, 0xa5945040, 0x0a425054,
+  0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+  0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414,
+  0x50a4a450, 0x6a5a0200, 0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424,
+  0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50, 0x500aa550, 0xaaaa4444,
+  0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+  0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580,
+  0xaa141414, 0x96960000, 0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000,
+  0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+};
+
+// Pixel whose index is stored with one bit less, for the second subset of
+// two-subset partitions and the second and third subsets of three-subset
+// partitions. The first subset always uses pixel 0.
+const uint8_t bc7_anchors2[64]{
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+  15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+  15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+  6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+};
+
+const uint8_t bc7_anchors3_second[64]{
+  3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+  3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+  8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+  3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3
+};
+
+const uint8_t bc7_anchors3_third[64]{
+  15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+  15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+  15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+  15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8
+};
+
+// Read a BC7 block from the least significant bit of the first byte on.
+class BitReader
+{
+ public:
+  explicit BitReader(const uint8_t *data): data{data}, position{0} {};
+
+  uint32_t read(uint32_t count)
+  {
+    uint32_t value{0};
+    for(uint32_t i{0}; i < count; i++, this->position++)
+      value |= static_cast<uint32_t>(
+          this->data[this->position >> 3] >> (this->position & 7) & 1) << i;
+    return value;
+  }
+
+ private:
+  const uint8_t *data;
+  uint32_t position;
+};
+
+uint32_t bc7_subset(uint32_t subsets, uint32_t partition, uint32_t pixel)
+{
+  switch(subsets)
+  {
+    case 2:
+      return bc7_partitions2[partition] >> pixel & 1;
+    case 3:
+      return bc7_partitions3[partition] >> 2 * pixel & 3;
+    default:
+      return 0;
+  }
+}
+
+bool bc7_is_anchor(uint32_t subsets, uint32_t partition, uint32_t pixel)
+{
+  if(pixel == 0) return true;
+  if(subsets == 2) return pixel == bc7_anchors2[partition];
+  if(subsets == 3)
+    return pixel == bc7_anchors3_second[partition] ||
+        pixel == bc7_anchors3_third[partition];
+  return false;
+}
+
+uint8_t bc7_expand(uint32_t value, uint32_t bits)
+{
+  value <<= 8 - bits;
+  return static_cast<uint8_t>(value | value >> bits);
+}
+
+uint8_t bc7_interpolate(
+    uint32_t e0, uint32_t e1, uint32_t index, uint32_t index_bits)
+{
+  static const uint8_t weights2[4]{0, 21, 43, 64};
+  static const uint8_t weights3[8]{0, 9, 18, 27, 37, 46, 55, 64};
+  static const uint8_t weights4[16]{
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+  const uint8_t *weights{
+    index_bits == 2 ? weights2 : index_bits == 3 ? weights3 : weights4};
+  uint32_t weight{weights[index]};
+
+  return static_cast<uint8_t>(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+}
+
+void decode_bc7(const uint8_t *data, Block pixels)
+{
+  BitReader bits{data};
+
+  uint32_t mode{0};
+  while(mode < 8 && bits.read(1) == 0) mode++;
+
+  // Reserved mode, the specification asks for transparent black.
+  if(mode == 8)
+  {
+    memset(pixels, 0, sizeof(Block));
+    return;
+  }
+
+  const BC7Mode &m{bc7_modes[mode]};
+  uint32_t partition{bits.read(m.partition_bits)};
+  uint32_t rotation{bits.read(m.rotation_bits)};
+  uint32_t index_selection{bits.read(m.index_selection_bits)};
+  uint32_t endpoints_quantity{2u * m.subsets};
+
+  // Two endpoints per subset, four channels per endpoint.
+  uint32_t endpoints[6][4];
+  for(uint32_t c{0}; c < 3; c++)
+    for(uint32_t e{0}; e < endpoints_quantity; e++)
+      endpoints[e][c] = bits.read(m.color_bits);
+  for(uint32_t e{0}; e < endpoints_quantity; e++)
+    endpoints[e][3] = m.alpha_bits > 0 ? bits.read(m.alpha_bits) : 255;
+
+  uint32_t color_bits{m.color_bits};
+  uint32_t alpha_bits{m.alpha_bits};
+  if(m.endpoint_pbits || m.shared_pbits)
+  {
+    uint32_t pbits[6];
+    if(m.endpoint_pbits)
+      for(uint32_t e{0}; e < endpoints_quantity; e++)
+        pbits[e] = bits.read(1);
+    else
+      for(uint32_t s{0}; s < m.subsets; s++)
+        pbits[2 * s] = pbits[2 * s + 1] = bits.read(1);
+
+    for(uint32_t e{0}; e < endpoints_quantity; e++)
+      for(uint32_t c{0}; c < (alpha_bits > 0 ? 4u : 3u); c++)
+        endpoints[e][c] = endpoints[e][c] << 1 | pbits[e];
+
+    color_bits++;
+    if(alpha_bits > 0) alpha_bits++;
+  }
+
+  for(uint32_t e{0}; e < endpoints_quantity; e++)
+  {
+    for(uint32_t c{0}; c < 3; c++)
+      endpoints[e][c] = bc7_expand(endpoints[e][c], color_bits);
+    if(alpha_bits > 0)
+      endpoints[e][3] = bc7_expand(endpoints[e][3], alpha_bits);
+  }
+
+  uint32_t indices[16];
+  uint32_t indices2[16];
+  for(uint32_t i{0}; i < 16; i++)
+    indices[i] = bits.read(
+        m.index_bits - (bc7_is_anchor(m.subsets, partition, i) ? 1 : 0));
+  if(m.index_bits2 > 0)
+    for(uint32_t i{0}; i < 16; i++)
+      indices2[i] = bits.read(m.index_bits2 - (i == 0 ? 1 : 0));
+
+  for(uint32_t i{0}; i < 16; i++)
+  {
+    uint32_t subset{bc7_subset(m.subsets, partition, i)};
+    const uint32_t *e0{endpoints[2 * subset]};
+    const uint32_t *e1{endpoints[2 * subset + 1]};
+    uint8_t *pixel{pixels[i]};
+
+    if(m.index_bits2 == 0)
+      for(uint32_t c{0}; c < 4; c++)
+        pixel[c] = bc7_interpolate(e0[c], e1[c], indices[i], m.index_bits);
+    else
+    {
+      // Modes 4 and 5 have separated indices for color and alpha, the index
+      // selection bit swaps them.
+      uint32_t color_index{index_selection ? indices2[i] : indices[i]};
+      uint32_t color_index_bits{
+        index_selection ? m.index_bits2 : m.index_bits};
+      uint32_t alpha_index{index_selection ? indices[i] : indices2[i]};
+      uint32_t alpha_index_bits{
+        index_selection ? m.index_bits : m.index_bits2};
+
+      for(uint32_t c{0}; c < 3; c++)
+        pixel[c] = bc7_interpolate(
+            e0[c], e1[c], color_index, color_index_bits);
+      pixel[3] = bc7_interpolate(e0[3], e1[3], alpha_index, alpha_index_bits);
+    }
+
+    if(rotation > 0) std::swap(pixel[rotation - 1], pixel[3]);
+  }
+}
+
+void decode_block(VkFormat vk_format, const uint8_t *data, Block pixels)
+{
+  switch(vk_format)
+  {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      decode_bc1(data, pixels, false, false);
+      break;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      decode_bc1(data, pixels, false, true);
+      break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      decode_bc1(data + 8, pixels, true, false);
+      decode_bc4(data, pixels, 3, false);
+      break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    {
+      bool is_signed{vk_format == VK_FORMAT_BC5_SNORM_BLOCK};
+      decode_bc4(data, pixels, 0, is_signed);
+      decode_bc4(data + 8, pixels, 1, is_signed);
+      for(uint32_t i{0}; i < 16; i++)
+      {
+        pixels[i][2] = 0;
+        pixels[i][3] = is_signed ? 127 : 255;
+      }
+      break;
+    }
+    default:
+      decode_bc7(data, pixels);
+      break;
+  }
+}
+
+}
+
+namespace BKGE::BCn
+{
+uint32_t block_size(VkFormat vk_format)
+{
+  switch(vk_format)
+  {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+VkFormat decoded_format(VkFormat vk_format)
+{
+  switch(vk_format)
+  {
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return VK_FORMAT_R8G8B8A8_SRGB;
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+      return VK_FORMAT_R8G8B8A8_SNORM;
+    default:
+      return VK_FORMAT_R8G8B8A8_UNORM;
+  }
+}
+
+std::vector<uint8_t> decode(
+    VkFormat vk_format, const uint8_t *blocks, uint32_t width,
+    uint32_t height)
+{
+  std::vector<uint8_t> pixels(4 * static_cast<size_t>(width) * height);
+  uint32_t blocks_width{(width + 3) / 4};
+  uint32_t blocks_height{(height + 3) / 4};
+  uint32_t size{block_size(vk_format)};
+  Block block;
+
+  for(uint32_t by{0}; by < blocks_height; by++)
+    for(uint32_t bx{0}; bx < blocks_width; bx++)
+    {
+      decode_block(
+          vk_format, blocks + (by * blocks_width + bx) * size, block);
+
+      // Blocks on the right and bottom borders may be partially outside.
+      for(uint32_t y{0}; y < 4 && by * 4 + y < height; y++)
+        for(uint32_t x{0}; x < 4 && bx * 4 + x < width; x++)
+          memcpy(&pixels[4 * ((by * 4 + y) * static_cast<size_t>(width) +
+                              bx * 4 + x)],
+                 block[4 * y + x], 4);
+    }
+
+  return pixels;
+}
+}
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_BCN_DECODER_HPP
+#define BLUE_KITTY_BCN_DECODER_HPP 1
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+/*
+  CPU decoders for the block-compressed formats a texture file can contain.
+  They are only used when the device can not sample the compressed format.
+*/
+namespace BKGE::BCn
+{
+// Return 0 if the format is not a supported block-compressed format.
+uint32_t block_size(VkFormat vk_format);
+
+// Uncompressed format that "decode" produces for a compressed format.
+VkFormat decoded_format(VkFormat vk_format);
+
+// Decode a whole image into 4 bytes per pixel with tightly packed rows.
+std::vector<uint8_t> decode(
+    VkFormat vk_format, const uint8_t *blocks, uint32_t width,
+    uint32_t height);
+}
+
+#endif /* BLUE_KITTY_BCN_DECODER_HPP */
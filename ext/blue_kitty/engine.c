@@ -34,6 +34,51 @@ VALUE bk_mEngine;
  * @return [BlueKitty::Engine]
  * @author Frederico Linhares
  */
+
+/*
+ * Document-method: BlueKitty::Engine.asset_cache_stats
+ *
+ * Models and textures loaded from the same unchanged file share their GPU
+ * resources. This method reports how many loads were served from the cache
+ * (hits), how many had to read the file (misses) and how many assets are
+ * resident on the GPU right now, evicted ones excluded.
+ *
+ * @return [Hash, nil] keys are +:model_hits+, +:model_misses+,
+ *   +:models_resident+, +:texture_hits+, +:texture_misses+ and
+ *   +:textures_resident+; nil if the engine is not loaded.
+ */
+/*
+ * Document-method: BlueKitty::Engine.memory_stats
+ *
+ * Report how much device memory the engine uses in each memory heap. When
+ * device-local memory goes over budget, the textures and models drawn least
+ * recently are unloaded from the GPU and loaded again from their files the
+ * next time they are drawn. The budget is the +memory_budget+ configuration,
+ * or the one reported by the driver if that is not set.
+ *
+ * @return [Hash, nil] +:heaps+ is an Array with one Hash per heap with the
+ *   keys +:size+, +:device_local+, +:reserved+, +:used+, +:blocks+,
+ *   +:allocations+, +:budget+ and +:usage+. +:driver_budget+ is true if
+ *   +:budget+ and +:usage+ come from the driver instead of an estimate.
+ *   +:memory_budget+ is the configured budget, +:evictions+ and +:restreams+
+ *   count assets unloaded and loaded again. nil if the engine is not loaded.
+ */
+/*
+ * Document-method: BlueKitty::Engine.render_stats
+ *
+ * Report what the last frame drew. Models far from the camera are drawn with
+ * simplified meshes, see the +lod_screen_sizes+ configuration, and models
+ * hidden behind others are not drawn, see +occlusion_culling+.
+ *
+ * @return [Hash, nil] +:lod_instances+ and +:lod_triangles+ are Arrays with
+ *   the instances and triangles drawn with each level of detail, starting
+ *   from the full mesh. +:occluded_instances+ counts instances skipped
+ *   because they were hidden. +:updated_transforms+ counts matrices computed
+ *   again because their entity or camera moved, the others were reused.
+ *   +:gvl_released_seconds+ is the time the frame spent waiting for the GPU
+ *   and the frame rate limit, while other Ruby threads could run. nil if the
+ *   engine is not loaded.
+ */
 void
 Init_blue_kitty_engine(void)
 {
@@ -45,4 +90,10 @@ Init_blue_kitty_engine(void)
                             1);
   rb_define_module_function(bk_mEngine, "unload_core",
                             bk_mEngine_unload_core, 0);
+  rb_define_module_function(bk_mEngine, "asset_cache_stats",
+                            bk_mEngine_asset_cache_stats, 0);
+  rb_define_module_function(bk_mEngine, "memory_stats",
+                            bk_mEngine_memory_stats, 0);
+  rb_define_module_function(bk_mEngine, "render_stats",
+                            bk_mEngine_render_stats, 0);
 }
@@ -23,6 +23,15 @@ bk_mEngine_loop_stage(VALUE self, VALUE current_stage);
 VALUE
 bk_mEngine_unload_core(VALUE self);
 
+VALUE
+bk_mEngine_asset_cache_stats(VALUE self);
+
+VALUE
+bk_mEngine_memory_stats(VALUE self);
+
+VALUE
+bk_mEngine_render_stats(VALUE self);
+
 void
 Init_blue_kitty_engine(void);
 
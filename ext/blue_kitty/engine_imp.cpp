@@ -3,19 +3,25 @@
 #include "engine_imp.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cassert>
 #include <sstream>
 
 #include <glm/ext.hpp>
 
+#include "allocation_counter.hpp"
 #include "error.h"
 #include "input_device.h"
 #include "log.hpp"
+#include "transform_imp.hpp"
 #include "vector3d_imp.hpp"
 #include "vk_uniform_buffer.hpp"
+#include "vk_vertex.hpp"
 
 namespace
 {
 static ID id_at_current_camera;
+static ID id_at_lod;
 static ID id_at_model;
 static ID id_at_position;
 static ID id_at_rotation;
@@ -89,13 +95,24 @@ Engine::Engine():
   this->loader.add(&Engine::load_vk_debug_callback,
                    &Engine::unload_vk_debug_callback);
   this->loader.add(&Engine::load_vk_devices, &Engine::unload_vk_devices);
+  this->loader.add(&Engine::load_vk_staging_ring,
+                   &Engine::unload_vk_staging_ring);
+  this->loader.add(&Engine::load_geometry_pool,
+                   &Engine::unload_geometry_pool);
+  this->loader.add(&Engine::load_asset_cache, &Engine::unload_asset_cache);
+  this->loader.add(&Engine::load_residency, &Engine::unload_residency);
+  this->loader.add(&Engine::load_frame_arena, &Engine::unload_frame_arena);
+  this->loader.add(&Engine::load_gvl_release, &Engine::unload_gvl_release);
   this->loader.add(&Engine::load_vk_swapchain, &Engine::unload_vk_swapchain);
+  this->loader.add(&Engine::load_vk_texture_table,
+                   &Engine::unload_vk_texture_table);
   this->loader.add(&Engine::load_vk_descriptor_set_layouts,
                    &Engine::unload_vk_descriptor_set_layouts);
   this->loader.add(&Engine::load_vk_graphic_pipeline_layout,
                    &Engine::unload_vk_graphic_pipeline_layout);
   this->loader.add(&Engine::load_vk_graphic_pipelines,
                    &Engine::unload_vk_graphic_pipelines);
+  this->loader.add(&Engine::load_depth_pyramid, &Engine::unload_depth_pyramid);
   this->loader.add(&Engine::load_vk_frame_sync, &Engine::unload_vk_frame_sync);
 
   this->loader.load();
@@ -136,6 +153,27 @@ void Engine::load_variables()
   int max_fps = FIX2INT(rb_hash_aref(config, ID2SYM(rb_intern("max_fps"))));
   // Time is calculated in mileseconds by SDL.
   this->max_frame_duration = 1000/max_fps;
+
+  VALUE memory_budget =
+      rb_hash_aref(config, ID2SYM(rb_intern("memory_budget")));
+  this->memory_budget = NIL_P(memory_budget) ? 0 : NUM2ULL(memory_budget);
+
+  this->quantize_positions = rb_hash_aref(
+      config, ID2SYM(rb_intern("quantize_positions"))) == Qtrue;
+
+  VALUE lod_screen_sizes =
+      rb_hash_aref(config, ID2SYM(rb_intern("lod_screen_sizes")));
+  this->lod_screen_sizes.clear();
+  for(long i{0}; i < RARRAY_LEN(lod_screen_sizes); i++)
+    this->lod_screen_sizes.push_back(
+        NUM2DBL(rb_ary_entry(lod_screen_sizes, i)));
+  this->lod_instances.fill(0);
+  this->lod_triangles.fill(0);
+
+  this->occlusion_culling = rb_hash_aref(
+      config, ID2SYM(rb_intern("occlusion_culling"))) == Qtrue;
+  this->occluded_instances = 0;
+  this->updated_transforms = 0;
 }
 
 void Engine::unload_variables()
@@ -158,10 +196,15 @@ void Engine::load_sdl()
     base_error += SDL_GetError();
     throw Loader::Error{base_error};
   }
+
+  // Load the image codecs now, SDL2_image would otherwise load them lazily
+  // from whichever thread decodes the first image of each type.
+  IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG);
 }
 
 void Engine::unload_sdl()
 {
+  IMG_Quit();
   SDL_Vulkan_UnloadLibrary();
   SDL_Quit();
 }
@@ -329,6 +372,80 @@ void Engine::unload_vk_devices()
   this->device_with_swapchain = nullptr;
 }
 
+void Engine::load_vk_staging_ring()
+{
+  this->staging_ring = std::make_shared<BKVK::StagingRing>(
+      this->queues_families_with_graphics[0], this->staging_ring_size,
+      this->staging_ring_slots);
+}
+
+void Engine::unload_vk_staging_ring()
+{
+  this->staging_ring = nullptr;
+}
+
+void Engine::load_geometry_pool()
+{
+  VkDeviceSize vertex_size{this->quantize_positions ?
+      sizeof(BKVK::QuantizedVertex) : sizeof(BKVK::Vertex)};
+
+  this->geometry_pool_16 = std::make_shared<BKVK::GeometryPool>(
+      this->staging_ring, vertex_size, VK_INDEX_TYPE_UINT16,
+      this->geometry_pool_vertexes, this->geometry_pool_indexes);
+  this->geometry_pool_32 = std::make_shared<BKVK::GeometryPool>(
+      this->staging_ring, vertex_size, VK_INDEX_TYPE_UINT32,
+      this->geometry_pool_vertexes, this->geometry_pool_indexes);
+}
+
+void Engine::unload_geometry_pool()
+{
+  this->geometry_pool_16 = nullptr;
+  this->geometry_pool_32 = nullptr;
+}
+
+void Engine::load_asset_cache()
+{
+  this->asset_cache = std::make_shared<AssetCache>();
+}
+
+void Engine::unload_asset_cache()
+{
+  this->asset_cache = nullptr;
+}
+
+void Engine::load_residency()
+{
+  this->residency = std::make_shared<Residency>(
+      this->devices[0], this->memory_budget,
+      std::vector<std::shared_ptr<BKVK::GeometryPool>>{
+        this->geometry_pool_16, this->geometry_pool_32});
+}
+
+void Engine::unload_residency()
+{
+  this->residency = nullptr;
+}
+
+void Engine::load_frame_arena()
+{
+  this->frame_arena = std::make_unique<FrameArena>(this->frame_arena_size);
+}
+
+void Engine::unload_frame_arena()
+{
+  this->frame_arena = nullptr;
+}
+
+void Engine::load_gvl_release()
+{
+  this->gvl_release = std::make_unique<GVLRelease>();
+}
+
+void Engine::unload_gvl_release()
+{
+  this->gvl_release = nullptr;
+}
+
 void Engine::load_vk_swapchain()
 {
   this->swapchain = std::make_shared<BKVK::Swapchain>(
@@ -340,10 +457,23 @@ void Engine::unload_vk_swapchain()
   this->swapchain = nullptr;
 }
 
+void Engine::load_vk_texture_table()
+{
+  // Without descriptor indexing each model instance binds its own texture.
+  if(this->device_with_swapchain->get_descriptor_indexing())
+    this->texture_table = std::make_shared<BKVK::TextureTable>(
+        this->device_with_swapchain);
+}
+
+void Engine::unload_vk_texture_table()
+{
+  this->texture_table = nullptr;
+}
+
 void Engine::load_vk_descriptor_set_layouts()
 {
   this->dsl_model_instance = std::make_shared<BKVK::DSL::ModelInstance>(
-      this->device_with_swapchain);
+      this->device_with_swapchain, !this->texture_table);
   this->dsl_view_projection = std::make_shared<BKVK::DSL::ViewProjection>(
       this->device_with_swapchain);
 }
@@ -358,7 +488,8 @@ void Engine::load_vk_graphic_pipeline_layout()
 {
   this->graphic_pipeline_layout =
       std::make_shared<BKVK::GraphicPipelineLayout>(
-          this->dsl_model_instance, this->dsl_view_projection);
+          this->dsl_model_instance, this->dsl_view_projection,
+          this->texture_table);
 }
 
 void Engine::unload_vk_graphic_pipeline_layout()
@@ -368,8 +499,23 @@ void Engine::unload_vk_graphic_pipeline_layout()
 
 void Engine::load_vk_graphic_pipelines()
 {
-   this->graphic_pipeline = std::make_shared<BKVK::GraphicPipeline>(
-       this->swapchain, this->graphic_pipeline_layout);
+  this->graphic_pipeline = std::make_shared<BKVK::GraphicPipeline>(
+      this->swapchain, this->graphic_pipeline_layout);
+
+  this->opaque_pipeline_state.shaders = BKVK::ShaderSet::model;
+  this->opaque_pipeline_state.vertex_layout = this->quantize_positions ?
+      BKVK::VertexLayout::quantized : BKVK::VertexLayout::full;
+  // Models may be single-sided or wound clockwise, nothing is culled.
+  this->opaque_pipeline_state.cull_mode = VK_CULL_MODE_NONE;
+  this->opaque_pipeline_state.depth_test = true;
+  this->opaque_pipeline_state.depth_write = true;
+  this->opaque_pipeline_state.blend = BKVK::BlendMode::opaque;
+  this->opaque_pipeline_state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  // Compile while the game loads its assets; the first frame waits for it
+  // only if it is not ready yet.
+  this->graphic_pipeline->get_pipeline_registry()->warm(
+      {this->opaque_pipeline_state});
 }
 
 void Engine::unload_vk_graphic_pipelines()
@@ -377,6 +523,23 @@ void Engine::unload_vk_graphic_pipelines()
   this->graphic_pipeline = nullptr;
 }
 
+void Engine::load_depth_pyramid()
+{
+  if(!this->occlusion_culling) return;
+
+  this->depth_pyramid = std::make_unique<BKVK::DepthPyramid>(
+      this->device_with_swapchain,
+      this->graphic_pipeline->get_vk_depth_image_view(),
+      VkExtent2D{this->core_data->screen_width,
+                 this->core_data->screen_height},
+      this->max_frames_in_flight);
+}
+
+void Engine::unload_depth_pyramid()
+{
+  this->depth_pyramid = nullptr;
+}
+
 void Engine::load_vk_frame_sync()
 {
   this->vk_image_available_semaphores.resize(this->max_frames_in_flight);
@@ -438,13 +601,18 @@ void Engine::unload_vk_draw_command_pool()
   this->draw_command_pool = nullptr;
 }
 
-glm::mat4 Engine::update_ub_model_instance(
-    uint32_t image_index, VALUE entity3d, bk_model_data* model_data)
+glm::mat4 Engine::model_matrix(VALUE entity3d)
 {
-  glm::vec3 entity_position = bk_cVector3D_get_data(
-      rb_ivar_get(entity3d, id_at_position))->vec;
-  glm::vec3 entity_rotation = bk_cVector3D_get_data(
-      rb_ivar_get(entity3d, id_at_rotation))->vec;
+  const bk_vector3d_data *position{
+    bk_cVector3D_get_data(rb_ivar_get(entity3d, id_at_position))};
+  const bk_vector3d_data *rotation{
+    bk_cVector3D_get_data(rb_ivar_get(entity3d, id_at_rotation))};
+  bk_transform_data *transform{bk_cTransform_get_cache(entity3d)};
+  if(transform && transform->is_current(position, rotation))
+    return transform->matrix;
+
+  glm::vec3 entity_position = *position->vec;
+  glm::vec3 entity_rotation = *rotation->vec;
 
   // Object matrix.
   glm::mat4 model{1.0f};
@@ -457,19 +625,223 @@ glm::mat4 Engine::update_ub_model_instance(
   model = glm::translate(
       model, entity_position);
 
+  if(transform) transform->store(position, rotation, model);
+  this->updated_transforms++;
   return model;
 }
 
-void Engine::render(
-    VALUE camera,
-    const std::unordered_map<VALUE, std::vector<VALUE>> &model_entities)
+glm::mat4 Engine::view_matrix(VALUE camera)
 {
+  const bk_vector3d_data *position{
+    bk_cVector3D_get_data(rb_ivar_get(camera, id_at_position))};
+  const bk_vector3d_data *rotation{
+    bk_cVector3D_get_data(rb_ivar_get(camera, id_at_rotation))};
+  bk_transform_data *transform{bk_cTransform_get_cache(camera)};
+  if(transform && transform->is_current(position, rotation))
+    return transform->matrix;
+
+  glm::vec3 camera_position = *position->vec;
+  glm::vec3 camera_rotation = *rotation->vec;
+
+  glm::mat4 view{1.0f};
+  view = glm::translate(view, camera_position);
+  view = glm::rotate(
+      view, glm::radians(camera_rotation.x), glm::vec3{1.0, 0.0, 0.0});
+  view = glm::rotate(
+      view, glm::radians(camera_rotation.y), glm::vec3{0.0, 1.0, 0.0});
+  view = glm::rotate(
+      view, glm::radians(camera_rotation.z), glm::vec3{0.0, 0.0, 1.0});
+  view = glm::inverse(view);
+
+  if(transform) transform->store(position, rotation, view);
+  this->updated_transforms++;
+  return view;
+}
+
+uint32_t Engine::select_lod(VALUE entity3d, const glm::vec3 &center,
+                            const bk_sGeometry *geometry,
+                            const glm::vec3 &camera_position)
+{
+  if(geometry->lod_count < 2) return 0;
+
+  // Fraction of the screen height covered by the bounding sphere.
+  float distance{glm::distance(center, camera_position)};
+  float screen_size{1.0f};
+  if(distance > geometry->bounds_radius)
+    screen_size = geometry->bounds_radius /
+        (distance * std::tan(glm::radians(this->field_of_view) / 2.0f));
+
+  // Start from the level of the last frame.
+  VALUE last_lod = rb_ivar_get(entity3d, id_at_lod);
+  uint32_t lod{0};
+  if(FIXNUM_P(last_lod))
+    lod = std::min(FIX2UINT(last_lod), geometry->lod_count - 1);
+
+  uint32_t new_lod{lod};
+  while(new_lod + 1 < geometry->lod_count &&
+        screen_size < this->lod_screen_sizes[new_lod] *
+        (1.0f - this->lod_hysteresis))
+    new_lod++;
+  while(new_lod > 0 &&
+        screen_size > this->lod_screen_sizes[new_lod - 1] *
+        (1.0f + this->lod_hysteresis))
+    new_lod--;
+
+  if(new_lod != lod && !OBJ_FROZEN(entity3d))
+    rb_ivar_set(entity3d, id_at_lod, UINT2NUM(new_lod));
+  return new_lod;
+}
+
+void Engine::wait_for_frame()
+{
+  this->gvl_release->wait_for_fence(
+      this->devices[0]->get_vk_device(),
+      this->vk_in_flight_fences[this->current_frame]);
+
+  // The frame that used this slot before is done, and so are the geometry
+  // ranges and descriptor sets freed since that frame began.
+  this->geometry_pool_16->release_frame(this->current_frame);
+  this->geometry_pool_32->release_frame(this->current_frame);
+  this->devices[0]->get_descriptor_allocator()->release_frame(
+      this->current_frame);
+}
+
+void Engine::render(VALUE camera, Span<ModelGroup> model_groups)
+{
+  // Assets evicted to stay within the memory budget are loaded again before
+  // anything records a draw with them.
+  this->residency->begin_frame();
+  try
+  {
+    for(const auto &group: model_groups)
+      bk_cModel_get_data(group.model)->make_resident();
+  }
+  catch(Loader::Error le)
+  {
+    throw ErrRender{"Failed to load evicted asset → " + le.message};
+  }
+  // Frames in flight may still read assets drawn recently.
+  this->residency->trim(this->max_frames_in_flight);
+  // Geometries freed since the last frame may have left holes in the pool.
+  this->geometry_pool_16->compact();
+  this->geometry_pool_32->compact();
+
+  VkPipeline vk_opaque_pipeline{
+    this->graphic_pipeline->get_pipeline_registry()->get(
+        this->opaque_pipeline_state)};
+  size_t instance_count{0};
+  for(const auto &group: model_groups) instance_count += group.entities.size;
+  this->graphic_pipeline->reserve_instances(instance_count);
+  // Getting a queue allocates its handle. Uploads above need a free queue,
+  // so it is not taken before them.
+  auto queue{this->draw_command_pool->get_queue_family()->get_queue()};
+
+  // Loading and eviction above may allocate, nothing below should.
+  uint64_t allocations{AllocationCounter::count()};
+
+  // Data used by this frame must finish uploading before drawing.
+  this->staging_ring->wait_idle();
+
+  // Signaled since wait_for_frame, this does not block.
   vkWaitForFences(this->devices[0]->get_vk_device(), 1,
                   &this->vk_in_flight_fences[this->current_frame], VK_TRUE,
                   std::numeric_limits<uint64_t>::max());
   vkResetFences(this->devices[0]->get_vk_device(), 1,
                 &this->vk_in_flight_fences[this->current_frame]);
 
+  // Test against the newest depth pyramid the GPU finished: the one of the
+  // previous frame if it is done, otherwise the one of the frame that used
+  // this slot.
+  if(this->depth_pyramid)
+  {
+    size_t previous_frame{
+      (this->current_frame + this->max_frames_in_flight - 1) %
+      this->max_frames_in_flight};
+    if(vkGetFenceStatus(this->devices[0]->get_vk_device(),
+                        this->vk_in_flight_fences[previous_frame]) !=
+       VK_SUCCESS || !this->depth_pyramid->use_readback(previous_frame))
+      this->depth_pyramid->use_readback(this->current_frame);
+  }
+
+  this->updated_transforms = 0;
+  glm::vec3 camera_position = *bk_cVector3D_get_data(
+      rb_ivar_get(camera, id_at_position))->vec;
+  glm::mat4 view{this->view_matrix(camera)};
+
+  // Projection matrix.
+  glm::mat4 proj{glm::perspective(
+      glm::radians(this->field_of_view),
+      core_data->screen_width / static_cast<float>(core_data->screen_height),
+      0.1f, 10.0f)};
+  proj[1][1] *= -1;
+
+  // Instances hidden in a recent frame are dropped. The others get a level
+  // of detail; instances of a model are sorted by level, finer levels
+  // first, and each level in use is one draw.
+  struct LodDraw
+  {
+    bk_model_data *model_data;
+    uint32_t lod;
+    uint32_t instance_base;
+    uint32_t instance_count;
+  };
+  auto instances{this->frame_arena->allocate_array<glm::mat4>(
+      instance_count)};
+  auto lod_draws{this->frame_arena->allocate_array<LodDraw>(
+      model_groups.size * bk_max_lods)};
+  size_t lod_draw_count{0};
+  // Instances of each model follow the ones of the model before it.
+  uint32_t instance_base{0};
+  this->lod_instances.fill(0);
+  this->lod_triangles.fill(0);
+  this->occluded_instances = 0;
+  for(const auto &group: model_groups)
+  {
+    bk_model_data *model_data = bk_cModel_get_data(group.model);
+    const bk_sGeometry *geometry{model_data->geometry.get()};
+
+    auto models{this->frame_arena->allocate_array<glm::mat4>(
+        group.entities.size)};
+    auto lods{this->frame_arena->allocate_array<uint32_t>(
+        group.entities.size)};
+    size_t visible_count{0};
+    std::array<uint32_t, bk_max_lods> lod_counts{};
+    for(const auto &entity3d: group.entities)
+    {
+      glm::mat4 model{this->model_matrix(entity3d)};
+      glm::vec3 center{model * glm::vec4{geometry->bounds_center, 1.0f}};
+      if(this->depth_pyramid &&
+         this->depth_pyramid->is_occluded(center, geometry->bounds_radius))
+      {
+        this->occluded_instances++;
+        continue;
+      }
+
+      models[visible_count] = model;
+      lods[visible_count] = this->select_lod(
+          entity3d, center, geometry, camera_position);
+      lod_counts[lods[visible_count]]++;
+      visible_count++;
+    }
+
+    std::array<uint32_t, bk_max_lods> next_instance{};
+    for(uint32_t lod{0}; lod < bk_max_lods; lod++)
+    {
+      if(lod_counts[lod] == 0) continue;
+
+      lod_draws[lod_draw_count++] = {
+        model_data, lod, instance_base, lod_counts[lod]};
+      next_instance[lod] = instance_base;
+      instance_base += lod_counts[lod];
+
+      this->lod_instances[lod] += lod_counts[lod];
+      this->lod_triangles[lod] +=
+          uint64_t{lod_counts[lod]} * geometry->lod_triangles[lod];
+    }
+    for(size_t i{0}; i < visible_count; i++)
+      instances[next_instance[lods[i]]++] = models[i];
+  }
+
   uint32_t image_index;
   vkAcquireNextImageKHR(
       this->devices[0]->get_vk_device(), this->swapchain->get_vk_swapchain(),
@@ -494,8 +866,10 @@ void Engine::render(
       throw ErrRender{"Failed to beggin draw command buffer."};
     }
 
+    std::array<VkClearValue, 2> clear_values{};
     // Dark gray blue.
-    VkClearValue clear_color{0.12f, 0.12f, 0.18f, 1.0f};
+    clear_values[0].color = {{0.12f, 0.12f, 0.18f, 1.0f}};
+    clear_values[1].depthStencil = {1.0f, 0};
 
     VkRenderPassBeginInfo render_pass_begin{};
     render_pass_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -507,8 +881,8 @@ void Engine::render(
     render_pass_begin.renderArea.offset = {0, 0};
     render_pass_begin.renderArea.extent = {
       this->core_data->screen_width, this->core_data->screen_height};
-    render_pass_begin.clearValueCount = 1;
-    render_pass_begin.pClearValues = &clear_color;
+    render_pass_begin.clearValueCount = clear_values.size();
+    render_pass_begin.pClearValues = clear_values.data();
 
     vkCmdBeginRenderPass(
         vk_command_buffer, &render_pass_begin, VK_SUBPASS_CONTENTS_INLINE);
@@ -527,23 +901,59 @@ void Engine::render(
     vk_scissor.offset.y = 0;
     vkCmdSetScissor(vk_command_buffer, 0, 1, &vk_scissor);
 
-    for(const auto& [model, entities]: model_entities)
+    // The texture table is bound once, models select textures by index.
+    if(this->texture_table)
+    {
+      VkDescriptorSet vk_texture_table_set{
+        this->texture_table->get_vk_descriptor_set()};
+      vkCmdBindDescriptorSets(
+          vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          this->graphic_pipeline_layout->get_vk_pipeline_layout(), 2, 1,
+          &vk_texture_table_set, 0, nullptr);
+    }
+
+    // Everything below is the same for every model; models only change
+    // their instance data and push constants.
+    vkCmdBindPipeline(
+        vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        vk_opaque_pipeline);
+    VkDescriptorSet vk_ds_view_projection{
+      this->graphic_pipeline->get_ds_view_projection()->
+      get_vk_descriptor_sets()[image_index]};
+    vkCmdBindDescriptorSets(
+        vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        this->graphic_pipeline_layout->get_vk_pipeline_layout(), 1, 1,
+        &vk_ds_view_projection, 0, nullptr);
+
+    // Most geometries share a page of a pool, only bind it when it changes.
+    const BKVK::GeometryPool *bound_pool{nullptr};
+    uint32_t bound_page{0};
+    uint32_t draw_id{0};
+    for(size_t i{0}; i < lod_draw_count; i++)
     {
-      bk_model_data* model_data = bk_cModel_get_data(model);
+      const LodDraw &lod_draw{lod_draws[i]};
+      bk_model_data* model_data = lod_draw.model_data;
 
+      auto &geometry{model_data->geometry};
+      if(geometry->geometry_pool.get() != bound_pool ||
+         geometry->range->page != bound_page)
+      {
+        bound_pool = geometry->geometry_pool.get();
+        bound_page = geometry->range->page;
+        bound_pool->bind(vk_command_buffer, bound_page);
+      }
       model_data->draw(
-          vk_command_buffer,
-          image_index,
-          entities.size(),
-          this->graphic_pipeline->get_vk_graphic_pipeline(),
-          this->graphic_pipeline->get_ds_view_projection()->
-          get_vk_descriptor_sets()[this->current_frame],
-          this->graphic_pipeline->get_graphic_pipeline_layout()->
-          get_vk_pipeline_layout());
+          vk_command_buffer, lod_draw.lod, lod_draw.instance_base,
+          lod_draw.instance_count, draw_id,
+          this->graphic_pipeline_layout->get_vk_pipeline_layout());
     }
 
     vkCmdEndRenderPass(vk_command_buffer);
 
+    if(this->depth_pyramid)
+      this->depth_pyramid->record(
+          vk_command_buffer, this->current_frame, view, proj);
+
     if(vkEndCommandBuffer(vk_command_buffer) != VK_SUCCESS)
     {
       throw ErrRender{"Failed to end draw command buffer."};
@@ -552,62 +962,22 @@ void Engine::render(
 
   // Update uniform buffers
   {
-    glm::vec3 camera_position = bk_cVector3D_get_data(
-        rb_ivar_get(camera, id_at_position))->vec;
-    glm::vec3 camera_rotation = bk_cVector3D_get_data(
-        rb_ivar_get(camera, id_at_rotation))->vec;
-
     BKVK::UBOViewProjection ubo_view_projection{};
-    // View matrix.
-    ubo_view_projection.view = glm::mat4{1.0f};
-    ubo_view_projection.view = glm::translate(
-        ubo_view_projection.view, camera_position);
-    ubo_view_projection.view = glm::rotate(
-        ubo_view_projection.view, glm::radians(camera_rotation.x),
-        glm::vec3{1.0, 0.0, 0.0});
-    ubo_view_projection.view = glm::rotate(
-        ubo_view_projection.view, glm::radians(camera_rotation.y),
-        glm::vec3{0.0, 1.0, 0.0});
-    ubo_view_projection.view = glm::rotate(
-        ubo_view_projection.view, glm::radians(camera_rotation.z),
-        glm::vec3{0.0, 0.0, 1.0});
-    ubo_view_projection.view = glm::inverse(ubo_view_projection.view);
-
-    // Projection matrix.
-    ubo_view_projection.proj = glm::perspective(
-        glm::radians(45.0f),
-        core_data->screen_width /
-        static_cast<float>(core_data->screen_height),
-        0.1f, 10.0f);
-    ubo_view_projection.proj[1][1] *= -1;
+    ubo_view_projection.view = view;
+    ubo_view_projection.proj = proj;
 
     this->graphic_pipeline->get_ub_view_projection()[image_index]->
         copy_data(&ubo_view_projection);
 
-    for(const auto& [model, entities3d]: model_entities)
-    {
-      BKVK::UBOModelInstance ubo_model_instance;
-      int entity_index{0};
-      bk_model_data* model_data = bk_cModel_get_data(model);
-
-      for(const auto &entity3d: entities3d)
-      {
-        ubo_model_instance.model[entity_index] = update_ub_model_instance(
-            image_index, entity3d, model_data);
-
-        entity_index++;
-      }
-
-      model_data->ub_model_instance[image_index]->
-          copy_data(&ubo_model_instance);
-    }
+    // Only the instances drawn are written, in the order of the draws.
+    std::copy(instances.begin(), instances.begin() + instance_base,
+              reinterpret_cast<glm::mat4*>(
+                  this->graphic_pipeline->get_sb_instances()[image_index]->
+                  get_mapped()));
   }
 
   // Submit drawing command.
   {
-    auto queue =
-        this->draw_command_pool->get_queue_family()->get_queue();
-
     VkSemaphore wait_semaphores[]{
       this->vk_image_available_semaphores[this->current_frame]};
     VkPipelineStageFlags wait_stages[] =
@@ -645,10 +1015,14 @@ void Engine::render(
     present_info.pImageIndices = &image_index;
     present_info.pResults = nullptr;
 
+    // Keeps the GVL: the queue stays busy until render returns, and a Ruby
+    // thread uploading an asset would find no free queue.
     vkQueuePresentKHR(queue->get_vk_queue(), &present_info);
 
     current_frame = (current_frame + 1) % this->max_frames_in_flight;
   }
+
+  assert(AllocationCounter::count() == allocations);
 }
 
 Engine *engine{nullptr};
@@ -659,6 +1033,7 @@ VALUE
 bk_mEngine_load_core(VALUE self)
 {
   id_at_current_camera = rb_intern("@current_camera");
+  id_at_lod = rb_intern("@lod");
   id_at_model = rb_intern("@model");
   id_at_position = rb_intern("@position");
   id_at_rotation = rb_intern("@rotation");
@@ -703,18 +1078,16 @@ bk_mEngine_loop_stage(VALUE self, VALUE current_stage)
   int frame_stop = 0;
   VALUE frame_last_duration = rb_float_new(0.0);
 
+  BKGE::FrameArena *frame_arena{BKGE::engine->get_frame_arena()};
+  BKGE::GVLRelease *gvl_release{BKGE::engine->get_gvl_release()};
+
   BKGE::engine->load_vk_draw_command_pool();
 
   while(TYPE(rb_ivar_get(self, id_at_at_quit_stage)) == T_FALSE)
   {
-    // The key is the model and the value is a vector of entities.
-    // Several entities can have the same model. This map group entities based
-    // on their models so they can all be rendered as instance with only one
-    // call to VkCmdDraw[Indexed][Indirect].
-    std::unordered_map<VALUE, std::vector<VALUE>> model_entities;
-
     // Initial frame ticks.
     frame_start = SDL_GetTicks();
+    gvl_release->next_frame();
 
     // Get input
     while(SDL_PollEvent(&event) != 0)
@@ -735,22 +1108,57 @@ bk_mEngine_loop_stage(VALUE self, VALUE current_stage)
 
     rb_funcall(current_stage, id_tick, 1, frame_last_duration);
 
-    // Default entities operations.
+    // Other Ruby threads run during this wait and may drop entities or
+    // models, so it comes before they are grouped in the frame arena.
+    BKGE::engine->wait_for_frame();
+
+    // Several entities can have the same model. Group entities based on
+    // their models so they can all be rendered as instance with only one
+    // call to VkCmdDraw[Indexed][Indirect]. Groups live in the frame arena, so
+    // a frame does not allocate memory.
+    uint64_t allocations{BKGE::AllocationCounter::count()};
+    BKGE::Span<BKGE::ModelGroup> model_groups;
     {
-      int ary_len = RARRAY_LEN(entities3d);
-      for(int i{0}; i < ary_len; i++)
+      long ary_len = RARRAY_LEN(entities3d);
+
+      // Sorting by model and then by position in the array keeps entities of
+      // a model in the same order every frame.
+      auto sorted{frame_arena->allocate_array<std::pair<VALUE, long>>(
+          ary_len)};
+      size_t group_count{0};
+      for(long i{0}; i < ary_len; i++)
       {
         VALUE entity3d = rb_ary_entry(entities3d, i);
-
-        // Group entities by models.
-        VALUE model = rb_ivar_get(entity3d, id_at_model);
-        model_entities[model].push_back(entity3d);
+        sorted[i] = {rb_ivar_get(entity3d, id_at_model), i};
 
         // TODO: tick entities.
       }
+      std::sort(sorted.begin(), sorted.end());
+      for(long i{0}; i < ary_len; i++)
+        if(i == 0 || sorted[i].first != sorted[i - 1].first) group_count++;
+
+      auto entities{frame_arena->allocate_array<VALUE>(ary_len)};
+      model_groups = frame_arena->allocate_array<BKGE::ModelGroup>(
+          group_count);
+      size_t group{0};
+      for(long i{0}; i < ary_len; i++)
+      {
+        entities[i] = rb_ary_entry(entities3d, sorted[i].second);
+        if(i > 0 && sorted[i].first == sorted[i - 1].first)
+        {
+          model_groups[group - 1].entities.size++;
+          continue;
+        }
+
+        model_groups[group].model = sorted[i].first;
+        model_groups[group].entities = {&entities[i], 1};
+        group++;
+      }
     }
+    assert(BKGE::AllocationCounter::count() == allocations);
 
-    BKGE::engine->render(current_camera, model_entities);
+    BKGE::engine->render(current_camera, model_groups);
+    frame_arena->reset();
 
     // Control frame speed.
     // SDL_GetTicks return time im miliseconds, so I need to divide by 1000.
@@ -760,7 +1168,8 @@ bk_mEngine_loop_stage(VALUE self, VALUE current_stage)
     // If frame take less time than maximum allowed.
     if(BKGE::engine->get_max_frame_duration() > frame_stop)
     {
-      SDL_Delay(BKGE::engine->get_max_frame_duration() - frame_stop);
+      // Other Ruby threads run while this one sleeps.
+      gvl_release->sleep(BKGE::engine->get_max_frame_duration() - frame_stop);
       frame_last_duration =
           rb_float_new(BKGE::engine->get_max_frame_duration()/1000.0);
     }
@@ -776,6 +1185,111 @@ bk_mEngine_loop_stage(VALUE self, VALUE current_stage)
   return self;
 }
 
+VALUE
+bk_mEngine_asset_cache_stats(VALUE self)
+{
+  if(BKGE::engine == nullptr) return Qnil;
+
+  auto asset_cache{BKGE::engine->get_asset_cache()};
+  VALUE stats = rb_hash_new();
+
+  rb_hash_aset(stats, ID2SYM(rb_intern("model_hits")),
+               ULL2NUM(asset_cache->geometries.get_hits()));
+  rb_hash_aset(stats, ID2SYM(rb_intern("model_misses")),
+               ULL2NUM(asset_cache->geometries.get_misses()));
+  rb_hash_aset(stats, ID2SYM(rb_intern("models_resident")),
+               SIZET2NUM(asset_cache->geometries.resident()));
+  rb_hash_aset(stats, ID2SYM(rb_intern("texture_hits")),
+               ULL2NUM(asset_cache->textures.get_hits()));
+  rb_hash_aset(stats, ID2SYM(rb_intern("texture_misses")),
+               ULL2NUM(asset_cache->textures.get_misses()));
+  rb_hash_aset(stats, ID2SYM(rb_intern("textures_resident")),
+               SIZET2NUM(asset_cache->textures.resident()));
+
+  return stats;
+}
+
+VALUE
+bk_mEngine_memory_stats(VALUE self)
+{
+  if(BKGE::engine == nullptr) return Qnil;
+
+  auto device{BKGE::engine->get_devices()[0]};
+  auto residency{BKGE::engine->get_residency()};
+  const auto &memory_properties{device->get_memory_properties()};
+  const auto &heap_stats{device->get_memory_allocator()->get_heap_stats()};
+  auto budgets{device->get_memory_budgets()};
+
+  VALUE heaps = rb_ary_new_capa(memory_properties.memoryHeapCount);
+  for(uint32_t i{0}; i < memory_properties.memoryHeapCount; i++)
+  {
+    VALUE heap = rb_hash_new();
+    rb_hash_aset(heap, ID2SYM(rb_intern("size")),
+                 ULL2NUM(memory_properties.memoryHeaps[i].size));
+    rb_hash_aset(heap, ID2SYM(rb_intern("device_local")),
+                 memory_properties.memoryHeaps[i].flags &
+                 VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? Qtrue : Qfalse);
+    rb_hash_aset(heap, ID2SYM(rb_intern("reserved")),
+                 ULL2NUM(heap_stats[i].reserved_bytes));
+    rb_hash_aset(heap, ID2SYM(rb_intern("used")),
+                 ULL2NUM(heap_stats[i].used_bytes));
+    rb_hash_aset(heap, ID2SYM(rb_intern("blocks")),
+                 UINT2NUM(heap_stats[i].block_count));
+    rb_hash_aset(heap, ID2SYM(rb_intern("allocations")),
+                 UINT2NUM(heap_stats[i].allocation_count));
+    rb_hash_aset(heap, ID2SYM(rb_intern("budget")),
+                 ULL2NUM(budgets[i].budget));
+    rb_hash_aset(heap, ID2SYM(rb_intern("usage")),
+                 ULL2NUM(budgets[i].usage));
+    rb_ary_push(heaps, heap);
+  }
+
+  VALUE stats = rb_hash_new();
+  rb_hash_aset(stats, ID2SYM(rb_intern("heaps")), heaps);
+  rb_hash_aset(stats, ID2SYM(rb_intern("driver_budget")),
+               device->get_memory_budget() ? Qtrue : Qfalse);
+  rb_hash_aset(stats, ID2SYM(rb_intern("memory_budget")),
+               ULL2NUM(residency->get_budget()));
+  rb_hash_aset(stats, ID2SYM(rb_intern("evictions")),
+               ULL2NUM(residency->get_evictions()));
+  rb_hash_aset(stats, ID2SYM(rb_intern("restreams")),
+               ULL2NUM(residency->get_restreams()));
+
+  return stats;
+}
+
+VALUE
+bk_mEngine_render_stats(VALUE self)
+{
+  if(BKGE::engine == nullptr) return Qnil;
+
+  size_t lod_count{std::min<size_t>(
+      BKGE::engine->get_lod_screen_sizes().size() + 1, bk_max_lods)};
+  const auto &lod_instances{BKGE::engine->get_lod_instances()};
+  const auto &lod_triangles{BKGE::engine->get_lod_triangles()};
+
+  VALUE instances = rb_ary_new_capa(lod_count);
+  VALUE triangles = rb_ary_new_capa(lod_count);
+  for(size_t i{0}; i < lod_count; i++)
+  {
+    rb_ary_push(instances, UINT2NUM(lod_instances[i]));
+    rb_ary_push(triangles, ULL2NUM(lod_triangles[i]));
+  }
+
+  VALUE stats = rb_hash_new();
+  rb_hash_aset(stats, ID2SYM(rb_intern("lod_instances")), instances);
+  rb_hash_aset(stats, ID2SYM(rb_intern("lod_triangles")), triangles);
+  rb_hash_aset(stats, ID2SYM(rb_intern("occluded_instances")),
+               UINT2NUM(BKGE::engine->get_occluded_instances()));
+  rb_hash_aset(stats, ID2SYM(rb_intern("updated_transforms")),
+               UINT2NUM(BKGE::engine->get_updated_transforms()));
+  rb_hash_aset(stats, ID2SYM(rb_intern("gvl_released_seconds")),
+               rb_float_new(
+                   BKGE::engine->get_gvl_release()->get_last_frame_seconds()));
+
+  return stats;
+}
+
 VALUE
 bk_mEngine_unload_core(VALUE self)
 {
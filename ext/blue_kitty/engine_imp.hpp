@@ -2,27 +2,36 @@
 #ifndef BLUE_KITTY_ENGINE_IMP_HPP
 #define BLUE_KITTY_ENGINE_IMP_HPP 1
 
+#include <array>
 #include <memory>
 #include <string>
-#include <unordered_map>
 
 #include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
 #include <SDL2/SDL_vulkan.h>
 
 #include "ruby.h"
 
+#include "asset_cache.hpp"
 #include "core_data.h"
+#include "frame_arena.hpp"
+#include "gvl_release.hpp"
 #include "loader.hpp"
 #include "model_imp.hpp"
+#include "residency.hpp"
 #include "vk_command_pool.hpp"
+#include "vk_depth_pyramid.hpp"
 #include "vk_descriptor_set_layout_model_instance.hpp"
 #include "vk_descriptor_set_layout_view_projection.hpp"
 #include "vk_device.hpp"
+#include "vk_geometry_pool.hpp"
 #include "vk_graphic_pipeline.hpp"
 #include "vk_graphic_pipeline_layout.hpp"
 #include "vk_instance.hpp"
 #include "vk_queue_family.hpp"
+#include "vk_staging_ring.hpp"
 #include "vk_swapchain.hpp"
+#include "vk_texture_table.hpp"
 
 namespace BKGE
 {
@@ -34,6 +43,14 @@ struct ErrRender
   ErrRender(const char &em);
 };
 
+// Entities that share a model, they are drawn as instances of one draw call
+// for each level of detail in use.
+struct ModelGroup
+{
+  VALUE model;
+  Span<VALUE> entities;
+};
+
 class Engine
 {
   friend class Loader::Stack<Engine>;
@@ -44,15 +61,51 @@ class Engine
 
   inline std::shared_ptr<bk_sCoreData> get_core_data() const
   { return this->core_data; };
-  inline std::vector<std::shared_ptr<BKVK::Device>> get_devices() const
+  inline std::shared_ptr<AssetCache> get_asset_cache() const
+  { return this->asset_cache; };
+  inline std::shared_ptr<Residency> get_residency() const
+  { return this->residency; };
+  // Memory for data of the current frame, reset after every frame.
+  inline FrameArena *get_frame_arena() const
+  { return this->frame_arena.get(); };
+  inline GVLRelease *get_gvl_release() const
+  { return this->gvl_release.get(); };
+  inline const std::vector<std::shared_ptr<BKVK::Device>> &get_devices() const
   { return this->devices; };
   inline double get_max_frame_duration() const
   { return this->max_frame_duration; };
-  inline std::vector<std::shared_ptr<BKVK::QueueFamily>>
-  get_queues_families_with_graphics() const
+  inline bool get_quantize_positions() const
+  { return this->quantize_positions; };
+  inline const std::vector<float> &get_lod_screen_sizes() const
+  { return this->lod_screen_sizes; };
+  // Instances and triangles drawn with each level of detail in the last
+  // frame.
+  inline const std::array<uint32_t, bk_max_lods> &get_lod_instances() const
+  { return this->lod_instances; };
+  inline const std::array<uint64_t, bk_max_lods> &get_lod_triangles() const
+  { return this->lod_triangles; };
+  // Instances not drawn in the last frame because they were hidden.
+  inline uint32_t get_occluded_instances() const
+  { return this->occluded_instances; };
+  // Matrices computed again in the last frame, the others were cached.
+  inline uint32_t get_updated_transforms() const
+  { return this->updated_transforms; };
+  inline const std::vector<std::shared_ptr<BKVK::QueueFamily>>
+  &get_queues_families_with_graphics() const
   { return this->queues_families_with_graphics; };
+  inline std::shared_ptr<BKVK::StagingRing> get_staging_ring() const
+  { return this->staging_ring; };
+  // Geometries with less than 65536 vertexes use 16-bit indexes.
+  inline std::shared_ptr<BKVK::GeometryPool> get_geometry_pool(
+      VkIndexType vk_index_type) const
+  {
+    return vk_index_type == VK_INDEX_TYPE_UINT16 ?
+        this->geometry_pool_16 : this->geometry_pool_32;
+  };
   inline std::shared_ptr<BKVK::Swapchain> get_swapchain() const
   { return this->swapchain; };
+  inline std::shared_ptr<BKVK::TextureTable> get_texture_table() const
+  { return this->texture_table; };
   inline std::shared_ptr<BKVK::GraphicPipelineLayout>
   get_graphic_pipeline_layout() const
   { return this->graphic_pipeline_layout; };
@@ -61,13 +114,19 @@ class Engine
   void unload_vk_draw_command_pool();
 
   // Rendering to screen.
-  void render(
-      VALUE camera,
-      const std::unordered_map<VALUE, std::vector<VALUE>> &model_entities);
+  // Wait, without the GVL, until the GPU is done with the frame that used the
+  // same slot. Must be called before any Ruby object of the next frame is
+  // kept in the frame arena, where the GC does not see it.
+  void wait_for_frame();
+  void render(VALUE camera, Span<ModelGroup> model_groups);
 
  private:
   Loader::Stack<Engine> loader;
   std::shared_ptr<bk_sCoreData> core_data;
+  std::shared_ptr<AssetCache> asset_cache;
+  std::shared_ptr<Residency> residency;
+  std::unique_ptr<FrameArena> frame_arena;
+  std::unique_ptr<GVLRelease> gvl_release;
 
   VkDebugUtilsMessengerEXT vk_callback;
 
@@ -80,15 +139,41 @@ class Engine
   std::vector<std::shared_ptr<BKVK::QueueFamily>>
   queues_families_with_presentation;
 
+  std::shared_ptr<BKVK::StagingRing> staging_ring;
+  std::shared_ptr<BKVK::GeometryPool> geometry_pool_16, geometry_pool_32;
   std::shared_ptr<BKVK::Swapchain> swapchain;
+  std::shared_ptr<BKVK::TextureTable> texture_table;
   std::shared_ptr<BKVK::DSL::ModelInstance> dsl_model_instance;
   std::shared_ptr<BKVK::DSL::ViewProjection> dsl_view_projection;
   std::shared_ptr<BKVK::GraphicPipelineLayout> graphic_pipeline_layout;
   std::shared_ptr<BKVK::GraphicPipeline> graphic_pipeline;
+  // Back faces are culled and hidden fragments fail the depth test.
+  BKVK::PipelineState opaque_pipeline_state;
+  // Null when occlusion culling is disabled.
+  std::unique_ptr<BKVK::DepthPyramid> depth_pyramid;
 
   std::unique_ptr<BKVK::CommandPool> draw_command_pool;
 
   double max_frame_duration;
+  // Device-local memory the game may use in bytes, 0 to follow the driver.
+  VkDeviceSize memory_budget;
+  // Store vertex positions as unorm16 relative to the bounds of the geometry.
+  bool quantize_positions;
+  // Level of detail i + 1 is drawn when a geometry covers less than
+  // lod_screen_sizes[i] of the screen height.
+  std::vector<float> lod_screen_sizes;
+  // An instance changes level only when it is this fraction past the
+  // threshold, so it does not pop back and forth while near it.
+  const float lod_hysteresis = 0.1f;
+  std::array<uint32_t, bk_max_lods> lod_instances;
+  std::array<uint64_t, bk_max_lods> lod_triangles;
+  // Skip instances hidden behind the depth of a recent frame.
+  bool occlusion_culling;
+  uint32_t occluded_instances;
+  uint32_t updated_transforms;
+
+  // Vertical, in degrees.
+  const float field_of_view = 45.0f;
 
   // Buffering control.
   const int max_frames_in_flight = 2;
@@ -97,6 +182,17 @@ class Engine
   std::vector<VkSemaphore> vk_render_finished_semaphores;
   std::vector<VkFence> vk_in_flight_fences;
 
+  // Staging memory used to upload data to the GPU.
+  const VkDeviceSize staging_ring_size = 16 * 1024 * 1024;
+  const uint32_t staging_ring_slots = 8;
+
+  // Initial size of the frame arena, it grows if a frame needs more.
+  const size_t frame_arena_size = 64 * 1024;
+
+  // Size of each buffer of the geometry pool, in vertexes and indexes.
+  const uint32_t geometry_pool_vertexes = 1024 * 1024;
+  const uint32_t geometry_pool_indexes = 4 * 1024 * 1024;
+
   // Initialization and destruction.
   void load_variables();
   void unload_variables();
@@ -116,9 +212,30 @@ class Engine
   void load_vk_devices();
   void unload_vk_devices();
 
+  void load_vk_staging_ring();
+  void unload_vk_staging_ring();
+
+  void load_geometry_pool();
+  void unload_geometry_pool();
+
+  void load_asset_cache();
+  void unload_asset_cache();
+
+  void load_residency();
+  void unload_residency();
+
+  void load_frame_arena();
+  void unload_frame_arena();
+
+  void load_gvl_release();
+  void unload_gvl_release();
+
   void load_vk_swapchain();
   void unload_vk_swapchain();
 
+  void load_vk_texture_table();
+  void unload_vk_texture_table();
+
   void load_vk_descriptor_set_layouts();
   void unload_vk_descriptor_set_layouts();
 
@@ -128,11 +245,19 @@ class Engine
   void load_vk_graphic_pipelines();
   void unload_vk_graphic_pipelines();
 
+  void load_depth_pyramid();
+  void unload_depth_pyramid();
+
   void load_vk_frame_sync();
   void unload_vk_frame_sync();
 
-  glm::mat4 update_ub_model_instance(
-      uint32_t image_index, VALUE entity3d, bk_model_data* model_data);
+  // Matrices are cached in the @transform of entities and cameras.
+  glm::mat4 model_matrix(VALUE entity3d);
+  glm::mat4 view_matrix(VALUE camera);
+  // Level of detail for an instance with its bounds centered at center.
+  uint32_t select_lod(VALUE entity3d, const glm::vec3 &center,
+                      const bk_sGeometry *geometry,
+                      const glm::vec3 &camera_position);
 };
 
 extern Engine *engine;
@@ -1,9 +1,29 @@
 # SPDX-License-Identifier: MIT
 require "mkmf"
+require_relative "shader_spirv"
 
 $CXXFLAGS += " -std=gnu++17 "
+# Vulkan depth goes from 0 to 1, not from -1 to 1 like in OpenGL.
+$CXXFLAGS += " -DGLM_FORCE_DEPTH_ZERO_TO_ONE "
+
+# Count heap allocations of the render loop, see allocation_counter.hpp.
+if enable_config("allocation-counter", false)
+  $CXXFLAGS += " -DBLUE_KITTY_COUNT_ALLOCATIONS "
+end
 
 libs = %w{SDL2 SDL2_image vulkan}
 libs.each {|lib| have_library(lib)}
 
 create_makefile("blue_kitty/blue_kitty")
+
+# vk_device.cpp includes the SPIR-V header, which is not in git. Make writes
+# it from the shaders, and again when one of them changes.
+File.open("Makefile", "a") do |makefile|
+  makefile.puts(<<~MAKE)
+
+    vk_device.$(OBJEXT): #{ShaderSPIRV::HEADER}
+    #{ShaderSPIRV::HEADER}: #{ShaderSPIRV.sources.join(" ")}
+    \t$(RUBY) -r#{File.expand_path("shader_spirv", __dir__)} \\
+    \t  -e ShaderSPIRV.generate
+  MAKE
+end
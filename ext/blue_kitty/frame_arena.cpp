@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "loader.hpp"
+
+namespace BKGE
+{
+FrameArena::FrameArena(size_t capacity):
+    offset{0},
+    capacity{capacity},
+    used{0},
+    peak{0}
+{
+  this->block = this->create_block(capacity, nullptr);
+}
+
+FrameArena::~FrameArena()
+{
+  while(this->block)
+  {
+    Block *previous{this->block->previous};
+    std::free(this->block);
+    this->block = previous;
+  }
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment)
+{
+  // Data starts right after the header of the block.
+  uintptr_t base{reinterpret_cast<uintptr_t>(this->block + 1)};
+  uintptr_t aligned{
+    (base + this->offset + alignment - 1) & ~(uintptr_t{alignment} - 1)};
+
+  if(aligned + size > base + this->block->size)
+  {
+    // Blocks use malloc alignment, which is enough for any type.
+    this->block = this->create_block(
+        std::max(size, this->block->size), this->block);
+    this->offset = 0;
+    base = reinterpret_cast<uintptr_t>(this->block + 1);
+    aligned = base;
+  }
+
+  size_t padding{aligned - (base + this->offset)};
+  this->offset = aligned - base + size;
+  this->used += padding + size;
+
+  return reinterpret_cast<void*>(aligned);
+}
+
+void FrameArena::reset()
+{
+  this->peak = std::max(this->peak, this->used);
+
+  // Merge chained blocks into one that fits the whole frame.
+  if(this->block->previous)
+  {
+    while(this->block)
+    {
+      Block *previous{this->block->previous};
+      std::free(this->block);
+      this->block = previous;
+    }
+    this->capacity = std::max(this->capacity * 2, this->peak);
+    this->block = this->create_block(this->capacity, nullptr);
+  }
+
+  this->offset = 0;
+  this->used = 0;
+}
+
+FrameArena::Block *FrameArena::create_block(size_t size, Block *previous)
+{
+  // Memory for the arena itself does not go through operator new, so it is
+  // not counted as an allocation of the render loop.
+  Block *block{static_cast<Block*>(std::malloc(sizeof(Block) + size))};
+  if(!block) throw Loader::Error{"Could not allocate frame arena memory."};
+
+  block->previous = previous;
+  block->size = size;
+  return block;
+}
+}
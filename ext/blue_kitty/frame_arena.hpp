@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_FRAME_ARENA_HPP
+#define BLUE_KITTY_FRAME_ARENA_HPP 1
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace BKGE
+{
+// A view of contiguous elements, like std::span of C++20.
+template<typename T>
+struct Span
+{
+  T *data;
+  size_t size;
+
+  inline T *begin() const { return this->data; };
+  inline T *end() const { return this->data + this->size; };
+  inline T &operator[](size_t i) const { return this->data[i]; };
+};
+
+/*
+  Memory for data that only lives during one frame. Allocation moves a
+  pointer forward and reset() frees everything at once. When a frame needs
+  more than the arena has, extra blocks are chained and, at the next reset,
+  replaced by a single block big enough for all of them; after a few frames
+  the arena stops asking the system for memory.
+*/
+class FrameArena
+{
+  FrameArena(const FrameArena &t) = delete;
+  FrameArena& operator=(const FrameArena &t) = delete;
+  FrameArena(const FrameArena &&t) = delete;
+  FrameArena& operator=(const FrameArena &&t) = delete;
+
+ public:
+  explicit FrameArena(size_t capacity);
+  ~FrameArena();
+
+  inline size_t get_capacity() const { return this->capacity; };
+  // Most bytes used by a single frame.
+  inline size_t get_peak() const { return this->peak; };
+
+  void *allocate(size_t size, size_t alignment);
+
+  // Only for types without destructors, nothing is destroyed at reset.
+  template<typename T>
+  Span<T> allocate_array(size_t count);
+
+  void reset();
+
+ private:
+  struct Block
+  {
+    Block *previous;
+    size_t size;
+  };
+
+  // The current block, older ones are chained through "previous".
+  Block *block;
+  size_t offset;
+  size_t capacity;
+  size_t used, peak;
+
+  Block *create_block(size_t size, Block *previous);
+};
+
+template<typename T>
+Span<T> FrameArena::allocate_array(size_t count)
+{
+  static_assert(std::is_trivially_destructible<T>::value,
+                "FrameArena does not call destructors.");
+
+  T *data{static_cast<T*>(this->allocate(sizeof(T) * count, alignof(T)))};
+  for(size_t i{0}; i < count; i++) new(data + i) T{};
+
+  return Span<T>{data, count};
+}
+}
+
+#endif /* BLUE_KITTY_FRAME_ARENA_HPP */
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+#include "gvl_release.hpp"
+
+#include "ruby.h"
+#include "ruby/thread.h"
+
+namespace BKGE
+{
+GVLRelease::GVLRelease():
+    interrupted{false},
+    frame_time{0},
+    last_frame_time{0}
+{
+}
+
+void GVLRelease::wait_for_fence(VkDevice vk_device, VkFence vk_fence)
+{
+  struct Wait
+  {
+    GVLRelease *gvl_release;
+    VkDevice vk_device;
+    VkFence vk_fence;
+    VkResult result;
+  };
+  Wait wait{this, vk_device, vk_fence, VK_TIMEOUT};
+
+  while(true)
+  {
+    this->without_gvl([](void *data) -> void *
+    {
+      Wait *wait{static_cast<Wait*>(data)};
+      do
+        wait->result = vkWaitForFences(
+            wait->vk_device, 1, &wait->vk_fence, VK_TRUE,
+            wait->gvl_release->fence_poll_nanoseconds);
+      while(wait->result == VK_TIMEOUT &&
+            !wait->gvl_release->is_interrupted());
+      return nullptr;
+    }, &wait);
+
+    if(wait.result != VK_TIMEOUT) return;
+    rb_thread_check_ints();
+  }
+}
+
+void GVLRelease::sleep(uint32_t milliseconds)
+{
+  struct Sleep
+  {
+    GVLRelease *gvl_release;
+    std::chrono::steady_clock::time_point deadline;
+  };
+  Sleep sleep{this, std::chrono::steady_clock::now() +
+    std::chrono::milliseconds{milliseconds}};
+
+  while(std::chrono::steady_clock::now() < sleep.deadline)
+  {
+    this->without_gvl([](void *data) -> void *
+    {
+      Sleep *sleep{static_cast<Sleep*>(data)};
+      GVLRelease *gvl_release{sleep->gvl_release};
+      std::unique_lock<std::mutex> lock{gvl_release->mutex};
+      gvl_release->wake.wait_until(
+          lock, sleep->deadline,
+          [gvl_release]{ return gvl_release->interrupted; });
+      return nullptr;
+    }, &sleep);
+
+    if(this->is_interrupted()) rb_thread_check_ints();
+  }
+}
+
+void GVLRelease::next_frame()
+{
+  this->last_frame_time = this->frame_time;
+  this->frame_time = std::chrono::steady_clock::duration{0};
+}
+
+void GVLRelease::without_gvl(void *(*func)(void *), void *data)
+{
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->interrupted = false;
+  }
+
+  auto start{std::chrono::steady_clock::now()};
+  rb_thread_call_without_gvl(func, data, &GVLRelease::unblock, this);
+  this->frame_time += std::chrono::steady_clock::now() - start;
+}
+
+bool GVLRelease::is_interrupted()
+{
+  std::lock_guard<std::mutex> lock{this->mutex};
+  return this->interrupted;
+}
+
+// Called by Ruby, from another thread, to interrupt a wait.
+void GVLRelease::unblock(void *gvl_release)
+{
+  GVLRelease *self{static_cast<GVLRelease*>(gvl_release)};
+  {
+    std::lock_guard<std::mutex> lock{self->mutex};
+    self->interrupted = true;
+  }
+  self->wake.notify_all();
+}
+}
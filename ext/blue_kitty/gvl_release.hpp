@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_GVL_RELEASE_HPP
+#define BLUE_KITTY_GVL_RELEASE_HPP 1
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+namespace BKGE
+{
+/*
+  Blocking waits of the frame loop, done without Ruby's global VM lock so
+  other Ruby threads run while the engine waits for the GPU or for the next
+  frame. When Ruby interrupts the main thread (Thread#raise, Ctrl-C, a trap),
+  the wait returns, Ruby handles the interrupt with the lock held, and the
+  wait goes on unless the interrupt raised.
+*/
+class GVLRelease
+{
+  GVLRelease(const GVLRelease &t) = delete;
+  GVLRelease& operator=(const GVLRelease &t) = delete;
+  GVLRelease(const GVLRelease &&t) = delete;
+  GVLRelease& operator=(const GVLRelease &&t) = delete;
+
+ public:
+  explicit GVLRelease();
+
+  void wait_for_fence(VkDevice vk_device, VkFence vk_fence);
+  void sleep(uint32_t milliseconds);
+
+  // Start counting the time of a new frame.
+  void next_frame();
+  // Time the last frame spent waiting without the lock.
+  inline double get_last_frame_seconds() const
+  { return std::chrono::duration<double>(this->last_frame_time).count(); };
+
+ private:
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool interrupted;
+
+  std::chrono::steady_clock::duration frame_time;
+  std::chrono::steady_clock::duration last_frame_time;
+
+  // A fence wait checks for interrupts this often, Vulkan can not be woken.
+  const uint64_t fence_poll_nanoseconds = 2'000'000;
+
+  void without_gvl(void *(*func)(void *), void *data);
+  bool is_interrupted();
+  static void unblock(void *gvl_release);
+};
+}
+
+#endif /* BLUE_KITTY_GVL_RELEASE_HPP */
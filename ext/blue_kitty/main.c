@@ -7,7 +7,9 @@
 #include "keycode.h"
 #include "model.h"
 #include "texture.h"
+#include "transform.h"
 #include "vector3d.h"
+#include "vector3d_array.h"
 
 VALUE bk_m;
 
@@ -24,9 +26,11 @@ Init_blue_kitty(void)
 
   Init_blue_kitty_error();
   Init_blue_kitty_vector3d();
+  Init_blue_kitty_vector3d_array();
   Init_blue_kitty_keycode();
   Init_blue_kitty_input_device();
   Init_blue_kitty_engine();
   Init_blue_kitty_texture();
   Init_blue_kitty_model();
+  Init_blue_kitty_transform();
 }
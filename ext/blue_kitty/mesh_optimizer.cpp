@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: MIT
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+// Values from the original article.
+const float cache_decay_power{1.5f};
+const float last_triangle_score{0.75f};
+const float valence_boost_scale{2.0f};
+const float valence_boost_power{0.5f};
+
+float vertex_score(int32_t cache_position, uint32_t remaining_triangles)
+{
+  if(remaining_triangles == 0) return -1.0f;
+
+  float score{0.0f};
+  if(cache_position >= 0)
+  {
+    // The vertexes of the last triangle get a fixed score, so the next
+    // triangle does not always reuse its newest edge.
+    if(cache_position < 3)
+      score = last_triangle_score;
+    else
+      score = std::pow(
+          1.0f - static_cast<float>(cache_position - 3) /
+          (BKGE::MeshOptimizer::cache_size - 3), cache_decay_power);
+  }
+
+  // Vertexes with few triangles left are finished first, otherwise they
+  // would be transformed again much later.
+  score += valence_boost_scale *
+      std::pow(static_cast<float>(remaining_triangles), -valence_boost_power);
+
+  return score;
+}
+
+// Finest grid tried by simplify, cells are 1/1024 of the bounds.
+const uint32_t max_grid{1024};
+
+std::vector<uint32_t> cluster(
+    const glm::vec3 *positions, const uint32_t *indexes, uint32_t index_count,
+    const glm::vec3 &min_position, const glm::vec3 &extent, uint32_t grid)
+{
+  auto cell_of = [&](uint32_t vertex)
+  {
+    uint32_t cell{0};
+    for(int axis{2}; axis >= 0; axis--)
+    {
+      uint32_t coordinate{0};
+      if(extent[axis] > 0.0f)
+        coordinate = static_cast<uint32_t>(
+            (positions[vertex][axis] - min_position[axis]) / extent[axis] *
+            grid);
+      cell = cell * grid + std::min(coordinate, grid - 1);
+    }
+    return cell;
+  };
+
+  // Each cell keeps the vertex closest to the average of its vertexes, so
+  // the surface moves as little as possible.
+  struct Cell
+  {
+    glm::vec3 sum;
+    uint32_t count;
+    uint32_t vertex;
+    float distance;
+  };
+  std::unordered_map<uint32_t, Cell> cells;
+  for(uint32_t i{0}; i < index_count; i++)
+  {
+    Cell &cell{cells.try_emplace(
+        cell_of(indexes[i]), Cell{glm::vec3{0.0f}, 0, 0,
+                                  std::numeric_limits<float>::max()}).
+               first->second};
+    cell.sum += positions[indexes[i]];
+    cell.count++;
+  }
+  for(uint32_t i{0}; i < index_count; i++)
+  {
+    Cell &cell{cells.at(cell_of(indexes[i]))};
+    glm::vec3 offset{positions[indexes[i]] - cell.sum / float(cell.count)};
+    float distance{glm::dot(offset, offset)};
+    if(distance < cell.distance)
+    {
+      cell.distance = distance;
+      cell.vertex = indexes[i];
+    }
+  }
+
+  std::vector<uint32_t> result;
+  for(uint32_t i{0}; i + 2 < index_count; i += 3)
+  {
+    uint32_t a{cells.at(cell_of(indexes[i])).vertex};
+    uint32_t b{cells.at(cell_of(indexes[i + 1])).vertex};
+    uint32_t c{cells.at(cell_of(indexes[i + 2])).vertex};
+    if(a == b || b == c || c == a) continue;
+
+    result.push_back(a);
+    result.push_back(b);
+    result.push_back(c);
+  }
+
+  return result;
+}
+}
+
+namespace BKGE
+{
+namespace MeshOptimizer
+{
+float acmr(const uint32_t *indexes, uint32_t index_count)
+{
+  uint32_t triangle_count{index_count / 3};
+  if(triangle_count == 0) return 0.0f;
+
+  // A FIFO cache: a vertex leaves it after cache_size misses.
+  std::vector<uint32_t> entered_at(
+      *std::max_element(indexes, indexes + index_count) + 1, 0);
+  uint32_t misses{0};
+  for(uint32_t i{0}; i < triangle_count * 3; i++)
+  {
+    uint32_t &entered{entered_at[indexes[i]]};
+    if(entered == 0 || misses - entered >= cache_size)
+    {
+      misses++;
+      entered = misses;
+    }
+  }
+
+  return static_cast<float>(misses) / triangle_count;
+}
+
+void optimize_vertex_cache(uint32_t *indexes, uint32_t index_count)
+{
+  uint32_t triangle_count{index_count / 3};
+  if(triangle_count < 2) return;
+
+  // Work with vertexes numbered from zero, a mesh may use only a part of the
+  // vertexes of its geometry.
+  uint32_t first_vertex{*std::min_element(indexes, indexes + index_count)};
+  uint32_t vertex_count{
+    *std::max_element(indexes, indexes + index_count) - first_vertex + 1};
+  std::vector<uint32_t> triangles(triangle_count * 3);
+  for(uint32_t i{0}; i < triangle_count * 3; i++)
+    triangles[i] = indexes[i] - first_vertex;
+
+  // Triangles of each vertex that were not added yet. The first
+  // remaining[v] entries of the list of a vertex are the ones left.
+  std::vector<uint32_t> remaining(vertex_count, 0);
+  for(auto vertex: triangles) remaining[vertex]++;
+  std::vector<uint32_t> adjacency_begin(vertex_count + 1, 0);
+  for(uint32_t v{0}; v < vertex_count; v++)
+    adjacency_begin[v + 1] = adjacency_begin[v] + remaining[v];
+  std::vector<uint32_t> adjacency(triangle_count * 3);
+  {
+    std::vector<uint32_t> filled(vertex_count, 0);
+    for(uint32_t i{0}; i < triangle_count * 3; i++)
+    {
+      uint32_t vertex{triangles[i]};
+      adjacency[adjacency_begin[vertex] + filled[vertex]++] = i / 3;
+    }
+  }
+
+  std::vector<int32_t> cache_position(vertex_count, -1);
+  std::vector<float> score(vertex_count);
+  for(uint32_t v{0}; v < vertex_count; v++)
+    score[v] = vertex_score(-1, remaining[v]);
+
+  std::vector<bool> added(triangle_count, false);
+  std::vector<uint32_t> cache, new_cache;
+  cache.reserve(cache_size + 3);
+  new_cache.reserve(cache_size + 3);
+
+  uint32_t output{0};
+  uint32_t next_unadded{0};
+  int64_t best_triangle{0};
+  for(uint32_t n{0}; n < triangle_count; n++)
+  {
+    // No triangle touches the cache, start again from the first one left.
+    if(best_triangle < 0)
+    {
+      while(added[next_unadded]) next_unadded++;
+      best_triangle = next_unadded;
+    }
+
+    uint32_t *triangle{&triangles[best_triangle * 3]};
+    added[best_triangle] = true;
+    for(int i{0}; i < 3; i++)
+    {
+      uint32_t vertex{triangle[i]};
+      indexes[output++] = vertex + first_vertex;
+
+      // Remove the triangle from the list of the vertex.
+      uint32_t *list{&adjacency[adjacency_begin[vertex]]};
+      uint32_t *found{std::find(list, list + remaining[vertex],
+                                static_cast<uint32_t>(best_triangle))};
+      std::swap(*found, list[remaining[vertex] - 1]);
+      remaining[vertex]--;
+    }
+
+    // The vertexes of the triangle go to the front of the cache.
+    new_cache.assign(triangle, triangle + 3);
+    for(auto vertex: cache)
+      if(vertex != triangle[0] && vertex != triangle[1] &&
+         vertex != triangle[2])
+        new_cache.push_back(vertex);
+
+    for(uint32_t i{0}; i < new_cache.size(); i++)
+    {
+      uint32_t vertex{new_cache[i]};
+      cache_position[vertex] = i < cache_size ? static_cast<int32_t>(i) : -1;
+      score[vertex] = vertex_score(cache_position[vertex], remaining[vertex]);
+    }
+    if(new_cache.size() > cache_size) new_cache.resize(cache_size);
+    std::swap(cache, new_cache);
+
+    // Only triangles with a vertex in the cache changed their score.
+    best_triangle = -1;
+    float best_score{-1.0f};
+    for(auto vertex: cache)
+    {
+      for(uint32_t i{0}; i < remaining[vertex]; i++)
+      {
+        uint32_t t{adjacency[adjacency_begin[vertex] + i]};
+        float triangle_score{
+          score[triangles[t * 3]] + score[triangles[t * 3 + 1]] +
+          score[triangles[t * 3 + 2]]};
+        if(triangle_score > best_score)
+        {
+          best_score = triangle_score;
+          best_triangle = t;
+        }
+      }
+    }
+  }
+}
+
+std::vector<uint32_t> optimize_vertex_fetch(
+    std::vector<uint32_t> &indexes, uint32_t vertex_count)
+{
+  const uint32_t unused{std::numeric_limits<uint32_t>::max()};
+  std::vector<uint32_t> remap(vertex_count, unused);
+  uint32_t next{0};
+
+  for(auto &index: indexes)
+  {
+    if(remap[index] == unused) remap[index] = next++;
+    index = remap[index];
+  }
+  for(auto &position: remap)
+    if(position == unused) position = next++;
+
+  return remap;
+}
+std::vector<uint32_t> simplify(
+    const glm::vec3 *positions, const uint32_t *indexes, uint32_t index_count,
+    uint32_t target_index_count)
+{
+  if(index_count <= target_index_count)
+    return std::vector<uint32_t>(indexes, indexes + index_count);
+
+  glm::vec3 min_position{std::numeric_limits<float>::max()};
+  glm::vec3 max_position{std::numeric_limits<float>::lowest()};
+  for(uint32_t i{0}; i < index_count; i++)
+  {
+    min_position = glm::min(min_position, positions[indexes[i]]);
+    max_position = glm::max(max_position, positions[indexes[i]]);
+  }
+  glm::vec3 extent{max_position - min_position};
+
+  // Finer grids keep more triangles. Search for the finest one that is
+  // still under the target.
+  std::vector<uint32_t> best;
+  uint32_t low{1}, high{max_grid + 1};
+  while(high - low > 1)
+  {
+    uint32_t grid{low + (high - low) / 2};
+    std::vector<uint32_t> result{cluster(
+        positions, indexes, index_count, min_position, extent, grid)};
+    if(result.size() <= target_index_count)
+    {
+      low = grid;
+      best = std::move(result);
+    }
+    else high = grid;
+  }
+
+  return best;
+}
+}
+}
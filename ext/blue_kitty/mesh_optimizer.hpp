@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_MESH_OPTIMIZER_HPP
+#define BLUE_KITTY_MESH_OPTIMIZER_HPP 1
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace BKGE
+{
+namespace MeshOptimizer
+{
+// Size of the post-transform cache simulated by the functions below. Real
+// caches differ between GPUs, orders that are good for 32 entries are also
+// good for most of them.
+const uint32_t cache_size = 32;
+
+// Average cache miss ratio: transformed vertexes per triangle, between 0.5 in
+// the best case and 3.0 in the worst.
+float acmr(const uint32_t *indexes, uint32_t index_count);
+
+// Reorder the triangles of a list so vertexes shared by nearby triangles are
+// still in the post-transform cache (Tom Forsyth's linear-speed algorithm).
+void optimize_vertex_cache(uint32_t *indexes, uint32_t index_count);
+
+// Renumber vertexes in the order the triangles first use them, so the vertex
+// fetch reads memory in sequence. Return the new position of each old vertex;
+// vertexes no triangle uses go to the end.
+std::vector<uint32_t> optimize_vertex_fetch(
+    std::vector<uint32_t> &indexes, uint32_t vertex_count);
+
+// Merge the vertexes that fall in the same cell of a grid over the bounds of
+// the triangles (vertex clustering), using the finest grid that leaves at most
+// target_index_count indexes. Triangles that collapse are dropped. The result
+// indexes the same vertexes as the source, so both share a vertex buffer.
+std::vector<uint32_t> simplify(
+    const glm::vec3 *positions, const uint32_t *indexes, uint32_t index_count,
+    uint32_t target_index_count);
+}
+}
+
+#endif /* BLUE_KITTY_MESH_OPTIMIZER_HPP */
@@ -2,17 +2,25 @@
 #include "model.h"
 #include "model_imp.hpp"
 
+#include <algorithm>
 #include <array>
 #include <fstream>
+#include <limits>
+#include <sstream>
 
 #include <glm/glm.hpp>
 
 #include "engine.h"
 #include "engine_imp.hpp"
+#include "log.hpp"
+#include "mesh_optimizer.hpp"
 #include "vk_vertex.hpp"
 
 namespace
 {
+// Meshes with fewer triangles are not simplified any further.
+const uint32_t min_lod_triangles{64};
+
 uint32_t read_uint32_from_file(std::ifstream &input_file)
 {
   uint32_t data{};
@@ -85,8 +93,7 @@ bk_free_model(void* obj)
 size_t
 bk_memsize_model(const void* obj)
 {
-  // TODO
-  return 0;
+  return static_cast<const bk_model_data*>(obj)->memsize();
 }
 
 /*
@@ -111,13 +118,14 @@ bk_cModel_initialize(VALUE self, VALUE file_path, VALUE texture)
   TypedData_Get_Struct(self, struct bk_model_data, &bk_model_type, ptr);
 
   bk_texture_data *ptr_texture{bk_cTexture_get_data(texture)};
+  if(!ptr_texture->texture)
+    rb_raise(rb_eArgError, "%s", "initialize expect a loaded Texture.");
 
   ptr->model_path = StringValueCStr(file_path);
   ptr->texture = ptr_texture->texture;
 
-  ptr->loader->add(&bk_model_data::load_mesh, &bk_model_data::unload_mesh);
-  ptr->loader->add(&bk_model_data::load_uniform_buffers,
-                   &bk_model_data::unload_uniform_buffers);
+  ptr->loader->add(&bk_model_data::load_geometry,
+                   &bk_model_data::unload_geometry);
   ptr->loader->add(&bk_model_data::load_descriptor_sets,
                    &bk_model_data::unload_descriptor_sets);
 
@@ -136,107 +144,311 @@ bk_cModel_initialize(VALUE self, VALUE file_path, VALUE texture)
 }
 
 void
-bk_model_data::load_mesh()
+bk_model_data::load_geometry()
 {
-  std::ifstream input_file{this->model_path};
-  if(!input_file.is_open()) throw Loader::Error{"Failed to open file."};
+  std::string key{BKGE::AssetCache::make_key(this->model_path)};
+  auto &geometries{BKGE::engine->get_asset_cache()->geometries};
+
+  if(!key.empty())
+  {
+    this->geometry = geometries.find(key);
+    if(this->geometry) return;
+  }
+
+  this->geometry = std::make_shared<bk_sGeometry>();
+  this->geometry->loader = new Loader::Stack<bk_sGeometry>{
+    this->geometry.get()};
+  this->geometry->model_path = this->model_path;
+  this->geometry->device_bytes = 0;
+  this->geometry->loader->add(
+      &bk_sGeometry::load_mesh, &bk_sGeometry::unload_mesh);
+
+  try
+  {
+    this->geometry->loader->load();
+  }
+  catch(Loader::Error le)
+  {
+    this->geometry = nullptr;
+    throw;
+  }
+
+  if(!key.empty()) geometries.insert(key, this->geometry);
+  BKGE::engine->get_residency()->add(this->geometry);
+}
+
+void
+bk_model_data::unload_geometry()
+{
+  this->geometry = nullptr;
+}
 
-  std::vector<bk_sMesh> meshes{};
-  size_t vertexes_size;
+bk_sGeometry::~bk_sGeometry()
+{
+  this->loader->unload();
+  delete this->loader;
+}
 
-  std::shared_ptr<BKVK::QueueFamily> queue_family{
-    BKGE::engine->get_queues_families_with_graphics()[0]};
+void
+bk_sGeometry::load_mesh()
+{
+  std::ifstream input_file{this->model_path};
+  if(!input_file.is_open()) throw Loader::Error{"Failed to open file."};
 
   // Load meshes.
   {
     uint32_t meshes_count{read_uint32_from_file(input_file)};
-    meshes.resize(meshes_count);
+    this->meshes.resize(meshes_count);
 
     for(uint32_t i{0}; i < meshes_count; i++)
     {
-      meshes[i].color = read_vec3_from_file(input_file);
+      this->meshes[i].color = read_vec3_from_file(input_file);
 
-      meshes[i].vertex_base = read_uint32_from_file(input_file);
-      meshes[i].vertex_count = read_uint32_from_file(input_file);
-      meshes[i].index_base = read_uint32_from_file(input_file);
-      meshes[i].index_count = read_uint32_from_file(input_file);
+      this->meshes[i].vertex_base = read_uint32_from_file(input_file);
+      this->meshes[i].vertex_count = read_uint32_from_file(input_file);
+      this->meshes[i].lods[0].index_base = read_uint32_from_file(input_file);
+      this->meshes[i].lods[0].index_count = read_uint32_from_file(input_file);
     }
   }
 
   // Load vertexes.
+  uint32_t vertex_count{read_uint32_from_file(input_file)};
+  std::vector<glm::vec3> positions(vertex_count);
+  std::vector<BKVK::Vertex> vertexes(vertex_count);
+  glm::vec3 min_position{std::numeric_limits<float>::max()};
+  glm::vec3 max_position{std::numeric_limits<float>::lowest()};
+  // Compared without adding, the sum of two uint32_t can overflow.
+  for(const auto &mesh: this->meshes)
+    if(mesh.vertex_base > vertex_count ||
+       mesh.vertex_count > vertex_count - mesh.vertex_base)
+      throw Loader::Error{"Mesh with vertexes that do not exist."};
+  for(auto mesh: this->meshes)
   {
-    uint32_t vertex_count{read_uint32_from_file(input_file)};
-    std::vector<BKVK::Vertex> vertexes{vertex_count};
+    for(uint32_t i{mesh.vertex_base};
+        i < mesh.vertex_base + mesh.vertex_count; i++)
+    {
+      positions[i] = read_vec3_from_file(input_file);
+      BKVK::pack_normal(read_vec3_from_file(input_file), vertexes[i].normal);
+      BKVK::pack_texture_coord(
+          read_vec2_from_file(input_file), vertexes[i].texture_coord);
+
+      for(int axis{0}; axis < 3; axis++)
+      {
+        min_position[axis] = std::min(min_position[axis], positions[i][axis]);
+        max_position[axis] = std::max(max_position[axis], positions[i][axis]);
+      }
+    }
+  }
 
-    for(auto mesh: meshes)
+  // Load indexes.
+  uint32_t index_count{read_uint32_from_file(input_file)};
+  std::vector<uint32_t> indexes(index_count);
+  for(uint32_t i{0}; i < index_count; i++)
+  {
+    indexes[i] = read_uint32_from_file(input_file);
+    if(indexes[i] >= vertex_count)
+      throw Loader::Error{"Index of a vertex that does not exist."};
+  }
+  for(const auto &mesh: this->meshes)
+    if(mesh.lods[0].index_base + mesh.lods[0].index_count > index_count)
+      throw Loader::Error{"Mesh with indexes that do not exist."};
+
+  // Bounding sphere around the center of the bounding box.
+  this->bounds_center = (min_position + max_position) * 0.5f;
+  this->bounds_radius = 0.0f;
+  // Only the vertexes of meshes, the same ones as the box; the others stay at
+  // the origin.
+  for(const auto &mesh: this->meshes)
+    for(uint32_t i{mesh.vertex_base};
+        i < mesh.vertex_base + mesh.vertex_count; i++)
+      this->bounds_radius = std::max(
+          this->bounds_radius, glm::length(positions[i] - this->bounds_center));
+
+  // Coarser levels of detail for each mesh, each with about half the
+  // triangles of the level before. Their indexes go after the ones from the
+  // file and use the same vertexes, so only the index buffer grows.
+  {
+    uint32_t lod_levels{std::min<uint32_t>(
+        BKGE::engine->get_lod_screen_sizes().size() + 1, bk_max_lods)};
+    this->lod_count = 1;
+    for(auto &mesh: this->meshes)
     {
-      for(uint32_t i{mesh.vertex_base}; i < mesh.vertex_count; i++)
+      bool simplifying{true};
+      for(uint32_t lod{1}; lod < bk_max_lods; lod++)
       {
-        vertexes[i].position = read_vec3_from_file(input_file);
-        vertexes[i].normal = read_vec3_from_file(input_file);
-        vertexes[i].texture_coord = read_vec2_from_file(input_file);
-        vertexes[i].color = mesh.color;
+        bk_sMeshLod previous{mesh.lods[lod - 1]};
+        mesh.lods[lod] = previous;
+        if(!simplifying || lod >= lod_levels ||
+           previous.index_count / 3 < min_lod_triangles)
+          continue;
+
+        std::vector<uint32_t> simplified{BKGE::MeshOptimizer::simplify(
+            positions.data(), indexes.data() + previous.index_base,
+            previous.index_count, previous.index_count / 6 * 3)};
+        // A level that saves little is not worth its memory, and the next
+        // ones would not save more.
+        if(simplified.empty() ||
+           simplified.size() > previous.index_count * 3 / 4)
+        {
+          simplifying = false;
+          continue;
+        }
+
+        mesh.lods[lod].index_base = static_cast<uint32_t>(indexes.size());
+        mesh.lods[lod].index_count = static_cast<uint32_t>(simplified.size());
+        indexes.insert(indexes.end(), simplified.begin(), simplified.end());
+        this->lod_count = std::max(this->lod_count, lod + 1);
       }
     }
+    index_count = static_cast<uint32_t>(indexes.size());
 
-    void *vertexes_data{vertexes.data()};
-    vertexes_size = sizeof(vertexes[0]) * vertexes.size();
-    std::shared_ptr<BKVK::SourceBuffer> source_vertex_buffer{
-      new BKVK::SourceBuffer{
-        queue_family->get_device(), vertexes_data, vertexes_size}};
-    this->vertex_buffer = std::make_shared<BKVK::DestinationBuffer>(
-        queue_family, source_vertex_buffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    for(uint32_t lod{0}; lod < bk_max_lods; lod++)
+    {
+      this->lod_triangles[lod] = 0;
+      for(const auto &mesh: this->meshes)
+        this->lod_triangles[lod] += mesh.lods[lod].index_count / 3;
+    }
   }
 
-  // Load indexes.
+  // Files keep triangles in the order the modeling tool exported them.
+  // Reorder them for the post-transform cache, mesh by mesh so every mesh
+  // keeps its index range, and then reorder vertexes in the order they are
+  // used.
   {
-    this->index_count = read_uint32_from_file(input_file);
-    std::vector<uint32_t> indexes(this->index_count);
+    float acmr_before{BKGE::MeshOptimizer::acmr(indexes.data(), index_count)};
+
+    for(const auto &mesh: this->meshes)
+      for(uint32_t lod{0}; lod < this->lod_count; lod++)
+        if(lod == 0 ||
+           mesh.lods[lod].index_base != mesh.lods[lod - 1].index_base)
+          BKGE::MeshOptimizer::optimize_vertex_cache(
+              indexes.data() + mesh.lods[lod].index_base,
+              mesh.lods[lod].index_count);
+    std::vector<uint32_t> remap{
+      BKGE::MeshOptimizer::optimize_vertex_fetch(indexes, vertex_count)};
+
+    std::vector<glm::vec3> old_positions{std::move(positions)};
+    std::vector<BKVK::Vertex> old_vertexes{std::move(vertexes)};
+    positions.resize(vertex_count);
+    vertexes.resize(vertex_count);
+    for(uint32_t i{0}; i < vertex_count; i++)
+    {
+      positions[remap[i]] = old_positions[i];
+      vertexes[remap[i]] = old_vertexes[i];
+    }
 
-    for(uint32_t i{0}; i < this->index_count; i++)
+    if(BKGE::engine->get_core_data()->debug)
     {
-      indexes[i] = read_uint32_from_file(input_file);
+      std::ostringstream txt;
+      txt << this->model_path << ": ACMR " << acmr_before << " → " <<
+          BKGE::MeshOptimizer::acmr(indexes.data(), index_count) <<
+          ", triangles per level of detail:";
+      for(uint32_t lod{0}; lod < this->lod_count; lod++)
+        txt << " " << this->lod_triangles[lod];
+      BKGE::Log::standard(txt.str());
     }
+  }
 
-    void *indexes_data{indexes.data()};
-    size_t indexes_size{sizeof(indexes[0]) * indexes.size()};
-    std::shared_ptr<BKVK::SourceBuffer> source_index_buffer{
-      new BKVK::SourceBuffer{
-        queue_family->get_device(), indexes_data, vertexes_size}};
-    this->index_buffer = std::make_shared<BKVK::DestinationBuffer>(
-        queue_family, source_index_buffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  // Positions become a fraction of the bounds of the geometry.
+  std::vector<BKVK::QuantizedVertex> quantized_vertexes;
+  const void *vertexes_data{vertexes.data()};
+  if(BKGE::engine->get_quantize_positions() && vertex_count > 0)
+  {
+    this->position_offset = min_position;
+    this->position_scale = max_position - min_position;
+
+    quantized_vertexes.resize(vertex_count);
+    for(uint32_t i{0}; i < vertex_count; i++)
+    {
+      for(int axis{0}; axis < 3; axis++)
+        quantized_vertexes[i].position[axis] = BKVK::pack_unorm16(
+            this->position_scale[axis] == 0.0f ? 0.0f :
+            (positions[i][axis] - this->position_offset[axis]) /
+            this->position_scale[axis]);
+      quantized_vertexes[i].position[3] = 0;
+      quantized_vertexes[i].normal[0] = vertexes[i].normal[0];
+      quantized_vertexes[i].normal[1] = vertexes[i].normal[1];
+      quantized_vertexes[i].texture_coord[0] = vertexes[i].texture_coord[0];
+      quantized_vertexes[i].texture_coord[1] = vertexes[i].texture_coord[1];
+    }
+    vertexes_data = quantized_vertexes.data();
+  }
+  else
+  {
+    this->position_offset = glm::vec3{0.0f};
+    this->position_scale = glm::vec3{1.0f};
+
+    for(uint32_t i{0}; i < vertex_count; i++)
+      vertexes[i].position = positions[i];
   }
+
+  // Indexes are relative to the first vertex of the range, so any geometry
+  // that fits in 16 bits uses half the index memory.
+  std::vector<uint16_t> short_indexes;
+  const void *indexes_data{indexes.data()};
+  VkIndexType vk_index_type{VK_INDEX_TYPE_UINT32};
+  if(vertex_count <= std::numeric_limits<uint16_t>::max() + 1u)
+  {
+    short_indexes.assign(indexes.begin(), indexes.end());
+    indexes_data = short_indexes.data();
+    vk_index_type = VK_INDEX_TYPE_UINT16;
+  }
+
+  this->geometry_pool = BKGE::engine->get_geometry_pool(vk_index_type);
+  this->range = this->geometry_pool->add(
+      vertexes_data, vertex_count, indexes_data, index_count);
+
+  // Ruby can not see this memory, but it is released by its finalizers.
+  this->device_bytes =
+      vertex_count * this->geometry_pool->get_vertex_size() +
+      index_count * this->geometry_pool->get_index_size();
+  rb_gc_adjust_memory_usage(static_cast<ssize_t>(this->device_bytes));
 }
 
 void
-bk_model_data::unload_mesh()
+bk_sGeometry::unload_mesh()
 {
-  this->index_buffer = nullptr;
-  this->vertex_buffer = nullptr;
+  this->geometry_pool->remove(this->range);
+  this->range = nullptr;
+  this->geometry_pool = nullptr;
+  this->meshes.clear();
+
+  rb_gc_adjust_memory_usage(-static_cast<ssize_t>(this->device_bytes));
+  this->device_bytes = 0;
 }
 
-void
-bk_model_data::load_uniform_buffers()
+size_t
+bk_sGeometry::memsize() const
 {
-  for(std::vector<std::shared_ptr<BKVK::UniformBuffer>>::size_type i{0};
-      i < BKGE::engine->get_swapchain()->get_vk_image_views().size(); i++)
-  for(int i{0}; i < 3; i++)
-    this->ub_model_instance.push_back(std::make_shared<BKVK::UniformBuffer>(
-        BKGE::engine->get_devices()[0], sizeof(BKVK::UBOModelInstance)));
+  return sizeof(bk_sGeometry) + sizeof(Loader::Stack<bk_sGeometry>) +
+      this->model_path.capacity() +
+      this->meshes.capacity() * sizeof(bk_sMesh) + this->device_bytes;
 }
 
-void
-bk_model_data::unload_uniform_buffers()
+size_t
+bk_model_data::memsize() const
 {
-  this->ub_model_instance.clear();
+  size_t size{sizeof(bk_model_data) + sizeof(Loader::Stack<bk_model_data>) +
+              this->model_path.capacity()};
+
+  // Geometries and textures are shared, split them between their users.
+  if(this->geometry)
+    size += this->geometry->memsize() / this->geometry.use_count();
+  if(this->texture)
+    size += this->texture->memsize() / this->texture.use_count();
+
+  return size;
 }
 
 void
 bk_model_data::load_descriptor_sets()
 {
-  this->ds_model_instance = std::make_shared<BKVK::DS::ModelInstance>(
-      BKGE::engine->get_graphic_pipeline_layout()->get_dsl_model_instance(),
-      this->texture, this->ub_model_instance);
+  this->texture_generation = this->texture->generation;
+  auto dsl_model_instance{
+    BKGE::engine->get_graphic_pipeline_layout()->get_dsl_model_instance()};
+  if(dsl_model_instance->get_with_texture())
+    this->ds_model_instance = std::make_shared<BKVK::DS::ModelInstance>(
+        dsl_model_instance, this->texture);
 }
 
 void
@@ -245,31 +457,55 @@ bk_model_data::unload_descriptor_sets()
   this->ds_model_instance = nullptr;
 }
 
+void
+bk_model_data::make_resident()
+{
+  auto residency{BKGE::engine->get_residency()};
+  residency->use(this->geometry.get());
+  residency->use(this->texture.get());
+
+  // A texture loaded again has a new view. Sets that sample it directly, not
+  // through the texture table, must be written again (step 1 of the loader).
+  if(this->texture_generation != this->texture->generation)
+    this->loader->reload(1);
+}
+
 void
 bk_model_data::draw(VkCommandBuffer vk_command_buffer,
-                    uint32_t image_index,
+                    uint32_t lod,
+                    uint32_t instance_base,
                     uint32_t instance_count,
-                    VkPipeline vk_graphic_pipeline,
-                    VkDescriptorSet vk_ds_view_projection,
+                    uint32_t &draw_id,
                     VkPipelineLayout vk_pipeline_layout)
 {
-  std::array<VkDescriptorSet, 2> vk_descriptor_sets{
-    this->ds_model_instance->get_vk_descriptor_sets()[image_index],
-    vk_ds_view_projection};
-  VkBuffer vertex_buffers[]{this->vertex_buffer->get_vk_buffer()};
-  VkDeviceSize offsets[]{0};
-
-  vkCmdBindDescriptorSets(
-      vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout,
-      0, vk_descriptor_sets.size(), vk_descriptor_sets.data(), 0, nullptr);
-  vkCmdBindPipeline(
-      vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_graphic_pipeline);
-  vkCmdBindVertexBuffers(vk_command_buffer, 0, 1, vertex_buffers, offsets);
-  vkCmdBindIndexBuffer(
-      vk_command_buffer, this->index_buffer->get_vk_buffer(), 0,
-      VK_INDEX_TYPE_UINT32);
-  vkCmdDrawIndexed(
-      vk_command_buffer, this->index_count, instance_count, 0, 0, 0);
+  // Without the texture table, the texture is the only thing bound for each
+  // model.
+  if(this->ds_model_instance)
+    vkCmdBindDescriptorSets(
+        vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        vk_pipeline_layout, 0, 1,
+        this->ds_model_instance->get_vk_descriptor_sets().data(), 0, nullptr);
+
+  // The engine binds the pool page of the geometry before calling this.
+  BKVK::DrawConstants draw_constants{};
+  draw_constants.position_scale =
+      glm::vec4{this->geometry->position_scale, 0.0f};
+  draw_constants.position_offset =
+      glm::vec4{this->geometry->position_offset, 0.0f};
+  draw_constants.instance_base = instance_base;
+  draw_constants.texture_index = this->texture->texture_index;
+  for(const auto &mesh: this->geometry->meshes)
+  {
+    draw_constants.color = glm::vec4{mesh.color, 1.0f};
+    draw_constants.draw_id = draw_id++;
+    vkCmdPushConstants(
+        vk_command_buffer, vk_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+        sizeof(draw_constants), &draw_constants);
+    vkCmdDrawIndexed(
+        vk_command_buffer, mesh.lods[lod].index_count, instance_count,
+        this->geometry->range->first_index + mesh.lods[lod].index_base,
+        static_cast<int32_t>(this->geometry->range->first_vertex), 0);
+  }
 }
 
 struct bk_model_data*
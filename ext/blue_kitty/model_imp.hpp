@@ -2,14 +2,24 @@
 #ifndef BLUE_KITTY_MODEL_IMP_HPP
 #define BLUE_KITTY_MODEL_IMP_HPP 1
 
+#include <array>
 #include <vector>
 #include <memory>
 
 #include "texture_imp.hpp"
 #include "vk_descriptor_set_model_instance.hpp"
-#include "vk_destination_buffer.hpp"
+#include "vk_geometry_pool.hpp"
 #include "vk_graphic_pipeline.hpp"
-#include "vk_uniform_buffer.hpp"
+
+// Most levels of detail a geometry can have, the first one is the mesh from
+// the file.
+const uint32_t bk_max_lods{4};
+
+typedef struct bk_sMeshLod_t
+{
+  uint32_t index_base;
+  uint32_t index_count;
+} bk_sMeshLod;
 
 typedef struct bk_sMesh_t
 {
@@ -17,38 +27,85 @@ typedef struct bk_sMesh_t
 
   uint32_t vertex_base;
   uint32_t vertex_count;
-  uint32_t index_base;
-  uint32_t index_count;
+  // Every level uses the same vertexes. Levels the mesh could not simplify to
+  // repeat the last one it has.
+  std::array<bk_sMeshLod, bk_max_lods> lods;
 } bk_sMesh;
 
+// Keep geometry into a separated object so it can be shared by every model
+// loaded from the same file.
+struct bk_sGeometry
+{
+  Loader::Stack<bk_sGeometry> *loader;
+  std::string model_path;
+
+  // Residency control, an evicted geometry is loaded again from its file.
+  bool resident;
+  uint64_t last_used_frame;
+
+  // Each mesh is drawn separately with its own color.
+  std::vector<bk_sMesh> meshes;
+  // Turn quantized positions back into model space.
+  glm::vec3 position_scale, position_offset;
+  // Sphere around every vertex in model space, used to pick a level of
+  // detail. Kept while the geometry is evicted.
+  glm::vec3 bounds_center;
+  float bounds_radius;
+  // Levels of detail of the geometry and triangles drawn by each of them.
+  uint32_t lod_count;
+  std::array<uint32_t, bk_max_lods> lod_triangles;
+
+  // Vertexes and indexes live in the shared pool of the engine. The pool is
+  // kept here so the range can be released after the engine is gone.
+  std::shared_ptr<BKVK::GeometryPool> geometry_pool;
+  std::shared_ptr<BKVK::GeometryPool::Range> range;
+  // Device memory held by the range, reported to Ruby's garbage collector.
+  size_t device_bytes;
+
+  ~bk_sGeometry();
+
+  // Host and device bytes used by this geometry.
+  size_t memsize() const;
+
+  void load_mesh();
+  void unload_mesh();
+};
+
 struct bk_model_data
 {
   Loader::Stack<bk_model_data> *loader;
 
   std::string model_path;
   std::shared_ptr<bk_sTexture> texture;
+  std::shared_ptr<bk_sGeometry> geometry;
 
-  uint32_t index_count;
-  std::shared_ptr<BKVK::DestinationBuffer> index_buffer;
-  std::shared_ptr<BKVK::DestinationBuffer> vertex_buffer;
-
-  std::vector<std::shared_ptr<BKVK::UniformBuffer>> ub_model_instance;
+  // Null when the texture is in the texture table.
   std::shared_ptr<BKVK::DS::ModelInstance> ds_model_instance;
+  // Generation of the texture written into the descriptor sets.
+  uint32_t texture_generation;
 
-  void load_mesh();
-  void unload_mesh();
+  // Host and device bytes used by this model, with its share of the geometry
+  // and texture.
+  size_t memsize() const;
 
-  void load_uniform_buffers();
-  void unload_uniform_buffers();
+  void load_geometry();
+  void unload_geometry();
 
   void load_descriptor_sets();
   void unload_descriptor_sets();
 
+  // Load again the geometry and texture if they were evicted. Must be called
+  // before recording a draw for this model.
+  void make_resident();
+
+  // The pipeline and the descriptor sets shared by every model must be
+  // bound already. Instances are read from the instance buffer starting at
+  // instance_base. Each mesh gets the next draw id.
   void draw(VkCommandBuffer vk_command_buffer,
-            uint32_t image_index,
+            uint32_t lod,
+            uint32_t instance_base,
             uint32_t instance_count,
-            VkPipeline vk_graphic_pipeline,
-            VkDescriptorSet vk_ds_view_projection,
+            uint32_t &draw_id,
             VkPipelineLayout vk_pipeline_layout);
 };
 
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: MIT
+#include "pixel_swizzle.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && SDL_BYTEORDER == SDL_LIL_ENDIAN
+#include <arm_neon.h>
+#define BLUE_KITTY_SWIZZLE_NEON 1
+#endif
+
+namespace BKGE
+{
+bool PixelSwizzle::make(const SDL_PixelFormat *format, PixelSwizzle *swizzle)
+{
+  if(format->palette != nullptr) return false;
+  if(format->BytesPerPixel != 3 && format->BytesPerPixel != 4) return false;
+
+  const uint32_t masks[4]{
+    format->Rmask, format->Gmask, format->Bmask, format->Amask};
+  const uint8_t shifts[4]{
+    format->Rshift, format->Gshift, format->Bshift, format->Ashift};
+
+  swizzle->bytes_per_pixel = format->BytesPerPixel;
+  swizzle->has_alpha = format->Amask != 0;
+
+  for(uint32_t c{0}; c < 4; c++)
+  {
+    if(c == 3 && !swizzle->has_alpha)
+    {
+      swizzle->shifts[c] = 0;
+      continue;
+    }
+
+    if(shifts[c] % 8 != 0 || masks[c] != 0xffu << shifts[c]) return false;
+    swizzle->shifts[c] = shifts[c];
+  }
+
+  return true;
+}
+
+void PixelSwizzle::convert_row(
+    const uint8_t *src, uint8_t *dst, uint32_t width) const
+{
+  uint32_t x{0};
+
+  // Four pixels at a time for 32 bits formats.
+  if(this->bytes_per_pixel == 4)
+  {
+#if defined(__SSE2__)
+    const __m128i byte_mask{_mm_set1_epi32(0xff)};
+    const __m128i opaque{_mm_set1_epi32(static_cast<int>(0xff000000u))};
+    const __m128i shift_r{_mm_cvtsi32_si128(this->shifts[0])};
+    const __m128i shift_g{_mm_cvtsi32_si128(this->shifts[1])};
+    const __m128i shift_b{_mm_cvtsi32_si128(this->shifts[2])};
+    const __m128i shift_a{_mm_cvtsi32_si128(this->shifts[3])};
+
+    for(; x + 4 <= width; x += 4)
+    {
+      __m128i pixels{
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * x))};
+
+      __m128i r{_mm_and_si128(_mm_srl_epi32(pixels, shift_r), byte_mask)};
+      __m128i g{_mm_slli_epi32(
+          _mm_and_si128(_mm_srl_epi32(pixels, shift_g), byte_mask), 8)};
+      __m128i b{_mm_slli_epi32(
+          _mm_and_si128(_mm_srl_epi32(pixels, shift_b), byte_mask), 16)};
+      __m128i a{this->has_alpha ?
+        _mm_slli_epi32(_mm_srl_epi32(pixels, shift_a), 24) : opaque};
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x),
+                       _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a)));
+    }
+#elif defined(BLUE_KITTY_SWIZZLE_NEON)
+    const uint32x4_t byte_mask{vdupq_n_u32(0xff)};
+    const uint32x4_t opaque{vdupq_n_u32(0xff000000u)};
+    // Shifting left by a negative amount shifts right.
+    const int32x4_t shift_r{
+      vdupq_n_s32(-static_cast<int32_t>(this->shifts[0]))};
+    const int32x4_t shift_g{
+      vdupq_n_s32(-static_cast<int32_t>(this->shifts[1]))};
+    const int32x4_t shift_b{
+      vdupq_n_s32(-static_cast<int32_t>(this->shifts[2]))};
+    const int32x4_t shift_a{
+      vdupq_n_s32(-static_cast<int32_t>(this->shifts[3]))};
+
+    for(; x + 4 <= width; x += 4)
+    {
+      uint32x4_t pixels{
+        vld1q_u32(reinterpret_cast<const uint32_t*>(src + 4 * x))};
+
+      uint32x4_t r{vandq_u32(vshlq_u32(pixels, shift_r), byte_mask)};
+      uint32x4_t g{vshlq_n_u32(
+          vandq_u32(vshlq_u32(pixels, shift_g), byte_mask), 8)};
+      uint32x4_t b{vshlq_n_u32(
+          vandq_u32(vshlq_u32(pixels, shift_b), byte_mask), 16)};
+      uint32x4_t a{this->has_alpha ?
+        vshlq_n_u32(vshlq_u32(pixels, shift_a), 24) : opaque};
+
+      vst1q_u32(reinterpret_cast<uint32_t*>(dst + 4 * x),
+                vorrq_u32(vorrq_u32(r, g), vorrq_u32(b, a)));
+    }
+#endif
+  }
+
+  // Remaining pixels and 24 bits formats. SDL masks apply to the pixel read
+  // as a native integer, 24 bits pixels are assembled in the same order.
+  for(; x < width; x++)
+  {
+    const uint8_t *src_pixel{src + x * this->bytes_per_pixel};
+    uint32_t pixel;
+
+    if(this->bytes_per_pixel == 4)
+      memcpy(&pixel, src_pixel, sizeof(pixel));
+    else if(SDL_BYTEORDER == SDL_LIL_ENDIAN)
+      pixel = src_pixel[0] | src_pixel[1] << 8 | src_pixel[2] << 16;
+    else
+      pixel = src_pixel[0] << 16 | src_pixel[1] << 8 | src_pixel[2];
+
+    uint8_t *dst_pixel{dst + 4 * x};
+    dst_pixel[0] = static_cast<uint8_t>(pixel >> this->shifts[0]);
+    dst_pixel[1] = static_cast<uint8_t>(pixel >> this->shifts[1]);
+    dst_pixel[2] = static_cast<uint8_t>(pixel >> this->shifts[2]);
+    dst_pixel[3] = this->has_alpha ?
+        static_cast<uint8_t>(pixel >> this->shifts[3]) : 0xff;
+  }
+}
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_PIXEL_SWIZZLE_HPP
+#define BLUE_KITTY_PIXEL_SWIZZLE_HPP 1
+
+#include <cstdint>
+
+#include <SDL2/SDL.h>
+
+namespace BKGE
+{
+/*
+  Convert rows of a decoded image straight into R8G8B8A8 bytes, so the pixels
+  can be written directly into staging memory without an intermediate
+  surface.
+*/
+struct PixelSwizzle
+{
+  uint32_t bytes_per_pixel;
+  // Position of the red, green, blue and alpha bytes inside a pixel.
+  uint32_t shifts[4];
+  bool has_alpha;
+
+  // Return false if the format has no kernel, like palettes or channels that
+  // are not 8 bits wide. Those must be converted by SDL first.
+  static bool make(const SDL_PixelFormat *format, PixelSwizzle *swizzle);
+
+  void convert_row(const uint8_t *src, uint8_t *dst, uint32_t width) const;
+};
+}
+
+#endif /* BLUE_KITTY_PIXEL_SWIZZLE_HPP */
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: MIT
+#include "residency.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include "model_imp.hpp"
+#include "texture_imp.hpp"
+
+namespace
+{
+// Drop entries of assets that were already destroyed.
+template<typename T>
+void prune(std::vector<std::weak_ptr<T>> *assets)
+{
+  assets->erase(
+      std::remove_if(assets->begin(), assets->end(),
+                     [](const std::weak_ptr<T> &a){ return a.expired(); }),
+      assets->end());
+}
+
+struct Candidate
+{
+  uint64_t last_used_frame;
+  // Device memory the asset gives back when evicted.
+  VkDeviceSize device_bytes;
+  std::function<void()> evict;
+};
+
+template<typename T>
+void add_candidates(std::vector<std::weak_ptr<T>> *assets,
+                    uint64_t last_idle_frame,
+                    std::vector<Candidate> *candidates)
+{
+  prune(assets);
+
+  for(auto &weak_asset: *assets)
+  {
+    std::shared_ptr<T> asset{weak_asset.lock()};
+    if(!asset->resident || asset->last_used_frame > last_idle_frame) continue;
+
+    candidates->push_back({
+        asset->last_used_frame, asset->device_bytes, [asset](){
+      asset->loader->unload();
+      asset->resident = false;
+    }});
+  }
+}
+}
+
+namespace BKGE
+{
+Residency::Residency(
+    const std::shared_ptr<BKVK::Device> &device, VkDeviceSize budget,
+    const std::vector<std::shared_ptr<BKVK::GeometryPool>> &geometry_pools):
+    device{device},
+    budget{budget},
+    geometry_pools{geometry_pools},
+    frame{0},
+    evictions{0},
+    restreams{0}
+{
+}
+
+void Residency::add(const std::shared_ptr<bk_sGeometry> &geometry)
+{
+  geometry->resident = true;
+  geometry->last_used_frame = this->frame;
+  this->geometries.push_back(geometry);
+}
+
+void Residency::add(const std::shared_ptr<bk_sTexture> &texture)
+{
+  texture->resident = true;
+  texture->last_used_frame = this->frame;
+  this->textures.push_back(texture);
+}
+
+void Residency::begin_frame()
+{
+  this->frame++;
+}
+
+void Residency::use(bk_sGeometry *geometry)
+{
+  geometry->last_used_frame = this->frame;
+  if(geometry->resident) return;
+
+  geometry->loader->load();
+  geometry->resident = true;
+  this->restreams++;
+}
+
+void Residency::use(bk_sTexture *texture)
+{
+  texture->last_used_frame = this->frame;
+  if(texture->resident) return;
+
+  texture->loader->load();
+  texture->resident = true;
+  this->restreams++;
+}
+
+void Residency::trim(uint64_t idle_frames)
+{
+  if(this->frame <= idle_frames) return;
+  VkDeviceSize excess{this->over_budget_bytes()};
+  if(excess == 0) return;
+
+  std::vector<Candidate> candidates;
+  add_candidates(&this->geometries, this->frame - idle_frames, &candidates);
+  add_candidates(&this->textures, this->frame - idle_frames, &candidates);
+  if(candidates.empty()) return;
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b)
+            { return a.last_used_frame < b.last_used_frame; });
+
+  // Eviction is rare, waiting is simpler than tracking which frame still
+  // reads each asset.
+  vkDeviceWaitIdle(this->device->get_vk_device());
+
+  // Memory freed inside blocks of the allocator is not given back to the
+  // driver, so progress is counted from what each asset releases instead of
+  // measured again.
+  VkDeviceSize freed{0};
+  for(auto &candidate: candidates)
+  {
+    candidate.evict();
+    this->evictions++;
+    freed += candidate.device_bytes;
+    if(freed >= excess) break;
+  }
+}
+
+VkDeviceSize Residency::over_budget_bytes() const
+{
+  const auto &memory_properties{this->device->get_memory_properties()};
+  const auto &heap_stats{
+    this->device->get_memory_allocator()->get_heap_stats()};
+
+  // Evicted geometries leave free ranges in pool pages, which stay allocated
+  // but hold the next geometries loaded. They are not over budget.
+  VkDeviceSize pool_free{0};
+  for(const auto &geometry_pool: this->geometry_pools)
+    pool_free += geometry_pool->get_free_bytes();
+
+  if(this->budget > 0)
+  {
+    VkDeviceSize used{0};
+    for(uint32_t i{0}; i < memory_properties.memoryHeapCount; i++)
+      if(memory_properties.memoryHeaps[i].flags &
+         VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        used += heap_stats[i].used_bytes;
+    used = used > pool_free ? used - pool_free : 0;
+    return used > this->budget ? used - this->budget : 0;
+  }
+
+  // The driver counts whole blocks of the allocator. Their unused parts are
+  // taken before the driver is asked for more, so they are not over budget.
+  auto budgets{this->device->get_memory_budgets()};
+  VkDeviceSize excess{0};
+  for(uint32_t i{0}; i < memory_properties.memoryHeapCount; i++)
+  {
+    if(!(memory_properties.memoryHeaps[i].flags &
+         VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+      continue;
+
+    VkDeviceSize unused{
+      heap_stats[i].reserved_bytes - heap_stats[i].used_bytes};
+    VkDeviceSize usage{
+      budgets[i].usage > unused ? budgets[i].usage - unused : 0};
+    if(usage > budgets[i].budget) excess += usage - budgets[i].budget;
+  }
+
+  return excess > pool_free ? excess - pool_free : 0;
+}
+
+}
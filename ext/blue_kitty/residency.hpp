@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_RESIDENCY_HPP
+#define BLUE_KITTY_RESIDENCY_HPP 1
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "vk_device.hpp"
+#include "vk_geometry_pool.hpp"
+
+struct bk_sGeometry;
+struct bk_sTexture;
+
+namespace BKGE
+{
+/*
+  Track the last frame each texture and geometry was drawn. When device
+  memory goes over budget, the least recently drawn ones are unloaded from
+  the GPU. They keep the path of their file, and they are loaded again the
+  next time something draws them.
+*/
+class Residency
+{
+  Residency(const Residency &t) = delete;
+  Residency& operator=(const Residency &t) = delete;
+  Residency(const Residency &&t) = delete;
+  Residency& operator=(const Residency &&t) = delete;
+
+ public:
+  // A "budget" of 0 uses the budget reported by the device.
+  explicit Residency(
+      const std::shared_ptr<BKVK::Device> &device, VkDeviceSize budget,
+      const std::vector<std::shared_ptr<BKVK::GeometryPool>> &geometry_pools);
+
+  inline VkDeviceSize get_budget() const { return this->budget; };
+  inline uint64_t get_evictions() const { return this->evictions; };
+  inline uint64_t get_restreams() const { return this->restreams; };
+
+  void add(const std::shared_ptr<bk_sGeometry> &geometry);
+  void add(const std::shared_ptr<bk_sTexture> &texture);
+
+  void begin_frame();
+  // Mark the asset as drawn by the current frame, loading it again if it was
+  // evicted. Throw Loader::Error if the file can not be loaded anymore.
+  void use(bk_sGeometry *geometry);
+  void use(bk_sTexture *texture);
+  // Evict assets not drawn by the last "idle_frames" frames until memory is
+  // within budget.
+  void trim(uint64_t idle_frames);
+
+ private:
+  std::shared_ptr<BKVK::Device> device;
+  VkDeviceSize budget;
+  std::vector<std::shared_ptr<BKVK::GeometryPool>> geometry_pools;
+
+  std::vector<std::weak_ptr<bk_sGeometry>> geometries;
+  std::vector<std::weak_ptr<bk_sTexture>> textures;
+
+  uint64_t frame;
+  uint64_t evictions, restreams;
+
+  // Device memory used beyond the budget, 0 when within it.
+  VkDeviceSize over_budget_bytes() const;
+};
+}
+
+#endif /* BLUE_KITTY_RESIDENCY_HPP */
@@ -0,0 +1,51 @@
+# SPDX-License-Identifier: MIT
+require "tmpdir"
+
+# Compile the shaders and embed the SPIR-V into the extension as arrays, so
+# the engine does not read shader files when it starts. The header is not in
+# git; "rake glsl", "rake compile" and the Makefile from extconf.rb write it.
+module ShaderSPIRV
+  GLSL_DIR = File.expand_path("../../data/blue_kitty/GLSL", __dir__)
+  HEADER = File.expand_path("shader_spirv.hpp", __dir__)
+
+  # Name of the array => GLSL source.
+  SHADERS = {
+    "model_vert" => "shader.vert",
+    "model_frag" => "shader.frag",
+    "model_frag_bindless" => "shader_bindless.frag",
+    "depth_pyramid_comp" => "depth_pyramid.comp"
+  }
+
+  def self.sources
+    SHADERS.values.map {|source| File.join(GLSL_DIR, source)}
+  end
+
+  def self.generate
+    arrays = Dir.mktmpdir do |dir|
+      SHADERS.map do |name, source|
+        spv = File.join(dir, "#{name}.spv")
+        system("glslangValidator", "-V", File.join(GLSL_DIR, source),
+               "-o", spv) or raise "Failed to compile #{source}."
+
+        words = File.binread(spv).unpack("V*").map {|w| format("0x%08x", w)}
+        lines = words.each_slice(6).map {|slice| "  " + slice.join(", ")}
+        "constexpr uint32_t #{name}[]{\n#{lines.join(",\n")}\n};\n"
+      end
+    end
+
+    File.write(HEADER, <<~HEADER)
+      // SPDX-License-Identifier: MIT
+      // Generated by "rake glsl" from data/blue_kitty/GLSL, do not edit.
+      #ifndef BLUE_KITTY_SHADER_SPIRV_HPP
+      #define BLUE_KITTY_SHADER_SPIRV_HPP 1
+
+      #include <cstdint>
+
+      namespace BKVK::SPIRV
+      {
+      #{arrays.join("\n")}}
+
+      #endif /* BLUE_KITTY_SHADER_SPIRV_HPP */
+    HEADER
+  end
+end
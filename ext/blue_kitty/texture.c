@@ -1,6 +1,16 @@
 // SPDX-License-Identifier: MIT
 #include "texture.h"
 
+/*
+ * Document-method: BlueKitty::Texture.load_all
+ *
+ * Load several textures at once. Images are decoded in parallel by worker
+ * threads, so this is faster than calling BlueKitty::Texture.new for each
+ * file. The same file listed more than once gives one shared texture.
+ *
+ * @param file_paths [Array<String>]
+ * @return [Array<BlueKitty::Texture>] in the same order as +file_paths+.
+ */
 void
 Init_blue_kitty_texture(void)
 {
@@ -10,4 +20,5 @@ Init_blue_kitty_texture(void)
   // If I call 'rb_define_method' from C++ it won't compile. So I call in a
   // different file.
   rb_define_method(bk_cTexture, "initialize", bk_cTexture_initialize, 1);
+  rb_define_singleton_method(bk_cTexture, "load_all", bk_cTexture_load_all, 1);
 }
@@ -19,6 +19,9 @@ bk_alloc_texture(VALUE klass);
 VALUE
 bk_cTexture_initialize(VALUE self, VALUE file_path);
 
+VALUE
+bk_cTexture_load_all(VALUE klass, VALUE file_paths);
+
 void
 Init_blue_kitty_texture(void);
 
@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: MIT
+#include "texture_file.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "bcn_decoder.hpp"
+#include "loader.hpp"
+
+namespace
+{
+const uint8_t ktx2_identifier[12]{
+  0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+const size_t ktx2_header_size{80};
+const size_t ktx2_level_index_size{24};
+
+const size_t dds_header_size{128};
+const size_t dds_dx10_header_size{20};
+
+constexpr uint32_t four_cc(const char (&code)[5])
+{
+  return static_cast<uint32_t>(code[0]) |
+      static_cast<uint32_t>(code[1]) << 8 |
+      static_cast<uint32_t>(code[2]) << 16 |
+      static_cast<uint32_t>(code[3]) << 24;
+}
+
+VkFormat dxgi_to_vk_format(uint32_t dxgi_format)
+{
+  switch(dxgi_format)
+  {
+    case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+    case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+    case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+    case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+    case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+    default: return VK_FORMAT_UNDEFINED;
+  }
+}
+
+VkFormat four_cc_to_vk_format(uint32_t code)
+{
+  if(code == four_cc("DXT1")) return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  if(code == four_cc("DXT5")) return VK_FORMAT_BC3_UNORM_BLOCK;
+  if(code == four_cc("ATI2") || code == four_cc("BC5U"))
+    return VK_FORMAT_BC5_UNORM_BLOCK;
+  if(code == four_cc("BC5S")) return VK_FORMAT_BC5_SNORM_BLOCK;
+  return VK_FORMAT_UNDEFINED;
+}
+
+}
+
+namespace BKGE
+{
+TextureFile::TextureFile(const std::string &file_path)
+{
+  std::ifstream input{file_path, std::ios::binary};
+  if(!input) throw Loader::Error{"Failed to open texture file."};
+
+  this->content.assign(std::istreambuf_iterator<char>{input},
+                       std::istreambuf_iterator<char>{});
+
+  if(this->content.size() >= sizeof(ktx2_identifier) &&
+     memcmp(this->content.data(), ktx2_identifier,
+            sizeof(ktx2_identifier)) == 0)
+    this->parse_ktx2();
+  else if(this->content.size() >= 4 &&
+          this->read32(0) == four_cc("DDS "))
+    this->parse_dds();
+  else
+    throw Loader::Error{"Texture file is neither KTX2 nor DDS."};
+}
+
+bool TextureFile::is_texture_file(const std::string &file_path)
+{
+  std::string extension{std::filesystem::path{file_path}.extension()};
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c){ return std::tolower(c); });
+
+  return extension == ".ktx2" || extension == ".dds";
+}
+
+void TextureFile::parse_ktx2()
+{
+  if(this->content.size() < ktx2_header_size)
+    throw Loader::Error{"KTX2 header is truncated."};
+
+  this->vk_format = static_cast<VkFormat>(this->read32(12));
+  this->width = this->read32(20);
+  this->height = this->read32(24);
+  uint32_t depth{this->read32(28)};
+  uint32_t layers{this->read32(32)};
+  uint32_t faces{this->read32(36)};
+  // Zero means the file has only the base level.
+  uint32_t level_count{std::max(this->read32(40), 1u)};
+  uint32_t supercompression{this->read32(44)};
+
+  if(depth > 1 || layers > 1 || faces != 1 || this->height == 0)
+    throw Loader::Error{"Only 2D KTX2 textures are supported."};
+  if(supercompression != 0)
+    throw Loader::Error{"Supercompressed KTX2 textures are not supported."};
+  if(this->content.size() <
+     ktx2_header_size + level_count * ktx2_level_index_size)
+    throw Loader::Error{"KTX2 level index is truncated."};
+
+  for(uint32_t i{0}; i < level_count; i++)
+  {
+    size_t index_offset{ktx2_header_size + i * ktx2_level_index_size};
+    this->add_level(this->read64(index_offset),
+                    this->read64(index_offset + 8));
+  }
+}
+
+void TextureFile::parse_dds()
+{
+  if(this->content.size() < dds_header_size)
+    throw Loader::Error{"DDS header is truncated."};
+
+  this->height = this->read32(12);
+  this->width = this->read32(16);
+  uint32_t level_count{std::max(this->read32(28), 1u)};
+  uint32_t code{this->read32(84)};
+  size_t offset{dds_header_size};
+
+  if(code == four_cc("DX10"))
+  {
+    if(this->content.size() < dds_header_size + dds_dx10_header_size)
+      throw Loader::Error{"DDS DX10 header is truncated."};
+
+    this->vk_format = dxgi_to_vk_format(this->read32(dds_header_size));
+    offset += dds_dx10_header_size;
+  }
+  else
+    this->vk_format = four_cc_to_vk_format(code);
+
+  if(BCn::block_size(this->vk_format) == 0)
+    throw Loader::Error{"DDS texture format is not supported."};
+
+  // DDS levels are stored one after another from the biggest.
+  for(uint32_t i{0}; i < level_count; i++)
+  {
+    uint32_t level_width{std::max(this->width >> i, 1u)};
+    uint32_t level_height{std::max(this->height >> i, 1u)};
+    size_t size{static_cast<size_t>((level_width + 3) / 4) *
+                ((level_height + 3) / 4) * BCn::block_size(this->vk_format)};
+
+    this->add_level(offset, size);
+    offset += size;
+  }
+}
+
+void TextureFile::add_level(size_t offset, size_t size)
+{
+  uint32_t level{static_cast<uint32_t>(this->levels.size())};
+  uint32_t block_size{BCn::block_size(this->vk_format)};
+
+  if(block_size == 0)
+    throw Loader::Error{"Texture file format is not supported."};
+  if(this->width == 0 || this->height == 0 || level >= 32 ||
+     ((this->width >> level) == 0 && (this->height >> level) == 0))
+    throw Loader::Error{"Texture file has invalid dimensions."};
+
+  Level l{};
+  l.offset = offset;
+  l.width = std::max(this->width >> level, 1u);
+  l.height = std::max(this->height >> level, 1u);
+  l.size = static_cast<size_t>((l.width + 3) / 4) * ((l.height + 3) / 4) *
+      block_size;
+
+  if(size != l.size)
+    throw Loader::Error{"Texture file level has an unexpected size."};
+  if(offset > this->content.size() || this->content.size() - offset < size)
+    throw Loader::Error{"Texture file level is truncated."};
+
+  this->levels.push_back(l);
+}
+
+uint32_t TextureFile::read32(size_t offset) const
+{
+  uint32_t value;
+  memcpy(&value, this->content.data() + offset, sizeof(value));
+  return value;
+}
+
+uint64_t TextureFile::read64(size_t offset) const
+{
+  uint64_t value;
+  memcpy(&value, this->content.data() + offset, sizeof(value));
+  return value;
+}
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_TEXTURE_FILE_HPP
+#define BLUE_KITTY_TEXTURE_FILE_HPP 1
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace BKGE
+{
+/*
+  Texture already stored in a GPU format, with its mip levels, read from a
+  KTX2 or DDS file. Only 2D textures compressed with BC1, BC3, BC5 or BC7 are
+  supported.
+*/
+class TextureFile
+{
+  TextureFile(const TextureFile &t) = delete;
+  TextureFile& operator=(const TextureFile &t) = delete;
+  TextureFile(const TextureFile &&t) = delete;
+  TextureFile& operator=(const TextureFile &&t) = delete;
+
+ public:
+  struct Level
+  {
+    size_t offset;
+    size_t size;
+    uint32_t width, height;
+  };
+
+  // Throw Loader::Error if the file can not be read or is not supported.
+  explicit TextureFile(const std::string &file_path);
+
+  // Tell by the file extension if a texture must be loaded by this class.
+  static bool is_texture_file(const std::string &file_path);
+
+  inline VkFormat get_vk_format() const { return this->vk_format; };
+  inline uint32_t get_width() const { return this->width; };
+  inline uint32_t get_height() const { return this->height; };
+  inline const std::vector<Level> &get_levels() const
+  { return this->levels; };
+  inline const uint8_t *get_level_data(uint32_t level) const
+  { return this->content.data() + this->levels[level].offset; };
+
+ private:
+  std::vector<uint8_t> content;
+  VkFormat vk_format;
+  uint32_t width, height;
+  std::vector<Level> levels;
+
+  void parse_ktx2();
+  void parse_dds();
+
+  // Append a level and check that it is inside the file.
+  void add_level(size_t offset, size_t size);
+
+  uint32_t read32(size_t offset) const;
+  uint64_t read64(size_t offset) const;
+};
+}
+
+#endif /* BLUE_KITTY_TEXTURE_FILE_HPP */
@@ -2,14 +2,25 @@
 #include "texture.h"
 #include "texture_imp.hpp"
 
+#include "bcn_decoder.hpp"
 #include "engine_imp.hpp"
 #include "error.h"
+#include "pixel_swizzle.hpp"
+#include "texture_file.hpp"
 #include "vk_command_pool.hpp"
 #include "vk_image.hpp"
 #include "vk_queue_family.hpp"
-#include "vk_source_buffer.hpp"
+#include "vk_staging_ring.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace
 {
@@ -17,7 +28,8 @@ void move_image_state(
     VkCommandBuffer vk_command_buffer, VkImage vk_image, VkFormat format,
     VkAccessFlags src_access_mask, VkAccessFlags dst_access_mask,
     VkImageLayout old_layout, VkImageLayout new_layout,
-    VkPipelineStageFlags source_stage, VkPipelineStageFlags destination_stage)
+    VkPipelineStageFlags source_stage, VkPipelineStageFlags destination_stage,
+    uint32_t base_mip_level, uint32_t level_count)
 {
   VkImageMemoryBarrier barrier{};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -30,8 +42,8 @@ void move_image_state(
   barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
   barrier.image = vk_image;
   barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseMipLevel = base_mip_level;
+  barrier.subresourceRange.levelCount = level_count;
   barrier.subresourceRange.baseArrayLayer = 0;
   barrier.subresourceRange.layerCount = 1;
 
@@ -40,6 +52,151 @@ void move_image_state(
       0, nullptr, 1, &barrier);
 }
 
+// Upload one mip level through the staging ring. A level is a sequence of
+// rows of "row_size" bytes, each row covers "block_height" lines of pixels (4
+// for block-compressed formats). "write_row" receives the staging memory and
+// the number of a row and must fill it, so pixels can be converted straight
+// into the ring. Levels bigger than one ring chunk are uploaded some rows at a
+// time. "before" is recorded with the first chunk and "after" with the last
+// one.
+template<typename W, typename B, typename A>
+void upload_level(
+    BKVK::StagingRing *staging_ring, VkImage vk_image, uint32_t mip_level,
+    size_t row_size, uint32_t block_height, uint32_t width, uint32_t height,
+    W write_row, B before, A after)
+{
+  uint32_t rows_quantity{(height + block_height - 1) / block_height};
+  uint32_t rows_per_chunk{static_cast<uint32_t>(
+      staging_ring->get_max_chunk_size() / row_size)};
+
+  for(uint32_t first_row{0}; first_row < rows_quantity;
+      first_row += rows_per_chunk)
+  {
+    uint32_t rows{std::min(rows_per_chunk, rows_quantity - first_row)};
+    uint32_t first_line{first_row * block_height};
+
+    staging_ring->upload(
+        row_size * rows, 16,
+        [&](uint8_t *dst_data){
+          for(uint32_t row{0}; row < rows; row++)
+            write_row(dst_data + row * row_size, first_row + row);
+        },
+        [&](VkCommandBuffer vk_command_buffer, VkBuffer vk_src_buffer,
+            VkDeviceSize src_offset){
+          if(first_row == 0) before(vk_command_buffer);
+
+          VkBufferImageCopy image_copy{};
+          image_copy.bufferOffset = src_offset;
+          image_copy.bufferRowLength = 0;
+          image_copy.bufferImageHeight = 0;
+          image_copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+          image_copy.imageSubresource.mipLevel = mip_level;
+          image_copy.imageSubresource.baseArrayLayer = 0;
+          image_copy.imageSubresource.layerCount = 1;
+          image_copy.imageOffset = {0, static_cast<int32_t>(first_line), 0};
+          image_copy.imageExtent = {
+            width, std::min(rows * block_height, height - first_line), 1};
+
+          vkCmdCopyBufferToImage(
+              vk_command_buffer, vk_src_buffer, vk_image,
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &image_copy);
+
+          if(first_row + rows == rows_quantity) after(vk_command_buffer);
+        });
+  }
+}
+
+// Fill every mip level from the level above it. Expect all levels to be in
+// VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL and leave them in
+// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+void blit_mipmaps(
+    VkCommandBuffer vk_command_buffer, VkImage vk_image, uint32_t width,
+    uint32_t height, uint32_t mip_levels)
+{
+  int32_t mip_width{static_cast<int32_t>(width)};
+  int32_t mip_height{static_cast<int32_t>(height)};
+
+  for(uint32_t i{1}; i < mip_levels; i++)
+  {
+    int32_t next_width{mip_width > 1 ? mip_width / 2 : 1};
+    int32_t next_height{mip_height > 1 ? mip_height / 2 : 1};
+
+    move_image_state(
+        vk_command_buffer, vk_image, VK_FORMAT_R8G8B8A8_UNORM,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        i - 1, 1);
+
+    VkImageBlit blit{};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.mipLevel = i - 1;
+    blit.srcSubresource.baseArrayLayer = 0;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[0] = {0, 0, 0};
+    blit.srcOffsets[1] = {mip_width, mip_height, 1};
+    blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.dstSubresource.mipLevel = i;
+    blit.dstSubresource.baseArrayLayer = 0;
+    blit.dstSubresource.layerCount = 1;
+    blit.dstOffsets[0] = {0, 0, 0};
+    blit.dstOffsets[1] = {next_width, next_height, 1};
+
+    vkCmdBlitImage(
+        vk_command_buffer, vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+        VK_FILTER_LINEAR);
+
+    move_image_state(
+        vk_command_buffer, vk_image, VK_FORMAT_R8G8B8A8_UNORM,
+        VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        i - 1, 1);
+
+    mip_width = next_width;
+    mip_height = next_height;
+  }
+
+  move_image_state(
+      vk_command_buffer, vk_image, VK_FORMAT_R8G8B8A8_UNORM,
+      VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      mip_levels - 1, 1);
+}
+
+// Build the next mip level on the CPU, each pixel is the average of a 2x2
+// block of the level above. Used when the GPU can not blit the format.
+std::vector<uint8_t> box_filter(
+    const uint8_t *src, size_t src_pitch, uint32_t src_width,
+    uint32_t src_height, uint32_t dst_width, uint32_t dst_height)
+{
+  std::vector<uint8_t> dst(4 * dst_width * dst_height);
+
+  for(uint32_t y{0}; y < dst_height; y++)
+  {
+    const uint8_t *row0{src + std::min(2 * y, src_height - 1) * src_pitch};
+    const uint8_t *row1{src + std::min(2 * y + 1, src_height - 1) * src_pitch};
+
+    for(uint32_t x{0}; x < dst_width; x++)
+    {
+      uint32_t x0{4 * std::min(2 * x, src_width - 1)};
+      uint32_t x1{4 * std::min(2 * x + 1, src_width - 1)};
+
+      for(uint32_t c{0}; c < 4; c++)
+        dst[4 * (y * dst_width + x) + c] = static_cast<uint8_t>(
+            (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) /
+            4);
+    }
+  }
+
+  return dst;
+}
+
 }
 
 VALUE bk_cTexture;
@@ -60,8 +217,14 @@ bk_free_texture(void* obj)
 size_t
 bk_memsize_texture(const void* obj)
 {
-  // TODO
-  return 0;
+  const bk_texture_data *ptr{static_cast<const bk_texture_data*>(obj)};
+  size_t size{sizeof(bk_texture_data)};
+
+  // Split shared textures between every object using them.
+  if(ptr->texture)
+    size += ptr->texture->memsize() / ptr->texture.use_count();
+
+  return size;
 }
 
 static const rb_data_type_t
@@ -78,9 +241,8 @@ bk_alloc_texture(VALUE klass)
   VALUE obj;
   struct bk_texture_data *ptr;
 
+  // The texture is created by initialize, it may already be in the cache.
   ptr = new bk_texture_data{};
-  ptr->texture = std::make_shared<bk_sTexture>();
-  ptr->texture->loader = new Loader::Stack<bk_sTexture>{ptr->texture.get()};
   obj = TypedData_Wrap_Struct(klass, &bk_texture_type, ptr);
 
   return obj;
@@ -90,14 +252,19 @@ bk_alloc_texture(VALUE klass)
   External interface.
 */
 
-VALUE
-bk_cTexture_initialize(VALUE self, VALUE file_path)
+namespace
 {
-  SafeStringValue(file_path);
-
-  bk_texture_data *ptr_d;
-  TypedData_Get_Struct(self, struct bk_texture_data, &bk_texture_type, ptr_d);
-  std::shared_ptr<bk_sTexture> ptr{ptr_d->texture};
+// Create and load a texture that is not in the cache. "surface" is the image
+// already decoded from the file, or nullptr to read it while loading.
+std::shared_ptr<bk_sTexture>
+create_texture(const std::string &texture_path, const std::string &key,
+               SDL_Surface *surface)
+{
+  std::shared_ptr<bk_sTexture> ptr{std::make_shared<bk_sTexture>()};
+  ptr->loader = new Loader::Stack<bk_sTexture>{ptr.get()};
+  ptr->surface = surface;
+  ptr->generation = 0;
+  ptr->device_bytes = 0;
 
   std::shared_ptr<BKVK::Device> device{BKGE::engine->get_devices()[0]};
   ptr->device = device;
@@ -105,8 +272,10 @@ bk_cTexture_initialize(VALUE self, VALUE file_path)
   ptr->loader->add(&bk_sTexture::load_image, &bk_sTexture::unload_image);
   ptr->loader->add(&bk_sTexture::load_sampler, &bk_sTexture::unload_sampler);
   ptr->loader->add(&bk_sTexture::load_view, &bk_sTexture::unload_view);
+  ptr->loader->add(&bk_sTexture::load_texture_index,
+                   &bk_sTexture::unload_texture_index);
 
-  ptr->texture_path = StringValueCStr(file_path);
+  ptr->texture_path = texture_path;
 
   try
   {
@@ -114,49 +283,275 @@ bk_cTexture_initialize(VALUE self, VALUE file_path)
   }
   catch(Loader::Error le)
   {
-    std::string base_error{"Failed to load texture → "};
-    base_error += le.message;
-    rb_raise(rb_eRuntimeError, "%s\n", base_error.c_str());
+    throw Loader::Error{"Failed to load texture → " + le.message};
   }
 
+  if(!key.empty())
+    BKGE::engine->get_asset_cache()->textures.insert(key, ptr);
+  BKGE::engine->get_residency()->add(ptr);
+
+  return ptr;
+}
+
+// Work of Texture.load_all on paths that are already checked. Store the
+// textures in the Texture objects of "result", return the error message or
+// nil. It does not raise, so its locals are always destroyed.
+VALUE
+load_textures(VALUE file_paths, VALUE result)
+{
+  auto &textures{BKGE::engine->get_asset_cache()->textures};
+  size_t quantity{static_cast<size_t>(RARRAY_LEN(file_paths))};
+  std::vector<std::string> paths(quantity);
+  std::vector<std::string> keys(quantity);
+  std::vector<std::shared_ptr<bk_sTexture>> loaded(quantity);
+  // Index of the first entry with the same file, or the entry itself.
+  std::vector<size_t> first(quantity);
+  std::unordered_map<std::string, size_t> first_by_key;
+  // Entries that need a worker thread to decode their image.
+  std::vector<size_t> to_decode;
+
+  for(size_t i{0}; i < quantity; i++)
+  {
+    VALUE file_path{rb_ary_entry(file_paths, static_cast<long>(i))};
+    paths[i].assign(RSTRING_PTR(file_path), RSTRING_LEN(file_path));
+    keys[i] = BKGE::AssetCache::make_key(paths[i]);
+    first[i] = i;
+
+    if(!keys[i].empty())
+    {
+      auto found{first_by_key.find(keys[i])};
+      if(found != first_by_key.end())
+      {
+        first[i] = found->second;
+        continue;
+      }
+      first_by_key[keys[i]] = i;
+
+      loaded[i] = textures.find(keys[i]);
+      if(loaded[i]) continue;
+    }
+
+    // Texture files are already in GPU format, they have nothing to decode.
+    if(!BKGE::TextureFile::is_texture_file(paths[i])) to_decode.push_back(i);
+  }
+
+  // Decode the images in parallel. Vulkan objects are only created
+  // afterwards, in this thread.
+  std::vector<SDL_Surface*> surfaces(quantity, nullptr);
+  std::vector<std::string> decode_errors(quantity);
+  {
+    std::atomic<size_t> next{0};
+    auto decode = [&](){
+      for(size_t n{next++}; n < to_decode.size(); n = next++)
+      {
+        size_t i{to_decode[n]};
+        surfaces[i] = IMG_Load(paths[i].c_str());
+        if(surfaces[i] == nullptr) decode_errors[i] = IMG_GetError();
+      }
+    };
+
+    size_t threads_quantity{std::min<size_t>(
+        std::max(std::thread::hardware_concurrency(), 1u),
+        to_decode.size())};
+    std::vector<std::thread> threads;
+    try
+    {
+      threads.reserve(threads_quantity);
+      for(size_t i{1}; i < threads_quantity; i++) threads.emplace_back(decode);
+    }
+    catch(const std::exception &)
+    {
+      // The system could not start another thread (std::system_error) or
+      // the vector could not grow. Threads already started keep decoding,
+      // this one decodes the rest and joins them.
+    }
+    decode();
+    for(auto &thread: threads) thread.join();
+  }
+
+  std::string error;
+  for(size_t i{0}; i < quantity; i++)
+  {
+    if(first[i] != i)
+      loaded[i] = loaded[first[i]];
+    else if(!loaded[i] && error.empty())
+    {
+      if(!decode_errors[i].empty())
+        error = "Failed to load texture → Failed to load image. "
+            "SDL2_image Error → " + decode_errors[i];
+      else
+      {
+        try
+        {
+          loaded[i] = create_texture(paths[i], keys[i], surfaces[i]);
+        }
+        catch(Loader::Error le)
+        {
+          error = le.message;
+        }
+      }
+    }
+    // Surfaces not handed over to a texture because of an error.
+    else if(surfaces[i] != nullptr)
+      SDL_FreeSurface(surfaces[i]);
+  }
+  if(!error.empty()) return rb_str_new_cstr(error.c_str());
+
+  for(size_t i{0}; i < quantity; i++)
+    bk_cTexture_get_data(rb_ary_entry(result, static_cast<long>(i)))->texture =
+        loaded[i];
+
+  return Qnil;
+}
+
+}
+
+VALUE
+bk_cTexture_initialize(VALUE self, VALUE file_path)
+{
+  SafeStringValue(file_path);
+
+  bk_texture_data *ptr_d;
+  TypedData_Get_Struct(self, struct bk_texture_data, &bk_texture_type, ptr_d);
+
+  const char *c_path{StringValueCStr(file_path)};
+
+  // rb_raise skips C++ destructors, so it waits until this scope ends.
+  VALUE error{Qnil};
+  {
+    std::string texture_path{c_path};
+    std::string key{BKGE::AssetCache::make_key(texture_path)};
+
+    if(!key.empty())
+    {
+      ptr_d->texture = BKGE::engine->get_asset_cache()->textures.find(key);
+      if(ptr_d->texture) return self;
+    }
+
+    try
+    {
+      ptr_d->texture = create_texture(texture_path, key, nullptr);
+    }
+    catch(Loader::Error le)
+    {
+      error = rb_str_new_cstr(le.message.c_str());
+    }
+  }
+  if(!NIL_P(error)) rb_raise(rb_eRuntimeError, "%s\n", RSTRING_PTR(error));
+
   return self;
 }
 
+VALUE
+bk_cTexture_load_all(VALUE klass, VALUE file_paths)
+{
+  Check_Type(file_paths, T_ARRAY);
+
+  // Everything that can raise comes first: rb_raise skips C++ destructors,
+  // so no C++ object may be alive when it does.
+  long quantity{RARRAY_LEN(file_paths)};
+  VALUE paths{rb_ary_new_capa(quantity)};
+  VALUE result{rb_ary_new_capa(quantity)};
+  for(long i{0}; i < quantity; i++)
+  {
+    VALUE file_path{rb_ary_entry(file_paths, i)};
+    SafeStringValue(file_path);
+    StringValueCStr(file_path);
+    rb_ary_push(paths, file_path);
+    rb_ary_push(result, bk_alloc_texture(klass));
+  }
+
+  VALUE error{load_textures(paths, result)};
+  RB_GC_GUARD(paths);
+  if(!NIL_P(error)) rb_raise(rb_eRuntimeError, "%s\n", RSTRING_PTR(error));
+
+  return result;
+}
+
 bk_sTexture::~bk_sTexture()
 {
   this->loader->unload();
   delete this->loader;
+  if(this->surface != nullptr) SDL_FreeSurface(this->surface);
 }
 
 void
 bk_sTexture::load_image()
 {
-  SDL_Surface *image{nullptr};
+  this->staging_ring = BKGE::engine->get_staging_ring();
+  this->generation++;
+
+  if(BKGE::TextureFile::is_texture_file(this->texture_path))
+    this->load_image_from_texture_file();
+  else
+    this->load_image_from_surface();
+
+  // Ruby can not see this memory, but it is released by its finalizers.
+  this->device_bytes = this->memory_allocation.size;
+  rb_gc_adjust_memory_usage(static_cast<ssize_t>(this->device_bytes));
+}
+
+void
+bk_sTexture::load_image_from_surface()
+{
+  // The image may have been decoded already by a worker thread.
+  SDL_Surface *image{this->surface};
+  this->surface = nullptr;
+  this->vk_format = VK_FORMAT_R8G8B8A8_UNORM;
+
+  if(image == nullptr) image = IMG_Load(this->texture_path.c_str());
+  if(image == nullptr)
+  {
+    std::string base_error{"Failed to load image. SDL2_image Error → "};
+    base_error += IMG_GetError();
+    throw Loader::Error{base_error};
+  }
 
-  // Load file image from file.
+  // Pixels are converted straight into staging memory. Only formats without
+  // a conversion kernel go through an intermediate surface.
+  BKGE::PixelSwizzle swizzle;
+  if(!BKGE::PixelSwizzle::make(image->format, &swizzle))
   {
-    SDL_Surface *raw_surface{nullptr};
-    raw_surface = IMG_Load(this->texture_path.c_str());
-    if(raw_surface == nullptr)
-      rb_raise(bk_eError, "Failed to load image. SDL2_image Error: %s",
-               IMG_GetError());
-
-    image = SDL_ConvertSurfaceFormat(raw_surface, SDL_PIXELFORMAT_RGBA8888, 0);
-    if(image == nullptr)
-      rb_raise(bk_eError, "Failed to convert image. SDL2 Error: %s",
-               SDL_GetError());
-
-    this->width = static_cast<uint32_t>(image->w);
-    this->height = static_cast<uint32_t>(image->h);
-    this->mip_levels = 1;
-
-    SDL_FreeSurface(raw_surface);
+    SDL_Surface *converted{
+      SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA32, 0)};
+    SDL_FreeSurface(image);
+    if(converted == nullptr)
+    {
+      std::string base_error{"Failed to convert image. SDL2 Error → "};
+      base_error += SDL_GetError();
+      throw Loader::Error{base_error};
+    }
+    image = converted;
+    BKGE::PixelSwizzle::make(image->format, &swizzle);
   }
 
-  // Load file image into a vulkan buffer.
-  size_t image_size{static_cast<size_t>(
-      image->format->BytesPerPixel * image->w * image->h)};
-  BKVK::SourceBuffer source_image_buffer{device, image->pixels, image_size};
+  this->width = static_cast<uint32_t>(image->w);
+  this->height = static_cast<uint32_t>(image->h);
+  this->mip_levels = static_cast<uint32_t>(
+      std::floor(std::log2(std::max(this->width, this->height)))) + 1;
+
+  const uint8_t *image_pixels{static_cast<const uint8_t*>(image->pixels)};
+  size_t image_pitch{static_cast<size_t>(image->pitch)};
+  auto convert_row = [&](uint8_t *dst_data, uint32_t row){
+    swizzle.convert_row(image_pixels + row * image_pitch, dst_data,
+                        this->width);
+  };
+
+  // The GPU can only build the mip chain if it can blit the format with a
+  // linear filter.
+  bool gpu_mipmaps;
+  {
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(
+        this->device->get_vk_physical_device(), this->vk_format,
+        &format_properties);
+
+    VkFormatFeatureFlags blit_features{
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT};
+    gpu_mipmaps = (format_properties.optimalTilingFeatures & blit_features) ==
+        blit_features;
+  }
 
   // Create vulkan image.
   {
@@ -167,72 +562,247 @@ bk_sTexture::load_image()
       vk_extent3d.height = this->height;
       vk_extent3d.depth = 1;
 
+      VkImageUsageFlags vk_usage{
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT};
+      if(gpu_mipmaps) vk_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
       BKVK::Image::create(
           this->device,
           &this->vk_image,
-          &this->vk_device_memory,
-          VK_FORMAT_R8G8B8A8_UNORM,
+          &this->memory_allocation,
+          this->vk_format,
           vk_extent3d,
           this->mip_levels,
           VK_IMAGE_TILING_OPTIMAL,
-          VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+          vk_usage);
     }
     catch(BKVK::Image::Error le)
     {
+      SDL_FreeSurface(image);
       throw Loader::Error{le.message};
     }
   }
 
-  // Copy image from vulkan buffer into vulkan image.
+  // Copy image through the staging ring into the vulkan image.
   {
-    auto queue_family{BKGE::engine->get_queues_families_with_graphics()[0]};
-    auto queue{queue_family->get_queue()};
-    BKVK::CommandPool command_pool{queue_family, 1};
-    VkCommandBuffer vk_command_buffer{
-      command_pool.get_vk_command_buffers()[0]};
-
-    queue->submit_one_time_command(vk_command_buffer, [&](){
-        move_image_state(
-            vk_command_buffer, this->vk_image, VK_FORMAT_R8G8B8A8_UNORM,
-            0, VK_ACCESS_TRANSFER_WRITE_BIT,
-            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-        VkBufferImageCopy image_copy{};
-        image_copy.bufferOffset = 0;
-        image_copy.bufferRowLength = 0;
-        image_copy.bufferImageHeight = 0;
-        image_copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        image_copy.imageSubresource.mipLevel = 0;
-        image_copy.imageSubresource.baseArrayLayer = 0;
-        image_copy.imageSubresource.layerCount = 1;
-        image_copy.imageOffset = {0, 0, 0};
-        image_copy.imageExtent = {this->width, this->height, 1};
-
-        vkCmdCopyBufferToImage(
-            vk_command_buffer, source_image_buffer.get_vk_buffer(),
-            this->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-            &image_copy);
-
-        move_image_state(
-            vk_command_buffer, this->vk_image, VK_FORMAT_R8G8B8A8_UNORM,
-            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-      });
+    auto all_levels_to_transfer = [&](VkCommandBuffer vk_command_buffer){
+      move_image_state(
+          vk_command_buffer, this->vk_image, this->vk_format,
+          0, VK_ACCESS_TRANSFER_WRITE_BIT,
+          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          0, this->mip_levels);
+    };
+
+    try
+    {
+      if(gpu_mipmaps)
+        upload_level(
+            this->staging_ring.get(), this->vk_image, 0, 4 * this->width, 1,
+            this->width, this->height, convert_row, all_levels_to_transfer,
+            [&](VkCommandBuffer vk_command_buffer){
+              blit_mipmaps(vk_command_buffer, this->vk_image, this->width,
+                           this->height, this->mip_levels);
+            });
+      else
+      {
+        // The box filter needs the base level in the final format.
+        std::vector<uint8_t> level_pixels(4 * this->width * this->height);
+        for(uint32_t row{0}; row < this->height; row++)
+          convert_row(&level_pixels[4 * this->width * row], row);
+
+        std::vector<uint8_t> next_level_pixels;
+        uint32_t level_width{this->width};
+        uint32_t level_height{this->height};
+
+        for(uint32_t level{0}; level < this->mip_levels; level++)
+        {
+          size_t row_size{4 * level_width};
+
+          upload_level(
+              this->staging_ring.get(), this->vk_image, level, row_size, 1,
+              level_width, level_height,
+              [&](uint8_t *dst_data, uint32_t row){
+                memcpy(dst_data, &level_pixels[row * row_size], row_size);
+              },
+              [&](VkCommandBuffer vk_command_buffer){
+                if(level == 0) all_levels_to_transfer(vk_command_buffer);
+              },
+              [&](VkCommandBuffer vk_command_buffer){
+                if(level == this->mip_levels - 1)
+                  move_image_state(
+                      vk_command_buffer, this->vk_image, this->vk_format,
+                      VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                      0, this->mip_levels);
+              });
+
+          if(level == this->mip_levels - 1) break;
+
+          uint32_t next_width{std::max(level_width / 2, 1u)};
+          uint32_t next_height{std::max(level_height / 2, 1u)};
+          next_level_pixels = box_filter(
+              level_pixels.data(), row_size, level_width, level_height,
+              next_width, next_height);
+          level_pixels.swap(next_level_pixels);
+          level_width = next_width;
+          level_height = next_height;
+        }
+      }
+    }
+    catch(Loader::Error le)
+    {
+      this->unload_image();
+      SDL_FreeSurface(image);
+      throw;
+    }
   }
 
   // Free resources.
   SDL_FreeSurface(image);
 }
 
+void
+bk_sTexture::load_image_from_texture_file()
+{
+  BKGE::TextureFile file{this->texture_path};
+  VkFormat file_format{file.get_vk_format()};
+
+  this->width = file.get_width();
+  this->height = file.get_height();
+  this->mip_levels = static_cast<uint32_t>(file.get_levels().size());
+
+  // Upload the blocks as they are when the device can sample the format,
+  // otherwise decompress every level on the CPU.
+  bool compressed{false};
+  if(this->device->get_texture_compression_bc())
+  {
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(
+        this->device->get_vk_physical_device(), file_format,
+        &format_properties);
+
+    VkFormatFeatureFlags sample_features{
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT};
+    compressed = (format_properties.optimalTilingFeatures & sample_features) ==
+        sample_features;
+  }
+  this->vk_format = compressed ?
+      file_format : BKGE::BCn::decoded_format(file_format);
+
+  // Create vulkan image.
+  try
+  {
+    VkExtent3D vk_extent3d{};
+    vk_extent3d.width = this->width;
+    vk_extent3d.height = this->height;
+    vk_extent3d.depth = 1;
+
+    BKVK::Image::create(
+        this->device,
+        &this->vk_image,
+        &this->memory_allocation,
+        this->vk_format,
+        vk_extent3d,
+        this->mip_levels,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+  }
+  catch(BKVK::Image::Error le)
+  {
+    throw Loader::Error{le.message};
+  }
+
+  // Copy every level through the staging ring into the vulkan image.
+  try
+  {
+    uint32_t block_size{BKGE::BCn::block_size(file_format)};
+
+    for(uint32_t level{0}; level < this->mip_levels; level++)
+    {
+      const BKGE::TextureFile::Level &file_level{file.get_levels()[level]};
+      const uint8_t *data{file.get_level_data(level)};
+      std::vector<uint8_t> pixels;
+      size_t row_size;
+      uint32_t block_height;
+
+      if(compressed)
+      {
+        row_size = (file_level.width + 3) / 4 * block_size;
+        block_height = 4;
+      }
+      else
+      {
+        pixels = BKGE::BCn::decode(
+            file_format, data, file_level.width, file_level.height);
+        data = pixels.data();
+        row_size = 4 * file_level.width;
+        block_height = 1;
+      }
+
+      upload_level(
+          this->staging_ring.get(), this->vk_image, level, row_size,
+          block_height, file_level.width, file_level.height,
+          [&](uint8_t *dst_data, uint32_t row){
+            memcpy(dst_data, data + row * row_size, row_size);
+          },
+          [&](VkCommandBuffer vk_command_buffer){
+            if(level == 0)
+              move_image_state(
+                  vk_command_buffer, this->vk_image, this->vk_format,
+                  0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_IMAGE_LAYOUT_UNDEFINED,
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                  VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  0, this->mip_levels);
+          },
+          [&](VkCommandBuffer vk_command_buffer){
+            if(level == this->mip_levels - 1)
+              move_image_state(
+                  vk_command_buffer, this->vk_image, this->vk_format,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                  0, this->mip_levels);
+          });
+    }
+  }
+  catch(Loader::Error le)
+  {
+    this->unload_image();
+    throw;
+  }
+}
+
 void
 bk_sTexture::unload_image()
 {
+  // The image can not be destroyed while a copy into it is still pending.
+  this->staging_ring->wait_idle();
   vkDestroyImage(this->device->get_vk_device(), this->vk_image, nullptr);
-  vkFreeMemory(this->device->get_vk_device(), this->vk_device_memory, nullptr);
+  this->device->get_memory_allocator()->free(this->memory_allocation);
+
+  rb_gc_adjust_memory_usage(-static_cast<ssize_t>(this->device_bytes));
+  this->device_bytes = 0;
+}
+
+size_t
+bk_sTexture::memsize() const
+{
+  size_t size{sizeof(bk_sTexture) + sizeof(Loader::Stack<bk_sTexture>) +
+              this->texture_path.capacity() + this->device_bytes};
+
+  // Image decoded ahead of loading.
+  if(this->surface != nullptr)
+    size += static_cast<size_t>(this->surface->pitch) * this->surface->h;
+
+  return size;
 }
 
 void
@@ -254,7 +824,7 @@ bk_sTexture::load_sampler()
   sampler_info.compareEnable = VK_FALSE;
   sampler_info.compareOp = VK_COMPARE_OP_NEVER;
   sampler_info.minLod = 0.0f;
-  sampler_info.maxLod = 0.0f;
+  sampler_info.maxLod = static_cast<float>(this->mip_levels);
   sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
   sampler_info.unnormalizedCoordinates = VK_FALSE;
 
@@ -278,8 +848,9 @@ bk_sTexture::load_view()
         this->device,
         &this->vk_view,
         this->vk_image,
-        VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_ASPECT_COLOR_BIT);
+        this->vk_format,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        this->mip_levels);
   }
   catch(BKVK::Image::Error le)
   {
@@ -293,6 +864,27 @@ bk_sTexture::unload_view()
   vkDestroyImageView(this->device->get_vk_device(), this->vk_view, nullptr);
 }
 
+void
+bk_sTexture::load_texture_index()
+{
+  this->texture_table = BKGE::engine->get_texture_table();
+  this->texture_index = 0;
+
+  if(this->texture_table)
+    this->texture_index = this->texture_table->add(
+        this->vk_view, this->vk_sampler);
+}
+
+void
+bk_sTexture::unload_texture_index()
+{
+  if(this->texture_table)
+  {
+    this->texture_table->remove(this->texture_index);
+    this->texture_table = nullptr;
+  }
+}
+
 struct bk_texture_data*
 bk_cTexture_get_data(VALUE self)
 {
@@ -10,6 +10,8 @@
 #include <SDL2/SDL_image.h>
 
 #include "vk_device.hpp"
+#include "vk_staging_ring.hpp"
+#include "vk_texture_table.hpp"
 
 // Keep texture data into a separated object so it can be shared with a model
 // even after the Ruby object is destroyed.
@@ -17,25 +19,51 @@ struct bk_sTexture
 {
   Loader::Stack<bk_sTexture> *loader;
   std::string texture_path;
+  // Image decoded before loading, consumed by load_image.
+  SDL_Surface *surface;
+
+  // Residency control, an evicted texture is loaded again from its file.
+  bool resident;
+  uint64_t last_used_frame;
+  // Changes every time the image is loaded, so descriptors that reference
+  // the old view know they must be written again.
+  uint32_t generation;
 
   std::shared_ptr<BKVK::Device> device;
+  std::shared_ptr<BKVK::StagingRing> staging_ring;
+  // Null when the device does not support descriptor indexing.
+  std::shared_ptr<BKVK::TextureTable> texture_table;
+  uint32_t texture_index;
   VkImage vk_image;
   VkSampler vk_sampler;
   VkImageView vk_view;
-  VkDeviceMemory vk_device_memory;
+  BKVK::MemoryAllocation memory_allocation;
+  VkFormat vk_format;
   uint32_t width, height;
   uint32_t mip_levels;
+  // Device memory held by the image, reported to Ruby's garbage collector.
+  size_t device_bytes;
 
   ~bk_sTexture();
 
+  // Host and device bytes used by this texture.
+  size_t memsize() const;
+
   void load_image();
   void unload_image();
 
+  // Steps of load_image, one for each kind of file.
+  void load_image_from_surface();
+  void load_image_from_texture_file();
+
   void load_sampler();
   void unload_sampler();
 
   void load_view();
   void unload_view();
+
+  void load_texture_index();
+  void unload_texture_index();
 };
 
 struct bk_texture_data
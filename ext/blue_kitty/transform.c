@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+#include "transform.h"
+
+/*
+ * Document-class: BlueKitty::Transform
+ *
+ * Matrix the engine computed for an entity or camera, kept until its
+ * position or rotation changes. The engine creates it in +@transform+, it
+ * can not be created with +new+.
+ */
+
+/*
+ * Document-method: BlueKitty::Transform#invalidate
+ *
+ * Compute the matrix again on the next frame. Entity3D and Camera call this
+ * when they get a new position or rotation; changes made through Vector3D
+ * and Vector3DArray methods are detected without it.
+ *
+ * @return [BlueKitty::Transform] self.
+ */
+void
+Init_blue_kitty_transform(void)
+{
+  bk_cTransform = rb_define_class_under(bk_m, "Transform", rb_cData);
+  rb_undef_alloc_func(bk_cTransform);
+
+  // If I call 'rb_define_method' from C++ it won't compile. So I call in a
+  // different file.
+  rb_define_method(bk_cTransform, "invalidate", bk_cTransform_invalidate, 0);
+}
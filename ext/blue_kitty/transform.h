@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_TRANSFORM_H
+#define BLUE_KITTY_TRANSFORM_H 1
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern VALUE bk_cTransform;
+
+VALUE
+bk_cTransform_invalidate(VALUE self);
+
+void
+Init_blue_kitty_transform(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLUE_KITTY_TRANSFORM_H */
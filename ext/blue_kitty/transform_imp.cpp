@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MIT
+#include "transform.h"
+#include "transform_imp.hpp"
+
+VALUE bk_cTransform;
+
+size_t
+bk_memsize_transform(const void* obj)
+{
+  return sizeof(bk_transform_data);
+}
+
+// Transforms are created while rendering, where operator new is not allowed
+// (see allocation_counter.hpp), so Ruby allocates and frees them.
+static const rb_data_type_t
+bk_transform_type = {
+    "blue_kitty_transform",
+    {0, RUBY_TYPED_DEFAULT_FREE, bk_memsize_transform,},
+    0, 0,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+bool
+bk_transform_data::is_current(
+    const bk_vector3d_data *position, const bk_vector3d_data *rotation) const
+{
+  return !this->dirty &&
+    this->position == position->vec && this->rotation == rotation->vec &&
+    this->position_version == *position->version &&
+    this->rotation_version == *rotation->version;
+}
+
+void
+bk_transform_data::store(
+    const bk_vector3d_data *position, const bk_vector3d_data *rotation,
+    const glm::mat4 &matrix)
+{
+  this->matrix = matrix;
+  this->position = position->vec;
+  this->rotation = rotation->vec;
+  this->position_version = *position->version;
+  this->rotation_version = *rotation->version;
+  this->dirty = false;
+}
+
+VALUE
+bk_cTransform_invalidate(VALUE self)
+{
+  struct bk_transform_data *ptr;
+
+  TypedData_Get_Struct(self, struct bk_transform_data, &bk_transform_type, ptr);
+
+  ptr->dirty = true;
+
+  return self;
+}
+
+struct bk_transform_data*
+bk_cTransform_get_cache(VALUE object)
+{
+  static const ID id_at_transform{rb_intern("@transform")};
+  struct bk_transform_data *ptr;
+
+  VALUE transform{rb_ivar_get(object, id_at_transform)};
+  if(!NIL_P(transform))
+  {
+    TypedData_Get_Struct(
+        transform, struct bk_transform_data, &bk_transform_type, ptr);
+    return ptr;
+  }
+
+  if(OBJ_FROZEN(object)) return nullptr;
+
+  transform = TypedData_Make_Struct(
+      bk_cTransform, struct bk_transform_data, &bk_transform_type, ptr);
+  ptr->dirty = true;
+  rb_ivar_set(object, id_at_transform, transform);
+
+  return ptr;
+}
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_TRANSFORM_IMP_HPP
+#define BLUE_KITTY_TRANSFORM_IMP_HPP 1
+
+#include <glm/glm.hpp>
+
+#include "main.h"
+#include "vector3d_imp.hpp"
+
+struct bk_transform_data
+{
+  glm::mat4 matrix;
+  // Vectors matrix was computed from and their versions at that time. They
+  // are only compared, never read.
+  const glm::dvec3 *position;
+  const glm::dvec3 *rotation;
+  uint64_t position_version;
+  uint64_t rotation_version;
+  // Set when the owner gets new vectors, whose address may be the one of a
+  // collected vector.
+  bool dirty;
+
+  bool is_current(const bk_vector3d_data *position,
+                  const bk_vector3d_data *rotation) const;
+  void store(const bk_vector3d_data *position,
+             const bk_vector3d_data *rotation, const glm::mat4 &matrix);
+};
+
+// Transform kept in the @transform of object, created the first time. Return
+// nullptr for frozen objects that have none.
+struct bk_transform_data*
+bk_cTransform_get_cache(VALUE object);
+
+#endif /* BLUE_KITTY_TRANSFORM_IMP_HPP */
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MIT
+#include "vector3d_array.h"
+
+/*
+ * Document-class: BlueKitty::Vector3DArray
+ *
+ * A fixed number of vectors packed in native memory. Each method changes
+ * every vector with a single Ruby call, which is much faster than calling
+ * BlueKitty::Vector3D methods in a loop. Entities can use a slot as their
+ * position or rotation:
+ *
+ *   positions = BlueKitty::Vector3DArray.new(1000)
+ *   entity.position = positions[42]
+ *   positions.add(velocities)
+ */
+
+/*
+ * Document-method: BlueKitty::Vector3DArray#[]
+ *
+ * @param index [Integer]
+ * @return [BlueKitty::Vector3D] a vector that reads and writes the slot, it
+ *   keeps the array alive.
+ */
+
+/*
+ * Document-method: BlueKitty::Vector3DArray#add
+ *
+ * Add to each vector the vector at the same index of +values+, or +values+
+ * itself when it is a single Vector3D.
+ *
+ * @param values [BlueKitty::Vector3DArray, BlueKitty::Vector3D]
+ * @return [BlueKitty::Vector3DArray] self.
+ */
+
+/*
+ * Document-method: BlueKitty::Vector3DArray#scale
+ *
+ * Multiply each vector by a number, by the axes of a Vector3D, or by the
+ * vector at the same index of a Vector3DArray.
+ *
+ * @param factors [Numeric, BlueKitty::Vector3D, BlueKitty::Vector3DArray]
+ * @return [BlueKitty::Vector3DArray] self.
+ */
+
+/*
+ * Document-method: BlueKitty::Vector3DArray#rotate
+ *
+ * Rotate each vector like BlueKitty::Vector3D#rotate, by one rotation or by
+ * the rotation at the same index of a Vector3DArray.
+ *
+ * @param rotations [BlueKitty::Vector3D, BlueKitty::Vector3DArray] angles in
+ *   degrees.
+ * @return [BlueKitty::Vector3DArray] self.
+ */
+
+/*
+ * Document-method: BlueKitty::Vector3DArray#lerp
+ *
+ * Move each vector toward a target by the fraction +t+ of the distance.
+ *
+ * @param targets [BlueKitty::Vector3DArray, BlueKitty::Vector3D]
+ * @param t [Numeric] 0.0 keeps the vectors, 1.0 moves them to the targets.
+ * @return [BlueKitty::Vector3DArray] self.
+ */
+
+/*
+ * Document-method: BlueKitty::Vector3DArray#gather
+ *
+ * @param indexes [Array<Integer>]
+ * @return [BlueKitty::Vector3DArray] a new array with copies of the vectors
+ *   at +indexes+, in the same order.
+ */
+
+/*
+ * Document-method: BlueKitty::Vector3DArray#scatter
+ *
+ * Write the vectors of +values+ at +indexes+, the opposite of #gather. A
+ * single Vector3D is written at every index.
+ *
+ * @param indexes [Array<Integer>]
+ * @param values [BlueKitty::Vector3DArray, BlueKitty::Vector3D]
+ * @return [BlueKitty::Vector3DArray] self.
+ */
+void
+Init_blue_kitty_vector3d_array(void)
+{
+  bk_cVector3DArray = rb_define_class_under(bk_m, "Vector3DArray", rb_cData);
+  rb_define_alloc_func(bk_cVector3DArray, bk_alloc_vector3d_array);
+
+  // If I call 'rb_define_method' from C++ it won't compile. So I call in a
+  // different file.
+  rb_define_method(
+      bk_cVector3DArray, "initialize", bk_cVector3DArray_initialize, 1);
+
+  rb_define_method(bk_cVector3DArray, "size", bk_cVector3DArray_size, 0);
+  rb_define_method(bk_cVector3DArray, "length", bk_cVector3DArray_size, 0);
+  rb_define_method(bk_cVector3DArray, "[]", bk_cVector3DArray_aref, 1);
+  rb_define_method(bk_cVector3DArray, "[]=", bk_cVector3DArray_aset, 2);
+
+  rb_define_method(bk_cVector3DArray, "add", bk_cVector3DArray_add, 1);
+  rb_define_method(bk_cVector3DArray, "scale", bk_cVector3DArray_scale, 1);
+  rb_define_method(bk_cVector3DArray, "rotate", bk_cVector3DArray_rotate, 1);
+  rb_define_method(bk_cVector3DArray, "lerp", bk_cVector3DArray_lerp, 2);
+
+  rb_define_method(bk_cVector3DArray, "gather", bk_cVector3DArray_gather, 1);
+  rb_define_method(
+      bk_cVector3DArray, "scatter", bk_cVector3DArray_scatter, 2);
+}
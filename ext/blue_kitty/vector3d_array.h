@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VECTOR3D_ARRAY_H
+#define BLUE_KITTY_VECTOR3D_ARRAY_H 1
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern VALUE bk_cVector3DArray;
+
+VALUE
+bk_alloc_vector3d_array(VALUE klass);
+
+VALUE
+bk_cVector3DArray_initialize(VALUE self, VALUE size);
+
+VALUE
+bk_cVector3DArray_size(VALUE self);
+
+VALUE
+bk_cVector3DArray_aref(VALUE self, VALUE index);
+
+VALUE
+bk_cVector3DArray_aset(VALUE self, VALUE index, VALUE v3d);
+
+VALUE
+bk_cVector3DArray_add(VALUE self, VALUE values);
+
+VALUE
+bk_cVector3DArray_scale(VALUE self, VALUE factors);
+
+VALUE
+bk_cVector3DArray_rotate(VALUE self, VALUE rotations);
+
+VALUE
+bk_cVector3DArray_lerp(VALUE self, VALUE targets, VALUE t);
+
+VALUE
+bk_cVector3DArray_gather(VALUE self, VALUE indexes);
+
+VALUE
+bk_cVector3DArray_scatter(VALUE self, VALUE indexes, VALUE values);
+
+void
+Init_blue_kitty_vector3d_array(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLUE_KITTY_VECTOR3D_ARRAY_H */
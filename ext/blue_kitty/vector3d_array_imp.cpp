@@ -0,0 +1,327 @@
+// SPDX-License-Identifier: MIT
+#include "vector3d.h"
+#include "vector3d_array.h"
+#include "vector3d_array_imp.hpp"
+#include "vector3d_imp.hpp"
+
+VALUE bk_cVector3DArray;
+
+void
+bk_free_vector3d_array(void* obj)
+{
+  struct bk_vector3d_array_data *ptr;
+  ptr = static_cast<bk_vector3d_array_data*>(obj);
+  delete ptr;
+}
+
+size_t
+bk_memsize_vector3d_array(const void* obj)
+{
+  const struct bk_vector3d_array_data *ptr;
+  ptr = static_cast<const bk_vector3d_array_data*>(obj);
+  return sizeof(bk_vector3d_array_data) +
+    ptr->vecs.capacity() * sizeof(glm::dvec3);
+}
+
+static const rb_data_type_t
+bk_vector3d_array_type = {
+    "blue_kitty_vector3d_array",
+    {0, bk_free_vector3d_array, bk_memsize_vector3d_array,},
+    0, 0,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+namespace
+{
+size_t
+slot_index(const bk_vector3d_array_data *ptr, VALUE index)
+{
+  long i{NUM2LONG(index)};
+
+  if(i < 0 || static_cast<size_t>(i) >= ptr->vecs.size())
+    rb_raise(rb_eIndexError, "index %ld outside of Vector3DArray of %ld.",
+             i, static_cast<long>(ptr->vecs.size()));
+
+  return static_cast<size_t>(i);
+}
+
+// Operations take either one value per slot or a single value for all slots.
+// Return the values of a Vector3DArray the size of count, or nullptr when
+// values is a single Vector3D.
+const glm::dvec3*
+per_slot_values(VALUE values, size_t count, const char *method)
+{
+  if(rb_obj_is_kind_of(values, bk_cVector3DArray))
+  {
+    const bk_vector3d_array_data *other{bk_cVector3DArray_get_data(values)};
+    if(other->vecs.size() != count)
+      rb_raise(rb_eArgError, "%s expect a Vector3DArray of %ld vectors.",
+               method, static_cast<long>(count));
+    return other->vecs.data();
+  }
+
+  if(!rb_obj_is_kind_of(values, bk_cVector3D))
+    rb_raise(rb_eArgError, "%s expect a Vector3D or a Vector3DArray.", method);
+
+  return nullptr;
+}
+}
+
+VALUE
+bk_alloc_vector3d_array(VALUE klass)
+{
+  VALUE obj;
+  struct bk_vector3d_array_data *ptr;
+
+  ptr = new bk_vector3d_array_data{};
+  obj = TypedData_Wrap_Struct(klass, &bk_vector3d_array_type, ptr);
+
+  return obj;
+}
+
+VALUE
+bk_cVector3DArray_initialize(VALUE self, VALUE size)
+{
+  struct bk_vector3d_array_data *ptr;
+  long count{NUM2LONG(size)};
+
+  if(count < 0)
+    rb_raise(rb_eArgError, "%s", "initialize expect a size of zero or more.");
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  // Assigning again would move the vectors that slots point to.
+  if(ptr->initialized)
+    rb_raise(rb_eRuntimeError, "%s", "Vector3DArray is already initialized.");
+
+  ptr->vecs.assign(static_cast<size_t>(count), glm::dvec3{0.0});
+  ptr->initialized = true;
+
+  ptr->version++;
+
+  return self;
+}
+
+VALUE
+bk_cVector3DArray_size(VALUE self)
+{
+  struct bk_vector3d_array_data *ptr;
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  return ULONG2NUM(ptr->vecs.size());
+}
+
+VALUE
+bk_cVector3DArray_aref(VALUE self, VALUE index)
+{
+  struct bk_vector3d_array_data *ptr;
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  return bk_cVector3D_new_slot(
+      self, &ptr->vecs[slot_index(ptr, index)], &ptr->version);
+}
+
+VALUE
+bk_cVector3DArray_aset(VALUE self, VALUE index, VALUE v3d)
+{
+  struct bk_vector3d_array_data *ptr;
+
+  if(!rb_obj_is_kind_of(v3d, bk_cVector3D))
+    rb_raise(rb_eArgError, "%s", "[]= expect a Vector3D as argument.");
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  size_t slot{slot_index(ptr, index)};
+  ptr->version++;
+  ptr->vecs[slot] = *bk_cVector3D_get_data(v3d)->vec;
+
+  return v3d;
+}
+
+VALUE
+bk_cVector3DArray_add(VALUE self, VALUE values)
+{
+  struct bk_vector3d_array_data *ptr;
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  const size_t count{ptr->vecs.size()};
+  glm::dvec3 *vecs{ptr->vecs.data()};
+  const glm::dvec3 *others{per_slot_values(values, count, "add")};
+
+  if(others)
+    for(size_t i{0}; i < count; i++) vecs[i] += others[i];
+  else
+  {
+    const glm::dvec3 other{*bk_cVector3D_get_data(values)->vec};
+    for(size_t i{0}; i < count; i++) vecs[i] += other;
+  }
+
+  ptr->version++;
+
+  return self;
+}
+
+VALUE
+bk_cVector3DArray_scale(VALUE self, VALUE factors)
+{
+  struct bk_vector3d_array_data *ptr;
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  const size_t count{ptr->vecs.size()};
+  glm::dvec3 *vecs{ptr->vecs.data()};
+
+  if(rb_obj_is_kind_of(factors, rb_cNumeric))
+  {
+    const double factor{NUM2DBL(factors)};
+    for(size_t i{0}; i < count; i++) vecs[i] *= factor;
+  }
+  else if(const glm::dvec3 *others{
+            per_slot_values(factors, count, "scale")})
+    for(size_t i{0}; i < count; i++) vecs[i] *= others[i];
+  else
+  {
+    const glm::dvec3 other{*bk_cVector3D_get_data(factors)->vec};
+    for(size_t i{0}; i < count; i++) vecs[i] *= other;
+  }
+
+  ptr->version++;
+
+  return self;
+}
+
+VALUE
+bk_cVector3DArray_rotate(VALUE self, VALUE rotations)
+{
+  struct bk_vector3d_array_data *ptr;
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  const size_t count{ptr->vecs.size()};
+  glm::dvec3 *vecs{ptr->vecs.data()};
+  const glm::dvec3 *others{per_slot_values(rotations, count, "rotate")};
+
+  if(others)
+    for(size_t i{0}; i < count; i++)
+      vecs[i] = glm::dvec3{
+        bk_vector3d_rotation(others[i]) * glm::dvec4{vecs[i], 1.0}};
+  else
+  {
+    // Build the matrix once for every slot.
+    const glm::dmat4 m{
+      bk_vector3d_rotation(*bk_cVector3D_get_data(rotations)->vec)};
+    for(size_t i{0}; i < count; i++)
+      vecs[i] = glm::dvec3{m * glm::dvec4{vecs[i], 1.0}};
+  }
+
+  ptr->version++;
+
+  return self;
+}
+
+VALUE
+bk_cVector3DArray_lerp(VALUE self, VALUE targets, VALUE t)
+{
+  struct bk_vector3d_array_data *ptr;
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  const double amount{NUM2DBL(t)};
+  const size_t count{ptr->vecs.size()};
+  glm::dvec3 *vecs{ptr->vecs.data()};
+  const glm::dvec3 *others{per_slot_values(targets, count, "lerp")};
+
+  if(others)
+    for(size_t i{0}; i < count; i++)
+      vecs[i] += (others[i] - vecs[i]) * amount;
+  else
+  {
+    const glm::dvec3 other{*bk_cVector3D_get_data(targets)->vec};
+    for(size_t i{0}; i < count; i++) vecs[i] += (other - vecs[i]) * amount;
+  }
+
+  ptr->version++;
+
+  return self;
+}
+
+VALUE
+bk_cVector3DArray_gather(VALUE self, VALUE indexes)
+{
+  struct bk_vector3d_array_data *ptr;
+  struct bk_vector3d_array_data *result_ptr;
+  VALUE result;
+
+  Check_Type(indexes, T_ARRAY);
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  const long count{RARRAY_LEN(indexes)};
+  result = bk_alloc_vector3d_array(rb_obj_class(self));
+  TypedData_Get_Struct(
+      result, struct bk_vector3d_array_data, &bk_vector3d_array_type,
+      result_ptr);
+  result_ptr->vecs.resize(static_cast<size_t>(count));
+
+  for(long i{0}; i < count; i++)
+    result_ptr->vecs[i] =
+      ptr->vecs[slot_index(ptr, rb_ary_entry(indexes, i))];
+
+  return result;
+}
+
+VALUE
+bk_cVector3DArray_scatter(VALUE self, VALUE indexes, VALUE values)
+{
+  struct bk_vector3d_array_data *ptr;
+
+  Check_Type(indexes, T_ARRAY);
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  const long count{RARRAY_LEN(indexes)};
+  const glm::dvec3 *others{
+    per_slot_values(values, static_cast<size_t>(count), "scatter")};
+
+  // A bad index raises before any slot changes. Indexes are checked again
+  // while writing, converting them may run Ruby code that edits the Array;
+  // the version is incremented first so cached matrices never miss a write.
+  for(long i{0}; i < count; i++) slot_index(ptr, rb_ary_entry(indexes, i));
+  ptr->version++;
+
+  if(others)
+    for(long i{0}; i < count; i++)
+      ptr->vecs[slot_index(ptr, rb_ary_entry(indexes, i))] = others[i];
+  else
+  {
+    const glm::dvec3 other{*bk_cVector3D_get_data(values)->vec};
+    for(long i{0}; i < count; i++)
+      ptr->vecs[slot_index(ptr, rb_ary_entry(indexes, i))] = other;
+  }
+
+  return self;
+}
+
+struct bk_vector3d_array_data*
+bk_cVector3DArray_get_data(VALUE self)
+{
+  struct bk_vector3d_array_data *ptr;
+
+  TypedData_Get_Struct(
+      self, struct bk_vector3d_array_data, &bk_vector3d_array_type, ptr);
+
+  return ptr;
+}
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VECTOR3D_ARRAY_IMP_HPP
+#define BLUE_KITTY_VECTOR3D_ARRAY_IMP_HPP 1
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "main.h"
+
+struct bk_vector3d_array_data
+{
+  // Never resized after initialize, Vector3D slots point into it.
+  std::vector<glm::dvec3> vecs;
+  // Set by initialize, which can not run twice.
+  bool initialized;
+  // Incremented by every change to any vector, see bk_vector3d_data.
+  uint64_t version;
+};
+
+struct bk_vector3d_array_data*
+bk_cVector3DArray_get_data(VALUE self);
+
+#endif /* BLUE_KITTY_VECTOR3D_ARRAY_IMP_HPP */
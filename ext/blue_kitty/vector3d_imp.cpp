@@ -6,6 +6,14 @@
 
 VALUE bk_cVector3D;
 
+void
+bk_mark_vector3d(void* obj)
+{
+  struct bk_vector3d_data *ptr;
+  ptr = static_cast<bk_vector3d_data*>(obj);
+  rb_gc_mark(ptr->array);
+}
+
 void
 bk_free_vector3d(void* obj)
 {
@@ -17,14 +25,13 @@ bk_free_vector3d(void* obj)
 size_t
 bk_memsize_vector3d(const void* obj)
 {
-  // TODO
-  return 0;
+  return sizeof(bk_vector3d_data);
 }
 
 static const rb_data_type_t
 bk_vector3d_type = {
     "blue_kitty_vector3d",
-    {0, bk_free_vector3d, bk_memsize_vector3d,},
+    {bk_mark_vector3d, bk_free_vector3d, bk_memsize_vector3d,},
     0, 0,
     RUBY_TYPED_FREE_IMMEDIATELY,
 };
@@ -36,6 +43,9 @@ bk_alloc_vector3d(VALUE klass)
   struct bk_vector3d_data *ptr;
 
   ptr = new bk_vector3d_data{};
+  ptr->vec = &ptr->value;
+  ptr->version = &ptr->own_version;
+  ptr->array = Qnil;
   obj = TypedData_Wrap_Struct(klass, &bk_vector3d_type, ptr);
 
   return obj;
@@ -52,9 +62,11 @@ bk_cVector3D_initialize(VALUE self, VALUE x, VALUE y, VALUE z)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.x = NUM2DBL(x);
-  ptr->vec.y = NUM2DBL(y);
-  ptr->vec.z = NUM2DBL(z);
+  ptr->vec->x = NUM2DBL(x);
+  ptr->vec->y = NUM2DBL(y);
+  ptr->vec->z = NUM2DBL(z);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -68,7 +80,9 @@ bk_cVector3D_set_x(VALUE self, VALUE x)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.x = NUM2DBL(x);
+  ptr->vec->x = NUM2DBL(x);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -82,7 +96,9 @@ bk_cVector3D_set_y(VALUE self, VALUE y)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.y = NUM2DBL(y);
+  ptr->vec->y = NUM2DBL(y);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -96,7 +112,9 @@ bk_cVector3D_set_z(VALUE self, VALUE z)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.z = NUM2DBL(z);
+  ptr->vec->z = NUM2DBL(z);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -111,8 +129,10 @@ bk_cVector3D_set_xy(VALUE self, VALUE x, VALUE y)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.x = NUM2DBL(x);
-  ptr->vec.y = NUM2DBL(y);
+  ptr->vec->x = NUM2DBL(x);
+  ptr->vec->y = NUM2DBL(y);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -127,8 +147,10 @@ bk_cVector3D_set_yz(VALUE self, VALUE y, VALUE z)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.y = NUM2DBL(y);
-  ptr->vec.z = NUM2DBL(z);
+  ptr->vec->y = NUM2DBL(y);
+  ptr->vec->z = NUM2DBL(z);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -143,8 +165,10 @@ bk_cVector3D_set_xz(VALUE self, VALUE x, VALUE z)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.x = NUM2DBL(x);
-  ptr->vec.z = NUM2DBL(z);
+  ptr->vec->x = NUM2DBL(x);
+  ptr->vec->z = NUM2DBL(z);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -160,9 +184,11 @@ bk_cVector3D_set_xyz(VALUE self, VALUE x, VALUE y, VALUE z)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.x = NUM2DBL(x);
-  ptr->vec.y = NUM2DBL(y);
-  ptr->vec.z = NUM2DBL(z);
+  ptr->vec->x = NUM2DBL(x);
+  ptr->vec->y = NUM2DBL(y);
+  ptr->vec->z = NUM2DBL(z);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -174,7 +200,7 @@ bk_cVector3D_get_x(VALUE self)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  return rb_float_new(ptr->vec.x);
+  return rb_float_new(ptr->vec->x);
 }
 
 VALUE
@@ -184,7 +210,7 @@ bk_cVector3D_get_y(VALUE self)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  return rb_float_new(ptr->vec.y);
+  return rb_float_new(ptr->vec->y);
 }
 
 VALUE
@@ -194,7 +220,7 @@ bk_cVector3D_get_z(VALUE self)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  return rb_float_new(ptr->vec.z);
+  return rb_float_new(ptr->vec->z);
 }
 
 VALUE
@@ -206,8 +232,8 @@ bk_cVector3D_get_xy(VALUE self)
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
   vec = rb_ary_new();
-  rb_ary_push(vec, rb_float_new(ptr->vec.x));
-  rb_ary_push(vec, rb_float_new(ptr->vec.y));
+  rb_ary_push(vec, rb_float_new(ptr->vec->x));
+  rb_ary_push(vec, rb_float_new(ptr->vec->y));
 
   return vec;
 }
@@ -221,8 +247,8 @@ bk_cVector3D_get_yz(VALUE self)
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
   vec = rb_ary_new();
-  rb_ary_push(vec, rb_float_new(ptr->vec.y));
-  rb_ary_push(vec, rb_float_new(ptr->vec.z));
+  rb_ary_push(vec, rb_float_new(ptr->vec->y));
+  rb_ary_push(vec, rb_float_new(ptr->vec->z));
 
   return vec;
 }
@@ -236,8 +262,8 @@ bk_cVector3D_get_xz(VALUE self)
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
   vec = rb_ary_new();
-  rb_ary_push(vec, rb_float_new(ptr->vec.x));
-  rb_ary_push(vec, rb_float_new(ptr->vec.z));
+  rb_ary_push(vec, rb_float_new(ptr->vec->x));
+  rb_ary_push(vec, rb_float_new(ptr->vec->z));
 
   return vec;
 }
@@ -251,9 +277,9 @@ bk_cVector3D_get_xyz(VALUE self)
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
   vec = rb_ary_new();
-  rb_ary_push(vec, rb_float_new(ptr->vec.x));
-  rb_ary_push(vec, rb_float_new(ptr->vec.y));
-  rb_ary_push(vec, rb_float_new(ptr->vec.z));
+  rb_ary_push(vec, rb_float_new(ptr->vec->x));
+  rb_ary_push(vec, rb_float_new(ptr->vec->y));
+  rb_ary_push(vec, rb_float_new(ptr->vec->z));
 
   return vec;
 }
@@ -267,7 +293,9 @@ bk_cVector3D_update_x(VALUE self, VALUE x)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.x += NUM2DBL(x);
+  ptr->vec->x += NUM2DBL(x);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -281,7 +309,9 @@ bk_cVector3D_update_y(VALUE self, VALUE y)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.y += NUM2DBL(y);
+  ptr->vec->y += NUM2DBL(y);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -295,7 +325,9 @@ bk_cVector3D_update_z(VALUE self, VALUE z)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.z += NUM2DBL(z);
+  ptr->vec->z += NUM2DBL(z);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -310,8 +342,10 @@ bk_cVector3D_update_xy(VALUE self, VALUE x, VALUE y)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.x += NUM2DBL(x);
-  ptr->vec.y += NUM2DBL(y);
+  ptr->vec->x += NUM2DBL(x);
+  ptr->vec->y += NUM2DBL(y);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -326,8 +360,10 @@ bk_cVector3D_update_yz(VALUE self, VALUE y, VALUE z)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.y += NUM2DBL(y);
-  ptr->vec.z += NUM2DBL(z);
+  ptr->vec->y += NUM2DBL(y);
+  ptr->vec->z += NUM2DBL(z);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -342,8 +378,10 @@ bk_cVector3D_update_xz(VALUE self, VALUE x, VALUE z)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.x += NUM2DBL(x);
-  ptr->vec.z += NUM2DBL(z);
+  ptr->vec->x += NUM2DBL(x);
+  ptr->vec->z += NUM2DBL(z);
+
+  (*ptr->version)++;
 
   return self;
 }
@@ -359,13 +397,26 @@ bk_cVector3D_update_xyz(VALUE self, VALUE x, VALUE y, VALUE z)
 
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
 
-  ptr->vec.x += NUM2DBL(x);
-  ptr->vec.y += NUM2DBL(y);
-  ptr->vec.z += NUM2DBL(z);
+  ptr->vec->x += NUM2DBL(x);
+  ptr->vec->y += NUM2DBL(y);
+  ptr->vec->z += NUM2DBL(z);
+
+  (*ptr->version)++;
 
   return self;
 }
 
+glm::dmat4
+bk_vector3d_rotation(const glm::dvec3 &rotation)
+{
+  glm::dmat4 m{1.0};
+  m = glm::rotate(m, glm::radians(rotation.x), glm::dvec3{1.0, 0.0, 0.0});
+  m = glm::rotate(m, glm::radians(rotation.y), glm::dvec3{0.0, 1.0, 0.0});
+  m = glm::rotate(m, glm::radians(rotation.z), glm::dvec3{0.0, 0.0, 1.0});
+
+  return m;
+}
+
 VALUE
 vk_cVector3D_rotate(VALUE self, VALUE v3d)
 {
@@ -378,16 +429,14 @@ vk_cVector3D_rotate(VALUE self, VALUE v3d)
   TypedData_Get_Struct(self, struct bk_vector3d_data, &bk_vector3d_type, ptr);
   TypedData_Get_Struct(v3d, struct bk_vector3d_data, &bk_vector3d_type, r);
 
-  glm::dmat4 m{1.0};
-  m = glm::rotate(m, glm::radians(r->vec.x), glm::dvec3{1.0, 0.0, 0.0});
-  m = glm::rotate(m, glm::radians(r->vec.y), glm::dvec3{0.0, 1.0, 0.0});
-  m = glm::rotate(m, glm::radians(r->vec.z), glm::dvec3{0.0, 0.0, 1.0});
+  glm::dmat4 m{bk_vector3d_rotation(*r->vec)};
+  glm::dvec4 result = m * glm::dvec4{*ptr->vec, 1.0};
 
-  glm::dvec4 result = m * glm::dvec4{ptr->vec.x, ptr->vec.y, ptr->vec.z, 1.0};
+  ptr->vec->x = result.x;
+  ptr->vec->y = result.y;
+  ptr->vec->z = result.z;
 
-  ptr->vec.x = result.x;
-  ptr->vec.y = result.y;
-  ptr->vec.z = result.z;
+  (*ptr->version)++;
 
   return self;
 }
@@ -401,3 +450,19 @@ bk_cVector3D_get_data(VALUE self)
 
   return ptr;
 }
+
+VALUE
+bk_cVector3D_new_slot(VALUE array, glm::dvec3 *slot, uint64_t *version)
+{
+  VALUE obj;
+  struct bk_vector3d_data *ptr;
+
+  obj = bk_alloc_vector3d(bk_cVector3D);
+  TypedData_Get_Struct(obj, struct bk_vector3d_data, &bk_vector3d_type, ptr);
+
+  ptr->vec = slot;
+  ptr->version = version;
+  ptr->array = array;
+
+  return obj;
+}
@@ -2,14 +2,33 @@
 #ifndef BLUE_KITTY_INPUT_VECTOR3D_IMP_HPP
 #define BLUE_KITTY_INPUT_VECTOR3D_IMP_HPP 1
 
-#include <glm/vec3.hpp>
+#include <glm/glm.hpp>
+
+#include "main.h"
 
 struct bk_vector3d_data
 {
-  glm::dvec3 vec;
+  // Points to value, or to a slot of the Vector3DArray in array.
+  glm::dvec3 *vec;
+  glm::dvec3 value;
+  // Incremented by every change to vec, so cached matrices know when to be
+  // computed again. Slots share the version of their array.
+  uint64_t *version;
+  uint64_t own_version;
+  // Qnil for vectors that own their value. Marked, so the slot outlives
+  // every vector that refers to it.
+  VALUE array;
 };
 
 struct bk_vector3d_data*
 bk_cVector3D_get_data(VALUE self);
 
+// Rotation in degrees around X, then Y, then Z, as Vector3D#rotate does.
+glm::dmat4
+bk_vector3d_rotation(const glm::dvec3 &rotation);
+
+// Create a Vector3D that reads and writes slot, which array owns.
+VALUE
+bk_cVector3D_new_slot(VALUE array, glm::dvec3 *slot, uint64_t *version);
+
 #endif /* BLUE_KITTY_INPUT_VECTOR3D_IMP_HPP */
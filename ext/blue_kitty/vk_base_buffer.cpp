@@ -31,34 +31,28 @@ void BaseBuffer::load_memory()
   vkGetBufferMemoryRequirements(this->device->get_vk_device(),
                                 this->vk_buffer, &memory_requirements);
 
-  VkPhysicalDeviceMemoryProperties memory_properties;
-  vkGetPhysicalDeviceMemoryProperties(this->device->get_vk_physical_device(),
-                                      &memory_properties);
-
-  VkMemoryAllocateInfo alloc_info = {};
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.pNext = nullptr;
-  alloc_info.allocationSize = memory_requirements.size;
+  uint32_t memory_type;
   try
   {
-    alloc_info.memoryTypeIndex = device->select_memory_type(
-        memory_requirements, this->vk_memory_properties);
+    memory_type = device->select_memory_type(
+        memory_requirements, this->vk_memory_properties,
+        this->vk_preferred_memory_properties);
   }
   catch(std::runtime_error error)
   {
     throw Loader::Error{error.what()};
   }
 
-  if(vkAllocateMemory(this->device->get_vk_device(), &alloc_info, nullptr,
-                      &this->vk_device_memory) != VK_SUCCESS)
-    throw Loader::Error{"Could not allocate memory for Vulkan vertex buffer."};
+  this->memory_allocation = this->device->get_memory_allocator()->allocate(
+      memory_requirements, memory_type, true);
 
   vkBindBufferMemory(this->device->get_vk_device(), this->vk_buffer,
-                     this->vk_device_memory, 0);
+                     this->memory_allocation.vk_device_memory,
+                     this->memory_allocation.offset);
 }
 
 void BaseBuffer::unload_memory()
 {
-  vkFreeMemory(this->device->get_vk_device(), this->vk_device_memory, nullptr);
+  this->device->get_memory_allocator()->free(this->memory_allocation);
 }
 }
@@ -23,10 +23,12 @@ class BaseBuffer
   std::shared_ptr<Device> device;
 
   VkBuffer vk_buffer;
-  VkDeviceMemory vk_device_memory;
+  MemoryAllocation memory_allocation;
   VkDeviceSize vk_device_size;
   VkBufferUsageFlags vk_buffer_usage;
   VkMemoryPropertyFlags vk_memory_properties;
+  // Used when a memory type has them, not required.
+  VkMemoryPropertyFlags vk_preferred_memory_properties{0};
 
   void load_buffer();
   void unload_buffer();
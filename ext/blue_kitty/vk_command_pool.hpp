@@ -31,7 +31,7 @@ class CommandPool
 
   inline std::shared_ptr<QueueFamily> get_queue_family() const
   { return this->queue_family; };
-  inline std::vector<VkCommandBuffer> get_vk_command_buffers() const
+  inline const std::vector<VkCommandBuffer> &get_vk_command_buffers() const
   { return this->vk_command_buffers; };
 
  private:
@@ -0,0 +1,481 @@
+// SPDX-License-Identifier: MIT
+#include "vk_depth_pyramid.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "vk_image.hpp"
+
+namespace
+{
+const VkFormat vk_pyramid_format{VK_FORMAT_R32_SFLOAT};
+
+// Sizes of a level and of its source, read by depth_pyramid.comp.
+struct LevelConstants
+{
+  int32_t source_width, source_height;
+  int32_t destination_width, destination_height;
+};
+}
+
+namespace BKVK
+{
+DepthPyramid::DepthPyramid(const std::shared_ptr<Device> &device,
+                           VkImageView vk_depth_image_view,
+                           const VkExtent2D &depth_extent,
+                           uint32_t frame_count):
+    device{device},
+    vk_depth_image_view{vk_depth_image_view},
+    depth_extent{depth_extent},
+    frame_count{frame_count},
+    readback_frame{nullptr},
+    loader{this}
+{
+  this->loader.add(&DepthPyramid::load_image, &DepthPyramid::unload_image);
+  this->loader.add(&DepthPyramid::load_sampler, &DepthPyramid::unload_sampler);
+  this->loader.add(&DepthPyramid::load_pipeline,
+                   &DepthPyramid::unload_pipeline);
+  this->loader.add(&DepthPyramid::load_descriptor_sets,
+                   &DepthPyramid::unload_descriptor_sets);
+  this->loader.add(&DepthPyramid::load_readback_buffers,
+                   &DepthPyramid::unload_readback_buffers);
+
+  try
+  {
+    this->loader.load();
+  }
+  catch(Loader::Error le)
+  {
+    throw Loader::Error{"Could not initialize depth pyramid → " + le.message};
+  }
+}
+
+DepthPyramid::~DepthPyramid()
+{
+  this->loader.unload();
+}
+
+void DepthPyramid::record(VkCommandBuffer vk_command_buffer, uint32_t frame,
+                          const glm::mat4 &view, const glm::mat4 &proj)
+{
+  // Every level is written again, so the old contents can be discarded. The
+  // copy of the frame before may still be reading them.
+  VkImageMemoryBarrier image_barrier{};
+  image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  image_barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  image_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  image_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  image_barrier.image = this->vk_image;
+  image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  image_barrier.subresourceRange.baseMipLevel = 0;
+  image_barrier.subresourceRange.levelCount = this->levels.size();
+  image_barrier.subresourceRange.baseArrayLayer = 0;
+  image_barrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(
+      vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+      &image_barrier);
+
+  vkCmdBindPipeline(
+      vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->vk_pipeline);
+
+  VkExtent2D source_extent{this->depth_extent};
+  for(size_t i{0}; i < this->levels.size(); i++)
+  {
+    const Level &level{this->levels[i]};
+
+    vkCmdBindDescriptorSets(
+        vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        this->vk_pipeline_layout, 0, 1, &level.vk_descriptor_set, 0, nullptr);
+    LevelConstants level_constants{
+      static_cast<int32_t>(source_extent.width),
+      static_cast<int32_t>(source_extent.height),
+      static_cast<int32_t>(level.vk_extent.width),
+      static_cast<int32_t>(level.vk_extent.height)};
+    vkCmdPushConstants(
+        vk_command_buffer, this->vk_pipeline_layout,
+        VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(level_constants),
+        &level_constants);
+    vkCmdDispatch(
+        vk_command_buffer,
+        (level.vk_extent.width + this->workgroup_size - 1) /
+        this->workgroup_size,
+        (level.vk_extent.height + this->workgroup_size - 1) /
+        this->workgroup_size, 1);
+
+    // The next level reads this one; after the last, the copy reads them.
+    VkMemoryBarrier memory_barrier{};
+    memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                                   VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(
+        vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    source_extent = level.vk_extent;
+  }
+
+  Frame &target{this->frames[frame]};
+  vkCmdCopyImageToBuffer(
+      vk_command_buffer, this->vk_image, VK_IMAGE_LAYOUT_GENERAL,
+      target.readback_buffer->get_vk_buffer(), this->readback_regions.size(),
+      this->readback_regions.data());
+
+  VkMemoryBarrier host_barrier{};
+  host_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(
+      vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, nullptr, 0,
+      nullptr);
+
+  target.view = view;
+  target.proj = proj;
+  target.recorded = true;
+}
+
+bool DepthPyramid::use_readback(uint32_t frame)
+{
+  this->readback_frame = nullptr;
+  if(!this->frames[frame].recorded) return false;
+
+  this->readback_frame = &this->frames[frame];
+  return true;
+}
+
+bool DepthPyramid::is_occluded(const glm::vec3 &center, float radius) const
+{
+  if(this->readback_frame == nullptr) return false;
+  const Frame &frame{*this->readback_frame};
+
+  // The camera looks down -Z. A sphere that reaches the camera is never
+  // hidden.
+  glm::vec4 view_center{frame.view * glm::vec4{center, 1.0f}};
+  float near_distance{-view_center.z - radius};
+  if(near_distance <= 0.0f) return false;
+  float far_distance{near_distance + 2.0f * radius};
+
+  glm::vec4 nearest{frame.proj * glm::vec4{0.0f, 0.0f, -near_distance, 1.0f}};
+  float nearest_depth{nearest.z / nearest.w};
+
+  // Screen bounds of the box around the sphere, in texture coordinates.
+  auto screen_range = [&](float position, float scale, float &low,
+                          float &high)
+  {
+    std::array<float, 4> corners{
+      scale * (position - radius) / near_distance,
+      scale * (position - radius) / far_distance,
+      scale * (position + radius) / near_distance,
+      scale * (position + radius) / far_distance};
+    low = *std::min_element(corners.begin(), corners.end()) * 0.5f + 0.5f;
+    high = *std::max_element(corners.begin(), corners.end()) * 0.5f + 0.5f;
+  };
+  float u_low, u_high, v_low, v_high;
+  screen_range(view_center.x, frame.proj[0][0], u_low, u_high);
+  screen_range(view_center.y, frame.proj[1][1], v_low, v_high);
+
+  // Outside the screen of that frame there is no depth to compare with, and
+  // the camera may be looking there now.
+  if(u_low < 0.0f || u_high > 1.0f || v_low < 0.0f || v_high > 1.0f)
+    return false;
+
+  // The finest level read back where the bounds cover few texels.
+  size_t level_index{this->first_readback_level};
+  while(level_index + 1 < this->levels.size() &&
+        ((u_high - u_low) * this->levels[level_index].vk_extent.width > 2.0f ||
+         (v_high - v_low) * this->levels[level_index].vk_extent.height > 2.0f))
+    level_index++;
+  const Level &level{this->levels[level_index]};
+
+  uint32_t width{level.vk_extent.width}, height{level.vk_extent.height};
+  uint32_t x_low{std::min(static_cast<uint32_t>(u_low * width), width - 1)};
+  uint32_t x_high{std::min(static_cast<uint32_t>(u_high * width), width - 1)};
+  uint32_t y_low{std::min(static_cast<uint32_t>(v_low * height), height - 1)};
+  uint32_t y_high{
+    std::min(static_cast<uint32_t>(v_high * height), height - 1)};
+
+  const float *depths{reinterpret_cast<const float*>(
+      frame.readback_buffer->get_mapped() + level.readback_offset)};
+  float farthest_depth{0.0f};
+  for(uint32_t y{y_low}; y <= y_high; y++)
+    for(uint32_t x{x_low}; x <= x_high; x++)
+      farthest_depth = std::max(farthest_depth, depths[y * width + x]);
+
+  return nearest_depth > farthest_depth;
+}
+
+void DepthPyramid::load_image()
+{
+  // Each level has half the size of the one before, the first has half the
+  // size of the depth image.
+  VkExtent2D extent{this->depth_extent};
+  do
+  {
+    extent.width = std::max(extent.width / 2, 1u);
+    extent.height = std::max(extent.height / 2, 1u);
+    this->levels.push_back({extent, VK_NULL_HANDLE, VK_NULL_HANDLE, 0});
+  } while(extent.width > 1 || extent.height > 1);
+
+  this->first_readback_level = 0;
+  while(this->first_readback_level + 1 < this->levels.size() &&
+        std::max(this->levels[this->first_readback_level].vk_extent.width,
+                 this->levels[this->first_readback_level].vk_extent.height) >
+        this->max_readback_extent)
+    this->first_readback_level++;
+
+  this->readback_size = 0;
+  for(size_t i{this->first_readback_level}; i < this->levels.size(); i++)
+  {
+    Level &level{this->levels[i]};
+    level.readback_offset = this->readback_size;
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = level.readback_offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = i;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {level.vk_extent.width, level.vk_extent.height, 1};
+    this->readback_regions.push_back(region);
+
+    this->readback_size +=
+        level.vk_extent.width * level.vk_extent.height * sizeof(float);
+  }
+
+  try
+  {
+    BKVK::Image::create(
+        this->device, &this->vk_image, &this->memory_allocation,
+        vk_pyramid_format,
+        {this->levels[0].vk_extent.width, this->levels[0].vk_extent.height, 1},
+        this->levels.size(), VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+  }
+  catch(BKVK::Image::Error le)
+  {
+    this->levels.clear();
+    this->readback_regions.clear();
+    throw Loader::Error{"Failed to create depth pyramid image → " +
+          le.message};
+  }
+
+  try
+  {
+    for(size_t i{0}; i < this->levels.size(); i++)
+      BKVK::Image::create_view(
+          this->device, &this->levels[i].vk_image_view, this->vk_image,
+          vk_pyramid_format, VK_IMAGE_ASPECT_COLOR_BIT, 1, i);
+  }
+  catch(BKVK::Image::Error le)
+  {
+    this->unload_image();
+    throw Loader::Error{"Failed to create depth pyramid view → " +
+          le.message};
+  }
+}
+
+void DepthPyramid::unload_image()
+{
+  for(auto &level: this->levels)
+    if(level.vk_image_view != VK_NULL_HANDLE)
+      vkDestroyImageView(this->device->get_vk_device(), level.vk_image_view,
+                         nullptr);
+  vkDestroyImage(this->device->get_vk_device(), this->vk_image, nullptr);
+  this->device->get_memory_allocator()->free(this->memory_allocation);
+
+  this->levels.clear();
+  this->readback_regions.clear();
+}
+
+void DepthPyramid::load_sampler()
+{
+  // Shaders use texelFetch, the sampler only has to exist.
+  VkSamplerCreateInfo sampler_info{};
+  sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sampler_info.pNext = nullptr;
+  sampler_info.flags = 0;
+  sampler_info.magFilter = VK_FILTER_NEAREST;
+  sampler_info.minFilter = VK_FILTER_NEAREST;
+  sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.mipLodBias = 0.0f;
+  sampler_info.anisotropyEnable = VK_FALSE;
+  sampler_info.maxAnisotropy = 1.0f;
+  sampler_info.compareEnable = VK_FALSE;
+  sampler_info.compareOp = VK_COMPARE_OP_NEVER;
+  sampler_info.minLod = 0.0f;
+  sampler_info.maxLod = 0.0f;
+  sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  sampler_info.unnormalizedCoordinates = VK_FALSE;
+
+  if(vkCreateSampler(this->device->get_vk_device(), &sampler_info, nullptr,
+                     &this->vk_sampler) != VK_SUCCESS)
+    throw Loader::Error{"Failed to create depth pyramid sampler."};
+}
+
+void DepthPyramid::unload_sampler()
+{
+  vkDestroySampler(this->device->get_vk_device(), this->vk_sampler, nullptr);
+}
+
+void DepthPyramid::load_pipeline()
+{
+  VkShaderModule vk_shader_module{
+    this->device->get_vk_shader_module(Shader::depth_pyramid_comp)};
+
+  this->descriptor_set_layout =
+      std::make_shared<DSL::DepthPyramid>(this->device);
+  VkDescriptorSetLayout vk_descriptor_set_layout{
+    this->descriptor_set_layout->get_vk_descriptor_set_layout()};
+
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(LevelConstants);
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info{};
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount = 1;
+  pipeline_layout_info.pSetLayouts = &vk_descriptor_set_layout;
+  pipeline_layout_info.pushConstantRangeCount = 1;
+  pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+  if(vkCreatePipelineLayout(
+         this->device->get_vk_device(), &pipeline_layout_info, nullptr,
+         &this->vk_pipeline_layout) != VK_SUCCESS)
+  {
+    this->descriptor_set_layout = nullptr;
+    throw Loader::Error{"Failed to create depth pyramid pipeline layout."};
+  }
+
+  VkComputePipelineCreateInfo pipeline_info{};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipeline_info.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipeline_info.stage.module = vk_shader_module;
+  pipeline_info.stage.pName = "main";
+  pipeline_info.layout = this->vk_pipeline_layout;
+
+  if(vkCreateComputePipelines(
+         this->device->get_vk_device(),
+         this->device->get_vk_pipeline_cache(), 1, &pipeline_info, nullptr,
+         &this->vk_pipeline) != VK_SUCCESS)
+  {
+    vkDestroyPipelineLayout(this->device->get_vk_device(),
+                            this->vk_pipeline_layout, nullptr);
+    this->descriptor_set_layout = nullptr;
+    throw Loader::Error{"Failed to create depth pyramid pipeline."};
+  }
+}
+
+void DepthPyramid::unload_pipeline()
+{
+  vkDestroyPipeline(this->device->get_vk_device(), this->vk_pipeline, nullptr);
+  vkDestroyPipelineLayout(this->device->get_vk_device(),
+                          this->vk_pipeline_layout, nullptr);
+  this->descriptor_set_layout = nullptr;
+}
+
+void DepthPyramid::load_descriptor_sets()
+{
+  auto allocator{this->device->get_descriptor_allocator()};
+  VkDescriptorSetLayout vk_layout{
+    this->descriptor_set_layout->get_vk_descriptor_set_layout()};
+
+  for(size_t i{0}; i < this->levels.size(); i++)
+  {
+    Level &level{this->levels[i]};
+    level.vk_descriptor_set = allocator->allocate(vk_layout);
+
+    // The first level reads the depth image, the others the level before.
+    VkDescriptorImageInfo source_info{};
+    source_info.sampler = this->vk_sampler;
+    if(i == 0)
+    {
+      source_info.imageView = this->vk_depth_image_view;
+      source_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    else
+    {
+      source_info.imageView = this->levels[i - 1].vk_image_view;
+      source_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+    VkDescriptorImageInfo destination_info{};
+    destination_info.sampler = VK_NULL_HANDLE;
+    destination_info.imageView = level.vk_image_view;
+    destination_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 2> write_descriptors{};
+    write_descriptors[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptors[0].dstSet = level.vk_descriptor_set;
+    write_descriptors[0].dstBinding = 0;
+    write_descriptors[0].dstArrayElement = 0;
+    write_descriptors[0].descriptorCount = 1;
+    write_descriptors[0].descriptorType =
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write_descriptors[0].pBufferInfo = nullptr;
+    write_descriptors[0].pImageInfo = &source_info;
+    write_descriptors[0].pTexelBufferView = nullptr;
+
+    write_descriptors[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptors[1].dstSet = level.vk_descriptor_set;
+    write_descriptors[1].dstBinding = 1;
+    write_descriptors[1].dstArrayElement = 0;
+    write_descriptors[1].descriptorCount = 1;
+    write_descriptors[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write_descriptors[1].pBufferInfo = nullptr;
+    write_descriptors[1].pImageInfo = &destination_info;
+    write_descriptors[1].pTexelBufferView = nullptr;
+
+    vkUpdateDescriptorSets(
+        this->device->get_vk_device(), write_descriptors.size(),
+        write_descriptors.data(), 0, nullptr);
+  }
+}
+
+void DepthPyramid::unload_descriptor_sets()
+{
+  auto allocator{this->device->get_descriptor_allocator()};
+  VkDescriptorSetLayout vk_layout{
+    this->descriptor_set_layout->get_vk_descriptor_set_layout()};
+
+  for(auto &level: this->levels)
+    if(level.vk_descriptor_set != VK_NULL_HANDLE)
+    {
+      allocator->free(vk_layout, level.vk_descriptor_set);
+      level.vk_descriptor_set = VK_NULL_HANDLE;
+    }
+}
+
+void DepthPyramid::load_readback_buffers()
+{
+  this->frames.resize(this->frame_count);
+  for(auto &frame: this->frames)
+  {
+    frame.readback_buffer = std::make_unique<ReadbackBuffer>(
+        this->device, this->readback_size);
+    frame.recorded = false;
+  }
+}
+
+void DepthPyramid::unload_readback_buffers()
+{
+  this->readback_frame = nullptr;
+  this->frames.clear();
+}
+}
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VK_DEPTH_PYRAMID_HPP
+#define BLUE_KITTY_VK_DEPTH_PYRAMID_HPP 1
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "loader.hpp"
+#include "vk_descriptor_set_layout_depth_pyramid.hpp"
+#include "vk_device.hpp"
+#include "vk_readback_buffer.hpp"
+
+namespace BKVK
+{
+/*
+  Farthest depth of a frame at decreasing resolutions (Hi-Z). A compute
+  shader builds the pyramid from the depth image after the render pass, and
+  the coarse levels are copied into the readback buffer of the frame in
+  flight. When the fence of that frame is signaled, the CPU tests bounding
+  spheres against them with the matrices the frame was drawn with: a sphere
+  behind the farthest depth of every texel it covers was hidden in that
+  frame.
+*/
+class DepthPyramid
+{
+  friend class Loader::Stack<DepthPyramid>;
+
+  DepthPyramid(const DepthPyramid &t) = delete;
+  DepthPyramid& operator=(const DepthPyramid &t) = delete;
+  DepthPyramid(const DepthPyramid &&t) = delete;
+  DepthPyramid& operator=(const DepthPyramid &&t) = delete;
+
+ public:
+  explicit DepthPyramid(const std::shared_ptr<Device> &device,
+                        VkImageView vk_depth_image_view,
+                        const VkExtent2D &depth_extent,
+                        uint32_t frame_count);
+  ~DepthPyramid();
+
+  // Record after the render pass that wrote the depth image, the readback of
+  // the frame is written when these commands run.
+  void record(VkCommandBuffer vk_command_buffer, uint32_t frame,
+              const glm::mat4 &view, const glm::mat4 &proj);
+  // Test against the readback of a frame whose commands completed. Return
+  // false when that frame never recorded the pyramid.
+  bool use_readback(uint32_t frame);
+  // True if the sphere was hidden in the frame given to use_readback.
+  bool is_occluded(const glm::vec3 &center, float radius) const;
+
+ private:
+  struct Level
+  {
+    VkExtent2D vk_extent;
+    VkImageView vk_image_view;
+    VkDescriptorSet vk_descriptor_set;
+    // Only levels from first_readback_level on are copied.
+    VkDeviceSize readback_offset;
+  };
+
+  struct Frame
+  {
+    std::unique_ptr<ReadbackBuffer> readback_buffer;
+    glm::mat4 view, proj;
+    bool recorded;
+  };
+
+  std::shared_ptr<Device> device;
+  VkImageView vk_depth_image_view;
+  VkExtent2D depth_extent;
+  uint32_t frame_count;
+
+  VkImage vk_image;
+  MemoryAllocation memory_allocation;
+  std::vector<Level> levels;
+  uint32_t first_readback_level;
+  std::vector<VkBufferImageCopy> readback_regions;
+  VkDeviceSize readback_size;
+
+  VkSampler vk_sampler;
+  std::shared_ptr<DSL::DepthPyramid> descriptor_set_layout;
+  VkPipelineLayout vk_pipeline_layout;
+  VkPipeline vk_pipeline;
+
+  std::vector<Frame> frames;
+  const Frame *readback_frame;
+
+  Loader::Stack<DepthPyramid> loader;
+
+  // Levels this size or smaller, in texels on each axis, are read back.
+  const uint32_t max_readback_extent = 128;
+  const uint32_t workgroup_size = 8;
+
+  void load_image();
+  void unload_image();
+
+  void load_sampler();
+  void unload_sampler();
+
+  void load_pipeline();
+  void unload_pipeline();
+
+  void load_descriptor_sets();
+  void unload_descriptor_sets();
+
+  void load_readback_buffers();
+  void unload_readback_buffers();
+};
+}
+
+#endif /* BLUE_KITTY_VK_DEPTH_PYRAMID_HPP */
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: MIT
+#include "vk_descriptor_allocator.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include "loader.hpp"
+
+namespace BKVK
+{
+DescriptorAllocator::DescriptorAllocator(VkDevice vk_device):
+    vk_device{vk_device},
+    pending_sets(1),
+    current_frame{0},
+    sets_in_use{0},
+    recycled_sets{0}
+{
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+  // Destroying a pool also frees its sets.
+  for(auto vk_pool: this->vk_pools)
+    vkDestroyDescriptorPool(this->vk_device, vk_pool, nullptr);
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(
+    VkDescriptorSetLayout vk_descriptor_set_layout)
+{
+  auto free_list{this->free_sets.find(vk_descriptor_set_layout)};
+  if(free_list != this->free_sets.end() && !free_list->second.empty())
+  {
+    VkDescriptorSet vk_descriptor_set{free_list->second.back()};
+    free_list->second.pop_back();
+    this->sets_in_use++;
+    this->recycled_sets++;
+    return vk_descriptor_set;
+  }
+
+  if(this->vk_pools.empty()) this->create_pool();
+
+  VkDescriptorSetAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = this->vk_pools.back();
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &vk_descriptor_set_layout;
+
+  VkDescriptorSet vk_descriptor_set;
+  VkResult result{vkAllocateDescriptorSets(
+      this->vk_device, &alloc_info, &vk_descriptor_set)};
+
+  // The current pool is full, the next one will have room.
+  if(result == VK_ERROR_OUT_OF_POOL_MEMORY ||
+     result == VK_ERROR_FRAGMENTED_POOL)
+  {
+    this->create_pool();
+    alloc_info.descriptorPool = this->vk_pools.back();
+    result = vkAllocateDescriptorSets(
+        this->vk_device, &alloc_info, &vk_descriptor_set);
+  }
+
+  if(result != VK_SUCCESS)
+    throw Loader::Error{"Failed to allocate Vulkan descriptor set."};
+
+  this->sets_in_use++;
+  return vk_descriptor_set;
+}
+
+void DescriptorAllocator::free(
+    VkDescriptorSetLayout vk_descriptor_set_layout,
+    VkDescriptorSet vk_descriptor_set)
+{
+  this->pending_sets[this->current_frame].emplace_back(
+      vk_descriptor_set_layout, vk_descriptor_set);
+  this->sets_in_use--;
+}
+
+void DescriptorAllocator::release_frame(uint32_t frame)
+{
+  if(frame >= this->pending_sets.size()) this->pending_sets.resize(frame + 1);
+
+  for(const auto &[vk_layout, vk_descriptor_set]: this->pending_sets[frame])
+    this->free_sets[vk_layout].push_back(vk_descriptor_set);
+  this->pending_sets[frame].clear();
+  this->current_frame = frame;
+}
+
+void DescriptorAllocator::forget(
+    VkDescriptorSetLayout vk_descriptor_set_layout)
+{
+  // The sets stay allocated in their pools until the device is destroyed.
+  this->free_sets.erase(vk_descriptor_set_layout);
+  for(auto &sets: this->pending_sets)
+    sets.erase(std::remove_if(
+        sets.begin(), sets.end(), [vk_descriptor_set_layout](const auto &set){
+          return set.first == vk_descriptor_set_layout; }), sets.end());
+}
+
+void DescriptorAllocator::create_pool()
+{
+  // Room for every layout of the engine; sets of a single type do not use
+  // the counts of the others.
+  std::array<VkDescriptorPoolSize, 4> descriptor_pool_sizes{};
+  descriptor_pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptor_pool_sizes[0].descriptorCount = this->sets_per_pool * 2;
+  descriptor_pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptor_pool_sizes[1].descriptorCount = this->sets_per_pool;
+  descriptor_pool_sizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptor_pool_sizes[2].descriptorCount = this->sets_per_pool;
+  descriptor_pool_sizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  descriptor_pool_sizes[3].descriptorCount = this->sets_per_pool / 4;
+
+  // No VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT: sets go back to the
+  // free lists, never to the pool, which lets the driver use a simpler
+  // allocator.
+  VkDescriptorPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.pNext = nullptr;
+  pool_info.flags = 0;
+  pool_info.maxSets = this->sets_per_pool;
+  pool_info.poolSizeCount = descriptor_pool_sizes.size();
+  pool_info.pPoolSizes = descriptor_pool_sizes.data();
+
+  VkDescriptorPool vk_pool;
+  if(vkCreateDescriptorPool(
+         this->vk_device, &pool_info, nullptr, &vk_pool) != VK_SUCCESS)
+    throw Loader::Error{"Failed to create a Vulkan descriptor pool."};
+
+  this->vk_pools.push_back(vk_pool);
+}
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VK_DESCRIPTOR_ALLOCATOR_HPP
+#define BLUE_KITTY_VK_DESCRIPTOR_ALLOCATOR_HPP 1
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace BKVK
+{
+/*
+  Hand out descriptor sets from pools shared by the whole device. Pools are
+  created only when the current one is full and never destroyed before the
+  device. Freed sets are kept in a list for their layout and given back to the
+  next request with the same layout, so creating a model costs a list pop
+  instead of a new VkDescriptorPool. A freed set may still be bound by
+  frames in flight, so it joins the free list only after its frame slot
+  comes around again.
+*/
+class DescriptorAllocator
+{
+  DescriptorAllocator(const DescriptorAllocator &t) = delete;
+  DescriptorAllocator& operator=(const DescriptorAllocator &t) = delete;
+  DescriptorAllocator(const DescriptorAllocator &&t) = delete;
+  DescriptorAllocator& operator=(const DescriptorAllocator &&t) = delete;
+
+ public:
+  explicit DescriptorAllocator(VkDevice vk_device);
+  ~DescriptorAllocator();
+
+  VkDescriptorSet allocate(VkDescriptorSetLayout vk_descriptor_set_layout);
+  void free(VkDescriptorSetLayout vk_descriptor_set_layout,
+            VkDescriptorSet vk_descriptor_set);
+  // Call after waiting for the fence of the frame slot, sets freed the last
+  // time this slot began are not in use by the GPU anymore.
+  void release_frame(uint32_t frame);
+  // Drop the sets kept for a layout that is going to be destroyed; the
+  // driver may reuse its handle for a different layout.
+  void forget(VkDescriptorSetLayout vk_descriptor_set_layout);
+
+  inline size_t get_pool_count() const { return this->vk_pools.size(); };
+  // Sets given to someone and not freed yet.
+  inline uint32_t get_sets_in_use() const { return this->sets_in_use; };
+  inline uint32_t get_recycled_sets() const { return this->recycled_sets; };
+
+ private:
+  VkDevice vk_device;
+  // The last pool is the one new sets come from.
+  std::vector<VkDescriptorPool> vk_pools;
+  std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>>
+  free_sets;
+  // Freed sets, by the frame slot that began before they were freed.
+  std::vector<std::vector<
+    std::pair<VkDescriptorSetLayout, VkDescriptorSet>>> pending_sets;
+  uint32_t current_frame;
+
+  uint32_t sets_in_use;
+  // Sets taken from a free list instead of a pool.
+  uint32_t recycled_sets;
+
+  const uint32_t sets_per_pool = 256;
+
+  void create_pool();
+};
+}
+
+#endif /* BLUE_KITTY_VK_DESCRIPTOR_ALLOCATOR_HPP */
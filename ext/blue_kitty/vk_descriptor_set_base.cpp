@@ -6,26 +6,28 @@ namespace BKVK::DS // Descriptor set.
 
 void Base::load_sets()
 {
-  std::vector<VkDescriptorSetLayout> layouts(
-      this->uniform_buffers.size(),
-      this->descriptor_set_layout->get_vk_descriptor_set_layout());
+  auto allocator{
+    this->descriptor_set_layout->get_device()->get_descriptor_allocator()};
+  VkDescriptorSetLayout vk_layout{
+    this->descriptor_set_layout->get_vk_descriptor_set_layout()};
 
-  VkDescriptorSetAllocateInfo alloc_info{};
-  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  alloc_info.descriptorPool = this->vk_descriptor_pool;
-  alloc_info.descriptorSetCount = this->uniform_buffers.size();
-  alloc_info.pSetLayouts = layouts.data();
-
-  vk_descriptor_sets.resize(this->uniform_buffers.size());
-  if(vkAllocateDescriptorSets(
-         this->descriptor_set_layout->get_device()->get_vk_device(),
-         &alloc_info, this->vk_descriptor_sets.data()) != VK_SUCCESS)
-    Loader::Error{"Failed to create Vulkan descriptor set."};
+  this->vk_descriptor_sets.reserve(this->set_count);
+  for(size_t i{0}; i < this->set_count; i++)
+    this->vk_descriptor_sets.push_back(allocator->allocate(vk_layout));
 }
 
 void Base::unload_sets()
 {
-  // By destroying the pool the sets are also destroyed.
+  // Sets go back to the device allocator for the next object with the same
+  // layout.
+  auto allocator{
+    this->descriptor_set_layout->get_device()->get_descriptor_allocator()};
+  VkDescriptorSetLayout vk_layout{
+    this->descriptor_set_layout->get_vk_descriptor_set_layout()};
+
+  for(auto vk_descriptor_set: this->vk_descriptor_sets)
+    allocator->free(vk_layout, vk_descriptor_set);
+  this->vk_descriptor_sets.clear();
 }
 
 }
@@ -6,7 +6,6 @@
 #include <vector>
 
 #include "vk_descriptor_set_layout_base.hpp"
-#include "vk_uniform_buffer.hpp"
 
 namespace BKVK::DS // Descriptor set.
 {
@@ -17,12 +16,11 @@ class Base
 
   inline std::shared_ptr<DSL::Base> get_descriptor_set_layout() const
   { return this->descriptor_set_layout; };
-  inline std::vector<VkDescriptorSet> get_vk_descriptor_sets() const
+  inline const std::vector<VkDescriptorSet> &get_vk_descriptor_sets() const
   { return this->vk_descriptor_sets; };
 
  protected:
-  std::vector<std::shared_ptr<UniformBuffer>> uniform_buffers;
-  VkDescriptorPool vk_descriptor_pool;
+  size_t set_count;
   std::shared_ptr<DSL::Base> descriptor_set_layout;
   std::vector<VkDescriptorSet> vk_descriptor_sets;
 
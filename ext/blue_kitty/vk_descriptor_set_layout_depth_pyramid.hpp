@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef BLUE_KITTY_VK_DESCRIPTOR_SET_LAYOUT_DEPTH_PYRAMID_HPP
+#define BLUE_KITTY_VK_DESCRIPTOR_SET_LAYOUT_DEPTH_PYRAMID_HPP 1
+
+#include "vk_descriptor_set_layout_base.hpp"
+
+namespace BKVK::DSL // Descriptor set layout.
+{
+// Source and destination of one level of the depth pyramid.
+class DepthPyramid: public Base
+{
+  DepthPyramid(const DepthPyramid &dp) = delete;
+  DepthPyramid& operator=(const DepthPyramid &dp) = delete;
+  DepthPyramid(const DepthPyramid &&dp) = delete;
+  DepthPyramid& operator=(const DepthPyramid &&dp) = delete;
+
+ public:
+  explicit DepthPyramid(const std::shared_ptr<Device> &device);
+  ~DepthPyramid();
+
+};
+}
+
+#endif /* BLUE_KITTY_VK_DESCRIPTOR_SET_LAYOUT_DEPTH_PYRAMID_HPP */
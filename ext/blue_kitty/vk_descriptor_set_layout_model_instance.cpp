@@ -1,35 +1,28 @@
 // SPDX-License-Identifier: MIT
 #include "vk_descriptor_set_layout_model_instance.hpp"
 
-#include <array>
-
 namespace BKVK::DSL // Descriptor set layout.
 {
 ModelInstance::ModelInstance(
-    const std::shared_ptr<Device> &device):
-    Base{device}
+    const std::shared_ptr<Device> &device, bool with_texture):
+    Base{device},
+    with_texture{with_texture}
 {
-  std::array<VkDescriptorSetLayoutBinding, 2> layout_bindings{};
-
-  layout_bindings[0].binding = 0;
-  layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  layout_bindings[0].descriptorCount = 1;
-  layout_bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  layout_bindings[0].pImmutableSamplers = nullptr;
-
-  layout_bindings[1].binding = 1;
-  layout_bindings[1].descriptorType =
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  layout_bindings[1].descriptorCount = 1;
-  layout_bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-  layout_bindings[1].pImmutableSamplers = nullptr;
+  // Instance data is in the view projection set, only a texture outside
+  // the texture table is left for each model.
+  VkDescriptorSetLayoutBinding layout_binding{};
+  layout_binding.binding = 1;
+  layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  layout_binding.descriptorCount = 1;
+  layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  layout_binding.pImmutableSamplers = nullptr;
 
   VkDescriptorSetLayoutCreateInfo layout_info{};
   layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
   layout_info.pNext = nullptr;
   layout_info.flags = 0;
-  layout_info.bindingCount = static_cast<uint32_t>(layout_bindings.size());
-  layout_info.pBindings = layout_bindings.data();
+  layout_info.bindingCount = this->with_texture ? 1 : 0;
+  layout_info.pBindings = &layout_binding;
 
   if(vkCreateDescriptorSetLayout(
          this->device->get_vk_device(), &layout_info, nullptr,
@@ -40,6 +33,8 @@ ModelInstance::ModelInstance(
 
 ModelInstance::~ModelInstance()
 {
+  this->device->get_descriptor_allocator()->forget(
+      this->vk_descriptor_set_layout);
   vkDestroyDescriptorSetLayout(this->device->get_vk_device(),
                                this->vk_descriptor_set_layout, nullptr);
 }
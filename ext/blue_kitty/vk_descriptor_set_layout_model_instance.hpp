@@ -14,9 +14,17 @@ class ModelInstance: public Base
   ModelInstance& operator=(const ModelInstance &&mi) = delete;
 
  public:
-  explicit ModelInstance(const std::shared_ptr<Device> &device);
+  explicit ModelInstance(
+      const std::shared_ptr<Device> &device, bool with_texture);
   ~ModelInstance();
 
+  // When false, textures come from the texture table and models need no
+  // descriptor set.
+  inline bool get_with_texture() const { return this->with_texture; };
+
+ private:
+  bool with_texture;
+
 };
 }
 
@@ -1,25 +1,35 @@
 // SPDX-License-Identifier: MIT
 #include "vk_descriptor_set_layout_view_projection.hpp"
 
+#include <array>
+
 namespace BKVK::DSL // Descriptor set layout.
 {
 ViewProjection::ViewProjection(
     const std::shared_ptr<Device> &device):
     Base{device}
 {
-  VkDescriptorSetLayoutBinding layout_binding{};
-  layout_binding.binding = 0;
-  layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  layout_binding.descriptorCount = 1;
-  layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  layout_binding.pImmutableSamplers = nullptr;
+  std::array<VkDescriptorSetLayoutBinding, 2> layout_bindings{};
+
+  layout_bindings[0].binding = 0;
+  layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  layout_bindings[0].descriptorCount = 1;
+  layout_bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  layout_bindings[0].pImmutableSamplers = nullptr;
+
+  // Model matrices of every instance drawn in the frame.
+  layout_bindings[1].binding = 1;
+  layout_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  layout_bindings[1].descriptorCount = 1;
+  layout_bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  layout_bindings[1].pImmutableSamplers = nullptr;
 
   VkDescriptorSetLayoutCreateInfo layout_info{};
   layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
   layout_info.pNext = nullptr;
   layout_info.flags = 0;
-  layout_info.bindingCount = 1;
-  layout_info.pBindings = &layout_binding;
+  layout_info.bindingCount = layout_bindings.size();
+  layout_info.pBindings = layout_bindings.data();
 
   if(vkCreateDescriptorSetLayout(
          this->device->get_vk_device(), &layout_info, nullptr,
@@ -30,6 +40,8 @@ ViewProjection::ViewProjection(
 
 ViewProjection::~ViewProjection()
 {
+  this->device->get_descriptor_allocator()->forget(
+      this->vk_descriptor_set_layout);
   vkDestroyDescriptorSetLayout(this->device->get_vk_device(),
                                this->vk_descriptor_set_layout, nullptr);
 }
@@ -5,9 +5,11 @@
 #include "loader.hpp"
 #include "texture_imp.hpp"
 #include "vk_descriptor_set_base.hpp"
+#include "vk_descriptor_set_layout_model_instance.hpp"
 
 namespace BKVK::DS // Descriptor set.
 {
+// Only used when textures are not in the texture table.
 class ModelInstance: public Base
 {
   friend class Loader::Stack<ModelInstance>;
@@ -19,9 +21,8 @@ class ModelInstance: public Base
 
  public:
   explicit ModelInstance(
-      const std::shared_ptr<DSL::Base> &layout,
-      const std::shared_ptr<bk_sTexture> &texture,
-      const std::vector<std::shared_ptr<UniformBuffer>> &uniform_buffers);
+      const std::shared_ptr<DSL::ModelInstance> &layout,
+      const std::shared_ptr<bk_sTexture> &texture);
   ~ModelInstance();
 
  private:
@@ -29,11 +30,8 @@ class ModelInstance: public Base
 
   std::shared_ptr<bk_sTexture> texture;
 
-  void load_pool();
-  void unload_pool();
-
-  void load_buffers();
-  void unload_buffers();
+  void load_texture();
+  void unload_texture();
 };
 }
 
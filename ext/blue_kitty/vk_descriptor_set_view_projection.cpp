@@ -1,18 +1,22 @@
 // SPDX-License-Identifier: MIT
 #include "vk_descriptor_set_view_projection.hpp"
 
+#include <array>
+
 namespace BKVK::DS // Descriptor set.
 {
 
 ViewProjection::ViewProjection(
     const std::shared_ptr<DSL::Base> &layout,
-    const std::vector<std::shared_ptr<UniformBuffer>> &uniform_buffers):
-    loader{this}
+    const std::vector<std::shared_ptr<UniformBuffer>> &uniform_buffers,
+    const std::vector<std::shared_ptr<StorageBuffer>> &instance_buffers):
+    loader{this},
+    uniform_buffers{uniform_buffers},
+    instance_buffers{instance_buffers}
 {
   this->descriptor_set_layout = layout;
-  this->uniform_buffers = uniform_buffers;
+  this->set_count = uniform_buffers.size();
 
-  this->loader.add(&ViewProjection::load_pool, &ViewProjection::unload_pool);
   this->loader.add(&ViewProjection::load_sets, &ViewProjection::unload_sets);
   this->loader.add(&ViewProjection::load_buffers,
                    &ViewProjection::unload_buffers);
@@ -35,33 +39,6 @@ ViewProjection::~ViewProjection()
   this->loader.unload();
 }
 
-void ViewProjection::load_pool()
-{
-  VkDescriptorPoolSize descriptor_pool_size{};
-  descriptor_pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  descriptor_pool_size.descriptorCount = this->uniform_buffers.size();
-
-  VkDescriptorPoolCreateInfo pool_info{};
-  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  pool_info.pNext = nullptr;
-  pool_info.flags = 0;
-  pool_info.maxSets = this->uniform_buffers.size();
-  pool_info.poolSizeCount = 1;
-  pool_info.pPoolSizes = &descriptor_pool_size;
-
-  if(vkCreateDescriptorPool(
-         this->descriptor_set_layout->get_device()->get_vk_device(),
-         &pool_info, nullptr, &this->vk_descriptor_pool) != VK_SUCCESS)
-    throw Loader::Error{"Failed to create a Vulkan descriptor pool."};
-}
-
-void ViewProjection::unload_pool()
-{
-  vkDestroyDescriptorPool(
-      this->descriptor_set_layout->get_device()->get_vk_device(),
-      this->vk_descriptor_pool, nullptr);
-}
-
 void ViewProjection::load_buffers()
 {
   for(size_t i = 0; i < this->uniform_buffers.size(); i++)
@@ -71,20 +48,35 @@ void ViewProjection::load_buffers()
     buffer_info.offset = 0;
     buffer_info.range = sizeof(UBOViewProjection);
 
-    VkWriteDescriptorSet write_descriptor{};
-    write_descriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write_descriptor.dstSet = this->vk_descriptor_sets[i];
-    write_descriptor.dstBinding = 0;
-    write_descriptor.dstArrayElement = 0;
-    write_descriptor.descriptorCount = 1;
-    write_descriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    write_descriptor.pBufferInfo = &buffer_info;
-    write_descriptor.pImageInfo = nullptr;
-    write_descriptor.pTexelBufferView = nullptr;
+    VkDescriptorBufferInfo instance_buffer_info{};
+    instance_buffer_info.buffer = this->instance_buffers[i]->get_vk_buffer();
+    instance_buffer_info.offset = 0;
+    instance_buffer_info.range = VK_WHOLE_SIZE;
+
+    std::array<VkWriteDescriptorSet, 2> write_descriptors{};
+    write_descriptors[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptors[0].dstSet = this->vk_descriptor_sets[i];
+    write_descriptors[0].dstBinding = 0;
+    write_descriptors[0].dstArrayElement = 0;
+    write_descriptors[0].descriptorCount = 1;
+    write_descriptors[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    write_descriptors[0].pBufferInfo = &buffer_info;
+    write_descriptors[0].pImageInfo = nullptr;
+    write_descriptors[0].pTexelBufferView = nullptr;
+
+    write_descriptors[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptors[1].dstSet = this->vk_descriptor_sets[i];
+    write_descriptors[1].dstBinding = 1;
+    write_descriptors[1].dstArrayElement = 0;
+    write_descriptors[1].descriptorCount = 1;
+    write_descriptors[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write_descriptors[1].pBufferInfo = &instance_buffer_info;
+    write_descriptors[1].pImageInfo = nullptr;
+    write_descriptors[1].pTexelBufferView = nullptr;
 
     vkUpdateDescriptorSets(
-        this->descriptor_set_layout->get_device()->get_vk_device(), 1,
-        &write_descriptor, 0, nullptr);
+        this->descriptor_set_layout->get_device()->get_vk_device(),
+        write_descriptors.size(), write_descriptors.data(), 0, nullptr);
   }
 }
 
@@ -4,6 +4,8 @@
 
 #include "loader.hpp"
 #include "vk_descriptor_set_base.hpp"
+#include "vk_storage_buffer.hpp"
+#include "vk_uniform_buffer.hpp"
 
 namespace BKVK::DS // Descriptor set.
 {
@@ -19,14 +21,16 @@ class ViewProjection: public Base
  public:
   explicit ViewProjection(
       const std::shared_ptr<DSL::Base> &layout,
-      const std::vector<std::shared_ptr<UniformBuffer>> &uniform_buffers);
+      const std::vector<std::shared_ptr<UniformBuffer>> &uniform_buffers,
+      const std::vector<std::shared_ptr<StorageBuffer>> &instance_buffers);
   ~ViewProjection();
 
  private:
   Loader::Stack<ViewProjection> loader;
 
-  void load_pool();
-  void unload_pool();
+  // One of each for every swapchain image.
+  std::vector<std::shared_ptr<UniformBuffer>> uniform_buffers;
+  std::vector<std::shared_ptr<StorageBuffer>> instance_buffers;
 
   void load_buffers();
   void unload_buffers();
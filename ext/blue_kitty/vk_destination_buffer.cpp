@@ -1,28 +1,34 @@
 // SPDX-License-Identifier: MIT
 #include "vk_destination_buffer.hpp"
 
+#include <cstring>
+
 namespace BKVK
 {
   DestinationBuffer::DestinationBuffer(
-      const std::shared_ptr<QueueFamily> &queue_family,
-      const std::shared_ptr<SourceBuffer> &source_buffer,
+      const std::shared_ptr<StagingRing> &staging_ring,
+      const void *data, size_t data_size,
       VkBufferUsageFlags vk_buffer_usage):
       loader{this},
-      queue_family{queue_family},
-      source_buffer{source_buffer}
+      staging_ring{staging_ring},
+      data{data}
   {
-    this->device = this->queue_family->get_device();
-    this->vk_device_size = source_buffer->get_size();
+    this->device = this->staging_ring->get_queue_family()->get_device();
+    this->vk_device_size = data_size;
     this->vk_buffer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT |
       vk_buffer_usage;
     this->vk_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if(this->device->get_direct_upload())
+      this->vk_preferred_memory_properties =
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
     this->loader.add(&DestinationBuffer::load_buffer,
       &DestinationBuffer::unload_buffer);
     this->loader.add(&DestinationBuffer::load_memory,
       &DestinationBuffer::unload_memory);
-    this->loader.add(&DestinationBuffer::load_command,
-      &DestinationBuffer::unload_command);
+    this->loader.add(&DestinationBuffer::load_data,
+      &DestinationBuffer::unload_data);
 
     try
     {
@@ -33,6 +39,9 @@ namespace BKVK
       throw Loader::Error{
         "Could not initialize Vulkan destination buffer: " + le.message};
     }
+
+    // Data belongs to the caller.
+    this->data = nullptr;
   }
 
   DestinationBuffer::~DestinationBuffer()
@@ -40,45 +49,21 @@ namespace BKVK
     this->loader.unload();
   }
 
-  void DestinationBuffer::load_command()
+  void DestinationBuffer::load_data()
   {
-    std::shared_ptr<CommandPool> command_pool;
-    std::shared_ptr<Queue> transfer_queue;
-
-    command_pool = std::make_shared<CommandPool>(this->queue_family, 1);
-    transfer_queue = this->queue_family->get_queue();
-    this->vk_command_buffer = command_pool->get_vk_command_buffers()[0];
-
-    VkCommandBufferBeginInfo begin_info = {};
-    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    VkBufferCopy copy_region = {};
-    copy_region.srcOffset = 0;
-    copy_region.dstOffset = 0;
-    copy_region.size = this->vk_device_size;
-
-    vkBeginCommandBuffer(this->vk_command_buffer, &begin_info);
-
-    vkCmdCopyBuffer(
-        this->vk_command_buffer, this->source_buffer->get_vk_buffer(),
-        this->vk_buffer, 1, &copy_region);
-
-    vkEndCommandBuffer(this->vk_command_buffer);
-
-    VkSubmitInfo submit_info = {};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &this->vk_command_buffer;
-
-    vkQueueSubmit(transfer_queue->get_vk_queue(), 1, &submit_info,
-                  VK_NULL_HANDLE);
-
-    vkQueueWaitIdle(transfer_queue->get_vk_queue());
+    // Memory is only mapped if it got the preferred host-visible flags.
+    if(this->memory_allocation.mapped)
+      memcpy(this->memory_allocation.mapped, this->data,
+             this->vk_device_size);
+    else
+      this->staging_ring->copy_to_buffer(
+          this->vk_buffer, 0, this->data, this->vk_device_size);
   }
 
-  void DestinationBuffer::unload_command()
+  void DestinationBuffer::unload_data()
   {
+    // The buffer can not be destroyed while a copy into it is still pending.
+    if(!this->memory_allocation.mapped) this->staging_ring->wait_idle();
   }
 
 }
@@ -4,9 +4,7 @@
 
 #include "loader.hpp"
 #include "vk_base_buffer.hpp"
-#include "vk_command_pool.hpp"
-#include "vk_queue.hpp"
-#include "vk_source_buffer.hpp"
+#include "vk_staging_ring.hpp"
 
 namespace BKVK
 {
@@ -20,21 +18,23 @@ namespace BKVK
     DestinationBuffer& operator=(const DestinationBuffer &&t) = delete;
 
    public:
+    // The data is copied during construction, it does not need to stay
+    // alive after the constructor returns. When the device allows it, the
+    // data is written straight into the buffer without the staging ring.
     explicit DestinationBuffer(
-        const std::shared_ptr<QueueFamily> &queue_family,
-        const std::shared_ptr<SourceBuffer> &source_buffer,
+        const std::shared_ptr<StagingRing> &staging_ring,
+        const void *data, size_t data_size,
         VkBufferUsageFlags vk_buffer_usage);
     ~DestinationBuffer();
 
    private:
     Loader::Stack<DestinationBuffer> loader;
 
-    std::shared_ptr<QueueFamily> queue_family;
-    std::shared_ptr<SourceBuffer> source_buffer;
-    VkCommandBuffer vk_command_buffer;
+    std::shared_ptr<StagingRing> staging_ring;
+    const void *data;
 
-    void load_command();
-    void unload_command();
+    void load_data();
+    void unload_data();
   };
 }
 
@@ -1,12 +1,34 @@
 // SPDX-License-Identifier: MIT
 #include "vk_device.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 
-#include "ruby.h"
-
 #include "log.hpp"
+#include "shader_spirv.hpp"
+
+namespace
+{
+bool has_device_extension(
+    VkPhysicalDevice vk_physical_device, const char *extension_name)
+{
+  uint32_t extensions_count;
+  vkEnumerateDeviceExtensionProperties(
+      vk_physical_device, nullptr, &extensions_count, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensions_count);
+  vkEnumerateDeviceExtensionProperties(
+      vk_physical_device, nullptr, &extensions_count, extensions.data());
+
+  for(const auto &extension: extensions)
+    if(strcmp(extension.extensionName, extension_name) == 0) return true;
+
+  return false;
+}
+}
 
 namespace BKVK
 {
@@ -25,6 +47,37 @@ Device::Device(const std::shared_ptr<Instance> &instance,
   vkGetPhysicalDeviceProperties(vk_physical_device, &physical_properties);
   VkPhysicalDeviceFeatures supported_features = {};
   vkGetPhysicalDeviceFeatures(vk_physical_device, &supported_features);
+  vkGetPhysicalDeviceMemoryProperties(vk_physical_device,
+                                      &this->vk_memory_properties);
+
+  // Integrated GPUs share memory with the CPU, and resizable BAR exposes all
+  // video memory to it. A small host-visible device-local heap is only the
+  // default 256 MiB BAR window, too little to hold every resource.
+  {
+    const VkMemoryPropertyFlags direct_flags{
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+    VkDeviceSize device_local_heap_size{0};
+    VkDeviceSize direct_heap_size{0};
+    for(uint32_t i{0}; i < this->vk_memory_properties.memoryTypeCount; i++)
+    {
+      const VkMemoryType &type{this->vk_memory_properties.memoryTypes[i]};
+      VkDeviceSize heap_size{
+        this->vk_memory_properties.memoryHeaps[type.heapIndex].size};
+
+      if(type.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+        device_local_heap_size = std::max(device_local_heap_size, heap_size);
+      if((type.propertyFlags & direct_flags) == direct_flags)
+        direct_heap_size = std::max(direct_heap_size, heap_size);
+    }
+
+    VkPhysicalDeviceType device_type{physical_properties.deviceType};
+    bool uma{device_type == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ||
+             device_type == VK_PHYSICAL_DEVICE_TYPE_CPU};
+    this->direct_upload = direct_heap_size > 0 &&
+        (uma || direct_heap_size >= device_local_heap_size);
+  }
 
   // Display physical device information.
   if(this->instance->get_core_data()->debug)
@@ -69,6 +122,10 @@ Device::Device(const std::shared_ptr<Instance> &instance,
 
   // Optional
   required_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+  required_features.textureCompressionBC =
+      supported_features.textureCompressionBC;
+  this->texture_compression_bc =
+      supported_features.textureCompressionBC == VK_TRUE;
 
   // Required
   required_features.geometryShader = VK_TRUE;
@@ -79,9 +136,74 @@ Device::Device(const std::shared_ptr<Instance> &instance,
   if(with_swapchain)
     device_extensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
+  // Descriptor indexing lets every texture live in a single descriptor set.
+  // It is only used when all the features the texture table needs exist.
+  this->descriptor_indexing = false;
+  this->max_bindless_textures = 0;
+  if(this->instance->get_api_version() >= VK_API_VERSION_1_1 &&
+     physical_properties.apiVersion >= VK_API_VERSION_1_1 &&
+     has_device_extension(
+         vk_physical_device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+  {
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features{};
+    indexing_features.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &indexing_features;
+    vkGetPhysicalDeviceFeatures2(vk_physical_device, &features2);
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_properties{};
+    indexing_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &indexing_properties;
+    vkGetPhysicalDeviceProperties2(vk_physical_device, &properties2);
+
+    this->descriptor_indexing =
+        indexing_features.shaderSampledImageArrayNonUniformIndexing &&
+        indexing_features.descriptorBindingSampledImageUpdateAfterBind &&
+        indexing_features.descriptorBindingUpdateUnusedWhilePending &&
+        indexing_features.descriptorBindingPartiallyBound &&
+        indexing_features.runtimeDescriptorArray;
+    this->max_bindless_textures = std::min({
+        this->bindless_textures_limit,
+        indexing_properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+        indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        indexing_properties.maxDescriptorSetUpdateAfterBindSamplers,
+        indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages});
+  }
+
+  // Lets the driver report how much memory the application can use.
+  this->memory_budget =
+      this->instance->get_api_version() >= VK_API_VERSION_1_1 &&
+      physical_properties.apiVersion >= VK_API_VERSION_1_1 &&
+      has_device_extension(
+          vk_physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if(this->memory_budget)
+    device_extensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabled_indexing_features{};
+  enabled_indexing_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  if(this->descriptor_indexing)
+  {
+    enabled_indexing_features.shaderSampledImageArrayNonUniformIndexing =
+        VK_TRUE;
+    enabled_indexing_features.descriptorBindingSampledImageUpdateAfterBind =
+        VK_TRUE;
+    enabled_indexing_features.descriptorBindingUpdateUnusedWhilePending =
+        VK_TRUE;
+    enabled_indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+    enabled_indexing_features.runtimeDescriptorArray = VK_TRUE;
+    device_extensions.emplace_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  }
+
   VkDeviceCreateInfo device_create_info = {};
   device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  device_create_info.pNext = nullptr;
+  device_create_info.pNext =
+      this->descriptor_indexing ? &enabled_indexing_features : nullptr;
   device_create_info.flags = 0;
   device_create_info.queueCreateInfoCount = device_queue_create_infos.size();
   device_create_info.pQueueCreateInfos = device_queue_create_infos.data();
@@ -99,7 +221,14 @@ Device::Device(const std::shared_ptr<Instance> &instance,
                     &this->vk_device) != VK_SUCCESS)
     throw Loader::Error{"Vulkan device could not be created."};
 
-  this->loader.add(&Device::load_vk_shaders, &Device::unload_vk_shaders);
+  this->loader.add(&Device::load_memory_allocator,
+                   &Device::unload_memory_allocator);
+  this->loader.add(&Device::load_descriptor_allocator,
+                   &Device::unload_descriptor_allocator);
+  this->loader.add(&Device::load_pipeline_cache,
+                   &Device::unload_pipeline_cache);
+  this->loader.add(&Device::load_vk_shader_modules,
+                   &Device::unload_vk_shader_modules);
 
   this->loader.load();
 }
@@ -112,90 +241,249 @@ Device::~Device()
   vkDestroyDevice(this->vk_device, nullptr);
 }
 
-void Device::load_vk_shaders()
+void Device::load_memory_allocator()
 {
-  const ID id_gem = rb_intern("Gem");
-  const ID id_datadir = rb_intern("datadir");
+  this->memory_allocator = std::make_unique<MemoryAllocator>(
+      this->vk_device, this->vk_memory_properties);
+}
 
-  VALUE gem_class;
-  VALUE blue_kitty_str;
-  VALUE path;
+void Device::unload_memory_allocator()
+{
+  this->memory_allocator = nullptr;
+}
 
-  blue_kitty_str = rb_str_new2("blue_kitty");
-  gem_class = rb_const_get(rb_cObject, id_gem);
+void Device::load_descriptor_allocator()
+{
+  this->descriptor_allocator =
+      std::make_unique<DescriptorAllocator>(this->vk_device);
+}
 
-  path = rb_funcall(gem_class, id_datadir, 1, blue_kitty_str);
+void Device::unload_descriptor_allocator()
+{
+  this->descriptor_allocator = nullptr;
+}
 
-  char *datadir = StringValueCStr(path);
+void Device::load_pipeline_cache()
+{
+  std::vector<char> data;
+  std::string path{this->pipeline_cache_path()};
+  if(!path.empty())
+  {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if(file.is_open())
+    {
+      data.resize(static_cast<size_t>(file.tellg()));
+      file.seekg(0);
+      file.read(data.data(), data.size());
+      if(!file) data.clear();
+    }
+  }
 
-  std::string vert_path = datadir;
-  vert_path += "/GLSL/vert.spv";
-  std::string frag_path = datadir;
-  frag_path += "/GLSL/frag.spv";
+  // A cache from another driver or GPU must not reach the driver; some
+  // drivers crash instead of ignoring it.
+  if(!data.empty())
+  {
+    VkPhysicalDeviceProperties physical_properties{};
+    vkGetPhysicalDeviceProperties(
+        this->vk_physical_device, &physical_properties);
 
-  this->vk_vert_shader_module = create_shader_module(vert_path);
-  this->vk_frag_shader_module = create_shader_module(frag_path);
+    VkPipelineCacheHeaderVersionOne header{};
+    bool valid{data.size() >= sizeof(header)};
+    if(valid)
+    {
+      std::memcpy(&header, data.data(), sizeof(header));
+      valid = header.headerSize >= sizeof(header) &&
+          header.headerSize <= data.size() &&
+          header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+          header.vendorID == physical_properties.vendorID &&
+          header.deviceID == physical_properties.deviceID &&
+          std::memcmp(header.pipelineCacheUUID,
+                      physical_properties.pipelineCacheUUID,
+                      VK_UUID_SIZE) == 0;
+    }
 
-  rb_gc_mark(blue_kitty_str);
-  rb_gc_mark(path);
+    if(!valid)
+    {
+      if(this->instance->get_core_data()->debug)
+        BKGE::Log::standard("Pipeline cache file is not for this device.");
+      data.clear();
+    }
+  }
+
+  VkPipelineCacheCreateInfo cache_info{};
+  cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cache_info.pNext = nullptr;
+  cache_info.flags = 0;
+  cache_info.initialDataSize = data.size();
+  cache_info.pInitialData = data.empty() ? nullptr : data.data();
+
+  if(vkCreatePipelineCache(this->vk_device, &cache_info, nullptr,
+                           &this->vk_pipeline_cache) != VK_SUCCESS)
+    throw Loader::Error{"Failed to create Vulkan pipeline cache."};
+
+  this->pipeline_cache_loaded_size = data.size();
 }
 
-void Device::unload_vk_shaders()
+void Device::unload_pipeline_cache()
 {
-  vkDestroyShaderModule(this->vk_device, this->vk_vert_shader_module, nullptr);
-  vkDestroyShaderModule(this->vk_device, this->vk_frag_shader_module, nullptr);
+  // A failure to save only makes the next start slower.
+  std::string path{this->pipeline_cache_path()};
+  size_t size{0};
+  if(!path.empty() &&
+     vkGetPipelineCacheData(this->vk_device, this->vk_pipeline_cache, &size,
+                            nullptr) == VK_SUCCESS && size > 0)
+  {
+    std::vector<char> data(size);
+    if(vkGetPipelineCacheData(this->vk_device, this->vk_pipeline_cache, &size,
+                              data.data()) == VK_SUCCESS)
+    {
+      // Write a new file and rename it, so a crash never leaves half a cache.
+      std::string temporary_path{path + ".tmp"};
+      std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+      file.write(data.data(), size);
+      file.close();
+      if(file) std::rename(temporary_path.c_str(), path.c_str());
+      else std::remove(temporary_path.c_str());
+    }
+  }
+
+  vkDestroyPipelineCache(this->vk_device, this->vk_pipeline_cache, nullptr);
 }
 
-VkShaderModule Device::create_shader_module(
-    const std::string& filename)
+std::string Device::pipeline_cache_path() const
 {
-  std::ifstream file(filename, std::ios::ate | std::ios::binary);
+  char *pref_path{SDL_GetPrefPath(
+      "blue_kitty", this->instance->get_core_data()->game_name)};
+  if(!pref_path) return "";
 
-  if (!file.is_open())
-  {
-    throw Loader::Error{"Failed to open shader module file."};
-  }
+  // One file for each GPU, a computer may have more than one.
+  VkPhysicalDeviceProperties physical_properties{};
+  vkGetPhysicalDeviceProperties(this->vk_physical_device, &physical_properties);
 
-  size_t file_size = (size_t) file.tellg();
-  std::vector<char> code(file_size);
+  std::ostringstream path;
+  path << pref_path << "pipeline_cache_" << std::hex << std::setfill('0') <<
+      std::setw(4) << physical_properties.vendorID << "_" <<
+      std::setw(4) << physical_properties.deviceID << ".bin";
+  SDL_free(pref_path);
 
-  file.seekg(0);
-  file.read(code.data(), file_size);
+  return path.str();
+}
 
-  file.close();
+void Device::load_vk_shader_modules()
+{
+  this->vk_shader_modules.fill(VK_NULL_HANDLE);
+}
 
+void Device::unload_vk_shader_modules()
+{
+  for(auto vk_shader_module: this->vk_shader_modules)
+    if(vk_shader_module != VK_NULL_HANDLE)
+      vkDestroyShaderModule(this->vk_device, vk_shader_module, nullptr);
+}
+
+VkShaderModule Device::get_vk_shader_module(Shader shader)
+{
+  std::unique_lock<std::mutex> lock{this->shader_modules_mutex};
+  VkShaderModule &vk_shader_module{
+    this->vk_shader_modules[static_cast<size_t>(shader)]};
+  if(vk_shader_module != VK_NULL_HANDLE) return vk_shader_module;
+
+  switch(shader)
+  {
+    case Shader::model_vert:
+      vk_shader_module = this->create_shader_module(
+          SPIRV::model_vert, sizeof(SPIRV::model_vert));
+      break;
+    case Shader::model_frag:
+      vk_shader_module = this->create_shader_module(
+          SPIRV::model_frag, sizeof(SPIRV::model_frag));
+      break;
+    case Shader::model_frag_bindless:
+      vk_shader_module = this->create_shader_module(
+          SPIRV::model_frag_bindless, sizeof(SPIRV::model_frag_bindless));
+      break;
+    case Shader::depth_pyramid_comp:
+      vk_shader_module = this->create_shader_module(
+          SPIRV::depth_pyramid_comp, sizeof(SPIRV::depth_pyramid_comp));
+      break;
+    case Shader::count:
+      break;
+  }
+
+  return vk_shader_module;
+}
+
+VkShaderModule Device::create_shader_module(const uint32_t *code, size_t size)
+{
   VkShaderModuleCreateInfo create_info = {};
   create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  create_info.codeSize = code.size();
-  create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+  create_info.codeSize = size;
+  create_info.pCode = code;
 
   VkShaderModule shader_module;
   if (vkCreateShaderModule(this->vk_device, &create_info, nullptr,
                            &shader_module) != VK_SUCCESS)
+    throw Loader::Error{"Failed to create shader module."};
+
+  return shader_module;
+}
+
+std::array<MemoryHeapBudget, VK_MAX_MEMORY_HEAPS>
+Device::get_memory_budgets() const
+{
+  const auto &heap_stats{this->memory_allocator->get_heap_stats()};
+  std::array<MemoryHeapBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+
+  if(this->memory_budget)
   {
-    throw std::runtime_error("Failed to create shader module.");
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+    budget_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memory_properties2{};
+    memory_properties2.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memory_properties2.pNext = &budget_properties;
+    vkGetPhysicalDeviceMemoryProperties2(
+        this->vk_physical_device, &memory_properties2);
+
+    for(uint32_t i{0}; i < this->vk_memory_properties.memoryHeapCount; i++)
+    {
+      budgets[i].budget = budget_properties.heapBudget[i];
+      budgets[i].usage = budget_properties.heapUsage[i];
+    }
   }
+  // Without the extension the best guess is the whole heap for this
+  // application and only the memory it allocated itself.
+  else
+    for(uint32_t i{0}; i < this->vk_memory_properties.memoryHeapCount; i++)
+    {
+      budgets[i].budget = this->vk_memory_properties.memoryHeaps[i].size;
+      budgets[i].usage = heap_stats[i].reserved_bytes;
+    }
 
-  return shader_module;
+  return budgets;
 }
 
 uint32_t Device::select_memory_type(
     VkMemoryRequirements vk_memory_requirements,
-    VkMemoryPropertyFlags vk_property_flags)
+    VkMemoryPropertyFlags vk_property_flags,
+    VkMemoryPropertyFlags vk_preferred_flags)
 {
-  VkPhysicalDeviceMemoryProperties vk_memory_properties;
-  vkGetPhysicalDeviceMemoryProperties(this->vk_physical_device,
-                                      &vk_memory_properties);
-
-  for (uint32_t memory_type = 0;
-       memory_type < vk_memory_properties.memoryTypeCount; memory_type++)
+  for(VkMemoryPropertyFlags flags:
+        {vk_property_flags | vk_preferred_flags, vk_property_flags})
   {
-    if (vk_memory_requirements.memoryTypeBits & (1 << memory_type))
+    for (uint32_t memory_type = 0;
+         memory_type < this->vk_memory_properties.memoryTypeCount;
+         memory_type++)
     {
-      const VkMemoryType& type = vk_memory_properties.memoryTypes[memory_type];
-
-      if ((type.propertyFlags & vk_property_flags) == vk_property_flags)
-        return memory_type;
+      if (vk_memory_requirements.memoryTypeBits & (1 << memory_type))
+      {
+        const VkMemoryType& type =
+            this->vk_memory_properties.memoryTypes[memory_type];
+
+        if ((type.propertyFlags & flags) == flags)
+          return memory_type;
+      }
     }
   }
 
@@ -2,16 +2,38 @@
 #ifndef BLUE_KITTY_VK_DEVICE_HPP
 #define BLUE_KITTY_VK_DEVICE_HPP 1
 
+#include <array>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include <vulkan/vulkan.h>
 
 #include "loader.hpp"
+#include "vk_descriptor_allocator.hpp"
 #include "vk_instance.hpp"
+#include "vk_memory_allocator.hpp"
 
 namespace BKVK
 {
+// Shaders embedded in the extension, see shader_spirv.hpp.
+enum class Shader: uint8_t
+{
+  model_vert,
+  model_frag,
+  model_frag_bindless,
+  depth_pyramid_comp,
+  count
+};
+
+struct MemoryHeapBudget
+{
+  // How much memory the application may use without hurting performance.
+  VkDeviceSize budget;
+  VkDeviceSize usage;
+};
+
 class Device
 {
   friend Loader::Stack<Device>;
@@ -34,29 +56,84 @@ class Device
   inline VkDevice get_vk_device() const { return this->vk_device; };
   inline VkPhysicalDevice get_vk_physical_device() const
   { return this->vk_physical_device; };
-  inline VkShaderModule get_vk_vert_shader_module() const
-  { return this->vk_vert_shader_module; };
-  inline VkShaderModule get_vk_frag_shader_module() const
-  { return this->vk_frag_shader_module; };
+  inline MemoryAllocator *get_memory_allocator() const
+  { return this->memory_allocator.get(); };
+  inline DescriptorAllocator *get_descriptor_allocator() const
+  { return this->descriptor_allocator.get(); };
+  inline VkPipelineCache get_vk_pipeline_cache() const
+  { return this->vk_pipeline_cache; };
+  // Size of the cache data read from disk, zero when the cache started empty.
+  inline size_t get_pipeline_cache_loaded_size() const
+  { return this->pipeline_cache_loaded_size; };
+  inline const VkPhysicalDeviceMemoryProperties &get_memory_properties() const
+  { return this->vk_memory_properties; };
+  // True when the CPU can write device-local memory directly, so uploads do
+  // not need a staging copy.
+  inline bool get_direct_upload() const { return this->direct_upload; };
+  // True when the budget comes from VK_EXT_memory_budget, not an estimate.
+  inline bool get_memory_budget() const { return this->memory_budget; };
+  inline bool get_texture_compression_bc() const
+  { return this->texture_compression_bc; };
+  inline bool get_descriptor_indexing() const
+  { return this->descriptor_indexing; };
+  inline uint32_t get_max_bindless_textures() const
+  { return this->max_bindless_textures; };
+
+  // One entry for each memory heap, the others are zero. Not a vector, so
+  // the budget can be checked every frame without allocating.
+  std::array<MemoryHeapBudget, VK_MAX_MEMORY_HEAPS> get_memory_budgets() const;
 
+  // Create the module the first time a pipeline needs it, so devices that
+  // never render do not create any. Safe to call from several threads.
+  VkShaderModule get_vk_shader_module(Shader shader);
+
+  // Prefer a memory type that also has the "preferred" flags, but accept one
+  // that only has the required ones.
   uint32_t select_memory_type(VkMemoryRequirements vk_memory_requirements,
-                              VkMemoryPropertyFlags vk_property_flags);
+                              VkMemoryPropertyFlags vk_property_flags,
+                              VkMemoryPropertyFlags vk_preferred_flags = 0);
 
  private:
   std::shared_ptr<Instance> instance;
   VkDevice vk_device;
   VkPhysicalDevice vk_physical_device;
-  VkShaderModule vk_vert_shader_module;
-  VkShaderModule vk_frag_shader_module;
+  VkPipelineCache vk_pipeline_cache;
+  size_t pipeline_cache_loaded_size;
+  std::mutex shader_modules_mutex;
+  std::array<VkShaderModule, static_cast<size_t>(Shader::count)>
+  vk_shader_modules;
 
   Loader::Stack<Device> loader;
 
+  std::unique_ptr<MemoryAllocator> memory_allocator;
+  std::unique_ptr<DescriptorAllocator> descriptor_allocator;
+
   bool with_swapchain;
+  VkPhysicalDeviceMemoryProperties vk_memory_properties;
+  bool direct_upload;
+  bool memory_budget;
+  bool texture_compression_bc;
+  bool descriptor_indexing;
+  uint32_t max_bindless_textures;
+
+  // Size of the texture table when the device allows more.
+  const uint32_t bindless_textures_limit = 4096;
+
+  void load_memory_allocator();
+  void unload_memory_allocator();
+
+  void load_descriptor_allocator();
+  void unload_descriptor_allocator();
+
+  void load_pipeline_cache();
+  void unload_pipeline_cache();
 
-  void load_vk_shaders();
-  void unload_vk_shaders();
+  void load_vk_shader_modules();
+  void unload_vk_shader_modules();
 
-  VkShaderModule create_shader_module(const std::string& filename);
+  // Empty when SDL can not tell where user files go.
+  std::string pipeline_cache_path() const;
+  VkShaderModule create_shader_module(const uint32_t *code, size_t size);
 
 };
 }
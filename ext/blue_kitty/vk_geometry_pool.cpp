@@ -0,0 +1,395 @@
+// SPDX-License-Identifier: MIT
+#include "vk_geometry_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace BKVK
+{
+// A device-local buffer that only the pool writes into.
+class GeometryPool::PageBuffer: public BaseBuffer
+{
+  friend class Loader::Stack<PageBuffer>;
+
+ public:
+  PageBuffer(const std::shared_ptr<Device> &device, VkDeviceSize size,
+             VkBufferUsageFlags vk_buffer_usage);
+  ~PageBuffer();
+
+  inline uint8_t *get_mapped() const { return this->memory_allocation.mapped; };
+
+ private:
+  Loader::Stack<PageBuffer> loader;
+};
+
+GeometryPool::PageBuffer::PageBuffer(
+    const std::shared_ptr<Device> &device, VkDeviceSize size,
+    VkBufferUsageFlags vk_buffer_usage):
+    loader{this}
+{
+  this->device = device;
+  this->vk_device_size = size;
+  // Compaction copies ranges from one buffer to another.
+  this->vk_buffer_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | vk_buffer_usage;
+  this->vk_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  if(this->device->get_direct_upload())
+    this->vk_preferred_memory_properties =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  this->loader.add(&PageBuffer::load_buffer, &PageBuffer::unload_buffer);
+  this->loader.add(&PageBuffer::load_memory, &PageBuffer::unload_memory);
+
+  try
+  {
+    this->loader.load();
+  }
+  catch(Loader::Error le)
+  {
+    throw Loader::Error{"Could not initialize geometry pool buffer → " +
+          le.message};
+  }
+}
+
+GeometryPool::PageBuffer::~PageBuffer()
+{
+  this->loader.unload();
+}
+
+GeometryPool::FreeList::FreeList(uint32_t capacity):
+    capacity{capacity},
+    free{capacity}
+{
+  if(capacity > 0) this->parts[0] = capacity;
+}
+
+bool GeometryPool::FreeList::allocate(uint32_t count, uint32_t *offset)
+{
+  if(count == 0)
+  {
+    *offset = 0;
+    return true;
+  }
+
+  // Best fit keeps big parts available for big geometries.
+  auto best{this->parts.end()};
+  for(auto part{this->parts.begin()}; part != this->parts.end(); part++)
+    if(part->second >= count &&
+       (best == this->parts.end() || part->second < best->second))
+      best = part;
+  if(best == this->parts.end()) return false;
+
+  *offset = best->first;
+  uint32_t remaining{best->second - count};
+  this->parts.erase(best);
+  if(remaining > 0) this->parts[*offset + count] = remaining;
+  this->free -= count;
+
+  return true;
+}
+
+void GeometryPool::FreeList::release(uint32_t offset, uint32_t count)
+{
+  if(count == 0) return;
+
+  this->free += count;
+  auto next{this->parts.lower_bound(offset)};
+
+  // Merge with the part after it.
+  if(next != this->parts.end() && offset + count == next->first)
+  {
+    count += next->second;
+    next = this->parts.erase(next);
+  }
+
+  // Merge with the part before it.
+  if(next != this->parts.begin())
+  {
+    auto previous{std::prev(next)};
+    if(previous->first + previous->second == offset)
+    {
+      previous->second += count;
+      return;
+    }
+  }
+
+  this->parts[offset] = count;
+}
+
+GeometryPool::Page::Page(uint32_t vertex_capacity, uint32_t index_capacity):
+    vertexes{vertex_capacity},
+    indexes{index_capacity},
+    fragmented{false}
+{
+}
+
+GeometryPool::GeometryPool(
+    const std::shared_ptr<StagingRing> &staging_ring, VkDeviceSize vertex_size,
+    VkIndexType vk_index_type, uint32_t vertexes_per_page,
+    uint32_t indexes_per_page):
+    staging_ring{staging_ring},
+    vertex_size{vertex_size},
+    index_size{vk_index_type == VK_INDEX_TYPE_UINT16 ? 2u : 4u},
+    vk_index_type{vk_index_type},
+    vertexes_per_page{vertexes_per_page},
+    indexes_per_page{indexes_per_page},
+    pending_ranges(1),
+    current_frame{0}
+{
+}
+
+GeometryPool::~GeometryPool()
+{
+  // Copies into the pages may still be pending.
+  this->staging_ring->wait_idle();
+}
+
+std::shared_ptr<GeometryPool::Range> GeometryPool::add(
+    const void *vertexes, uint32_t vertex_count, const void *indexes,
+    uint32_t index_count)
+{
+  auto range{std::make_shared<Range>()};
+  range->vertex_count = vertex_count;
+  range->index_count = index_count;
+
+  Page *page{nullptr};
+  for(uint32_t i{0}; i < this->pages.size() && !page; i++)
+  {
+    if(!this->pages[i]) continue;
+
+    uint32_t first_vertex, first_index;
+    if(!this->pages[i]->vertexes.allocate(vertex_count, &first_vertex))
+      continue;
+    if(!this->pages[i]->indexes.allocate(index_count, &first_index))
+    {
+      this->pages[i]->vertexes.release(first_vertex, vertex_count);
+      continue;
+    }
+
+    page = this->pages[i].get();
+    range->page = i;
+    range->first_vertex = first_vertex;
+    range->first_index = first_index;
+  }
+
+  // Geometries bigger than a page get a page of their own size.
+  if(!page)
+  {
+    auto new_page{this->create_page(
+        std::max(vertex_count, this->vertexes_per_page),
+        std::max(index_count, this->indexes_per_page))};
+    new_page->vertexes.allocate(vertex_count, &range->first_vertex);
+    new_page->indexes.allocate(index_count, &range->first_index);
+
+    // Reuse the slot of a page that was freed.
+    auto slot{std::find(this->pages.begin(), this->pages.end(), nullptr)};
+    range->page = static_cast<uint32_t>(slot - this->pages.begin());
+    if(slot == this->pages.end())
+      this->pages.push_back(std::move(new_page));
+    else
+      *slot = std::move(new_page);
+    page = this->pages[range->page].get();
+  }
+
+  try
+  {
+    this->write(page->vertex_buffer.get(),
+                range->first_vertex * this->vertex_size, vertexes,
+                vertex_count * this->vertex_size);
+    this->write(page->index_buffer.get(),
+                range->first_index * this->index_size, indexes,
+                index_count * this->index_size);
+  }
+  catch(Loader::Error le)
+  {
+    page->vertexes.release(range->first_vertex, vertex_count);
+    page->indexes.release(range->first_index, index_count);
+    throw;
+  }
+
+  page->ranges.push_back(range);
+  return range;
+}
+
+VkDeviceSize GeometryPool::get_free_bytes() const
+{
+  VkDeviceSize free_bytes{0};
+  for(const auto &page: this->pages)
+    if(page)
+      free_bytes += page->vertexes.get_free() * this->vertex_size +
+        page->indexes.get_free() * this->index_size;
+  for(const auto &ranges: this->pending_ranges)
+    for(const auto &range: ranges)
+      free_bytes += range->vertex_count * this->vertex_size +
+        range->index_count * this->index_size;
+
+  return free_bytes;
+}
+
+void GeometryPool::remove(const std::shared_ptr<Range> &range)
+{
+  this->pending_ranges[this->current_frame].push_back(range);
+}
+
+void GeometryPool::release_frame(uint32_t frame)
+{
+  if(frame >= this->pending_ranges.size())
+    this->pending_ranges.resize(frame + 1);
+
+  for(const auto &range: this->pending_ranges[frame]) this->release(range);
+  this->pending_ranges[frame].clear();
+  this->current_frame = frame;
+}
+
+void GeometryPool::release(const std::shared_ptr<Range> &range)
+{
+  Page *page{this->pages[range->page].get()};
+  page->vertexes.release(range->first_vertex, range->vertex_count);
+  page->indexes.release(range->first_index, range->index_count);
+  page->ranges.erase(
+      std::find(page->ranges.begin(), page->ranges.end(), range));
+
+  // Holes that are not at the end of the buffer can only be used by
+  // geometries that fit in them. Compact when they add up to a quarter of
+  // the page.
+  auto scattered = [](const FreeList &list, uint32_t last_used){
+    return list.get_free() - (list.get_capacity() - last_used);
+  };
+  uint32_t last_vertex{0}, last_index{0};
+  for(const auto &r: page->ranges)
+  {
+    last_vertex = std::max(last_vertex, r->first_vertex + r->vertex_count);
+    last_index = std::max(last_index, r->first_index + r->index_count);
+  }
+  page->fragmented =
+      scattered(page->vertexes, last_vertex) >=
+      page->vertexes.get_capacity() / 4 ||
+      scattered(page->indexes, last_index) >=
+      page->indexes.get_capacity() / 4;
+}
+
+void GeometryPool::bind(VkCommandBuffer vk_command_buffer, uint32_t page) const
+{
+  VkBuffer vertex_buffers[]{this->pages[page]->vertex_buffer->get_vk_buffer()};
+  VkDeviceSize offsets[]{0};
+
+  vkCmdBindVertexBuffers(vk_command_buffer, 0, 1, vertex_buffers, offsets);
+  vkCmdBindIndexBuffer(
+      vk_command_buffer, this->pages[page]->index_buffer->get_vk_buffer(), 0,
+      this->vk_index_type);
+}
+
+void GeometryPool::compact()
+{
+  bool work{false};
+  for(uint32_t i{0}; i < this->pages.size(); i++)
+    if(this->pages[i] &&
+       (this->pages[i]->fragmented ||
+        (i > 0 && this->pages[i]->ranges.empty())))
+      work = true;
+  if(!work) return;
+
+  // Frames in flight may still read the buffers that are replaced.
+  this->staging_ring->wait_idle();
+  vkDeviceWaitIdle(
+      this->staging_ring->get_queue_family()->get_device()->get_vk_device());
+
+  // Nothing draws the removed ranges anymore.
+  for(auto &ranges: this->pending_ranges)
+  {
+    for(const auto &range: ranges) this->release(range);
+    ranges.clear();
+  }
+
+  for(uint32_t i{0}; i < this->pages.size(); i++)
+  {
+    if(!this->pages[i]) continue;
+    Page *page{this->pages[i].get()};
+
+    // The first page stays, so small scenes never create buffers again.
+    if(i > 0 && page->ranges.empty())
+    {
+      this->pages[i] = nullptr;
+      continue;
+    }
+    if(!page->fragmented) continue;
+
+    auto new_page{this->create_page(page->vertexes.get_capacity(),
+                                    page->indexes.get_capacity())};
+
+    std::vector<VkBufferCopy> vertex_copies, index_copies;
+    for(auto &range: page->ranges)
+    {
+      uint32_t first_vertex, first_index;
+      new_page->vertexes.allocate(range->vertex_count, &first_vertex);
+      new_page->indexes.allocate(range->index_count, &first_index);
+
+      if(range->vertex_count > 0)
+        vertex_copies.push_back({
+            range->first_vertex * this->vertex_size,
+            first_vertex * this->vertex_size,
+            range->vertex_count * this->vertex_size});
+      if(range->index_count > 0)
+        index_copies.push_back({
+            range->first_index * this->index_size,
+            first_index * this->index_size,
+            range->index_count * this->index_size});
+
+      range->first_vertex = first_vertex;
+      range->first_index = first_index;
+    }
+
+    this->staging_ring->submit_commands(
+        [&](VkCommandBuffer vk_command_buffer){
+          if(!vertex_copies.empty())
+            vkCmdCopyBuffer(
+                vk_command_buffer, page->vertex_buffer->get_vk_buffer(),
+                new_page->vertex_buffer->get_vk_buffer(),
+                static_cast<uint32_t>(vertex_copies.size()),
+                vertex_copies.data());
+          if(!index_copies.empty())
+            vkCmdCopyBuffer(
+                vk_command_buffer, page->index_buffer->get_vk_buffer(),
+                new_page->index_buffer->get_vk_buffer(),
+                static_cast<uint32_t>(index_copies.size()),
+                index_copies.data());
+        });
+    this->staging_ring->wait_idle();
+
+    new_page->ranges = std::move(page->ranges);
+    this->pages[i] = std::move(new_page);
+  }
+}
+
+std::unique_ptr<GeometryPool::Page> GeometryPool::create_page(
+    uint32_t vertex_capacity, uint32_t index_capacity)
+{
+  std::shared_ptr<Device> device{
+    this->staging_ring->get_queue_family()->get_device()};
+
+  auto page{std::make_unique<Page>(vertex_capacity, index_capacity)};
+  page->vertex_buffer = std::make_unique<PageBuffer>(
+      device, vertex_capacity * this->vertex_size,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  page->index_buffer = std::make_unique<PageBuffer>(
+      device, index_capacity * this->index_size,
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+  return page;
+}
+
+void GeometryPool::write(PageBuffer *buffer, VkDeviceSize offset,
+                         const void *data, VkDeviceSize size)
+{
+  if(size == 0) return;
+
+  // Memory is only mapped if it got the preferred host-visible flags.
+  if(buffer->get_mapped())
+    memcpy(buffer->get_mapped() + offset, data, size);
+  else
+    this->staging_ring->copy_to_buffer(
+        buffer->get_vk_buffer(), offset, data, size);
+}
+
+}
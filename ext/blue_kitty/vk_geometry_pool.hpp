@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VK_GEOMETRY_POOL_HPP
+#define BLUE_KITTY_VK_GEOMETRY_POOL_HPP 1
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "loader.hpp"
+#include "vk_base_buffer.hpp"
+#include "vk_staging_ring.hpp"
+
+namespace BKVK
+{
+/*
+  Vertexes and indexes of every geometry live in a few big device-local
+  buffers (pages), so drawing several models only binds them once. Each
+  geometry gets a range of a page and draws with vertexOffset and firstIndex.
+  Freed ranges leave holes that are merged with their neighbours; a page
+  with too many holes is compacted into new buffers.
+*/
+class GeometryPool
+{
+  GeometryPool(const GeometryPool &t) = delete;
+  GeometryPool& operator=(const GeometryPool &t) = delete;
+  GeometryPool(const GeometryPool &&t) = delete;
+  GeometryPool& operator=(const GeometryPool &&t) = delete;
+
+ public:
+  struct Range
+  {
+    uint32_t page;
+    // In vertexes and indexes, not bytes. Compaction may change them.
+    uint32_t first_vertex, vertex_count;
+    uint32_t first_index, index_count;
+  };
+
+  explicit GeometryPool(const std::shared_ptr<StagingRing> &staging_ring,
+                        VkDeviceSize vertex_size, VkIndexType vk_index_type,
+                        uint32_t vertexes_per_page, uint32_t indexes_per_page);
+  ~GeometryPool();
+
+  inline VkDeviceSize get_vertex_size() const { return this->vertex_size; };
+  inline VkDeviceSize get_index_size() const { return this->index_size; };
+  inline VkIndexType get_vk_index_type() const
+  { return this->vk_index_type; };
+  // Device memory of the pages that no range uses. Removing a range frees
+  // its bytes here, the pages keep their memory until compact() drops them.
+  // Ranges waiting for release_frame count as free.
+  VkDeviceSize get_free_bytes() const;
+
+  // Copy the data into the pool. "indexes" are relative to the first vertex
+  // of the range.
+  std::shared_ptr<Range> add(const void *vertexes, uint32_t vertex_count,
+                             const void *indexes, uint32_t index_count);
+  // Frames in flight may still draw the range, so add() reuses it only
+  // after release_frame for the current frame slot comes around again.
+  void remove(const std::shared_ptr<Range> &range);
+  // Call after waiting for the fence of the frame slot, ranges removed the
+  // last time this slot began are not in use by the GPU anymore.
+  void release_frame(uint32_t frame);
+
+  void bind(VkCommandBuffer vk_command_buffer, uint32_t page) const;
+
+  // Compact pages with too many holes and free the empty ones. Wait for the
+  // device to be idle if there is anything to do, so call it before
+  // recording a frame.
+  void compact();
+
+ private:
+  class PageBuffer;
+
+  // Free parts of a buffer, offset to size, in elements.
+  class FreeList
+  {
+   public:
+    explicit FreeList(uint32_t capacity);
+
+    inline uint32_t get_capacity() const { return this->capacity; };
+    inline uint32_t get_free() const { return this->free; };
+    inline size_t holes() const { return this->parts.size(); };
+
+    // Return false if there is no part big enough.
+    bool allocate(uint32_t count, uint32_t *offset);
+    void release(uint32_t offset, uint32_t count);
+
+   private:
+    uint32_t capacity, free;
+    std::map<uint32_t, uint32_t> parts;
+  };
+
+  struct Page
+  {
+    std::unique_ptr<PageBuffer> vertex_buffer, index_buffer;
+    FreeList vertexes, indexes;
+    std::vector<std::shared_ptr<Range>> ranges;
+    bool fragmented;
+
+    Page(uint32_t vertex_capacity, uint32_t index_capacity);
+  };
+
+  std::shared_ptr<StagingRing> staging_ring;
+  VkDeviceSize vertex_size, index_size;
+  VkIndexType vk_index_type;
+  uint32_t vertexes_per_page, indexes_per_page;
+  std::vector<std::unique_ptr<Page>> pages;
+
+  // Removed ranges, by the frame slot that began before they were removed.
+  std::vector<std::vector<std::shared_ptr<Range>>> pending_ranges;
+  uint32_t current_frame;
+
+  std::unique_ptr<Page> create_page(uint32_t vertex_capacity,
+                                    uint32_t index_capacity);
+  void release(const std::shared_ptr<Range> &range);
+  void write(PageBuffer *buffer, VkDeviceSize offset, const void *data,
+             VkDeviceSize size);
+};
+}
+
+#endif /* BLUE_KITTY_VK_GEOMETRY_POOL_HPP */
@@ -8,6 +8,8 @@
 #include "vk_descriptor_set_view_projection.hpp"
 #include "vk_device.hpp"
 #include "vk_graphic_pipeline_layout.hpp"
+#include "vk_pipeline_registry.hpp"
+#include "vk_storage_buffer.hpp"
 #include "vk_swapchain.hpp"
 #include "vk_uniform_buffer.hpp"
 
@@ -30,17 +32,29 @@ class GraphicPipeline
 
   inline VkRenderPass get_vk_render_pass() const
   { return this->vk_render_pass; };
-  inline VkPipeline get_vk_graphic_pipeline() const
-  { return this->vk_graphic_pipeline; };
+  // Pipelines for every state, all compatible with the render pass.
+  inline PipelineRegistry *get_pipeline_registry() const
+  { return this->pipeline_registry.get(); };
   inline std::shared_ptr<GraphicPipelineLayout>
   get_graphic_pipeline_layout() const
   { return this->graphic_pipeline_layout; };
-  inline std::vector<VkFramebuffer> get_swapchain_framebuffers() const
+  inline const std::vector<VkFramebuffer> &get_swapchain_framebuffers() const
   { return this->swapchain_framebuffers; };
+  // In VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL after the render pass.
+  inline VkImageView get_vk_depth_image_view() const
+  { return this->vk_depth_image_view; };
   inline std::shared_ptr<DS::ViewProjection> get_ds_view_projection() const
   { return this->ds_view_projection; };
-  inline std::vector<std::shared_ptr<UniformBuffer>>
-  get_ub_view_projection() const { return this->ub_view_projection; };
+  inline const std::vector<std::shared_ptr<UniformBuffer>>
+  &get_ub_view_projection() const { return this->ub_view_projection; };
+  // Model matrices of the instances drawn in a frame, one buffer for each
+  // swapchain image.
+  inline const std::vector<std::shared_ptr<StorageBuffer>>
+  &get_sb_instances() const { return this->sb_instances; };
+
+  // Make room for the instances of a frame. Growing waits for the device to
+  // be idle, so capacity doubles to make it rare.
+  void reserve_instances(uint32_t instance_count);
 
  private:
   std::shared_ptr<Device> device;
@@ -48,9 +62,19 @@ class GraphicPipeline
   std::shared_ptr<GraphicPipelineLayout> graphic_pipeline_layout;
   std::vector<VkFramebuffer> swapchain_framebuffers;
   std::vector<std::shared_ptr<UniformBuffer>> ub_view_projection;
+  std::vector<std::shared_ptr<StorageBuffer>> sb_instances;
+  uint32_t instance_capacity;
+
+  // A single depth image is enough, the render pass dependencies keep frames
+  // from writing it at the same time and the depth pyramid from reading it
+  // while it is written.
+  VkFormat vk_depth_format;
+  VkImage vk_depth_image;
+  MemoryAllocation depth_memory_allocation;
+  VkImageView vk_depth_image_view;
 
   VkRenderPass vk_render_pass;
-  VkPipeline vk_graphic_pipeline;
+  std::unique_ptr<PipelineRegistry> pipeline_registry;
 
   Loader::Stack<GraphicPipeline> loader;
   std::shared_ptr<DS::ViewProjection> ds_view_projection;
@@ -58,17 +82,23 @@ class GraphicPipeline
   void load_uniform_buffers();
   void unload_uniform_buffers();
 
+  void load_instance_buffers();
+  void unload_instance_buffers();
+
   void load_descriptor_sets();
   void unload_descriptor_sets();
 
+  void load_depth_image();
+  void unload_depth_image();
+
   void load_render_pass();
   void unload_render_pass();
 
   void load_framebuffer();
   void unload_framebuffer();
 
-  void load_pipeline();
-  void unload_pipeline();
+  void load_pipeline_registry();
+  void unload_pipeline_registry();
 };
 }
 
@@ -1,17 +1,19 @@
 // SPDX-License-Identifier: MIT
 #include "vk_graphic_pipeline_layout.hpp"
 
-#include <array>
+#include <vector>
 
 namespace BKVK
 {
 GraphicPipelineLayout::GraphicPipelineLayout(
       const std::shared_ptr<BKVK::DSL::ModelInstance> &dsl_model_instance,
-      const std::shared_ptr<BKVK::DSL::ViewProjection> &dsl_view_projection):
+      const std::shared_ptr<BKVK::DSL::ViewProjection> &dsl_view_projection,
+      const std::shared_ptr<BKVK::TextureTable> &texture_table):
     loader{this},
     device{dsl_view_projection->get_device()},
     dsl_model_instance{dsl_model_instance},
-    dsl_view_projection{dsl_view_projection}
+    dsl_view_projection{dsl_view_projection},
+    texture_table{texture_table}
 {
   this->loader.add(&GraphicPipelineLayout::load_pipeline_layout,
                    &GraphicPipelineLayout::unload_pipeline_layout);
@@ -36,16 +38,24 @@ GraphicPipelineLayout::~GraphicPipelineLayout()
 
 void GraphicPipelineLayout::load_pipeline_layout()
 {
-  std::array<VkDescriptorSetLayout, 2> set_layouts{
+  std::vector<VkDescriptorSetLayout> set_layouts{
     this->dsl_model_instance->get_vk_descriptor_set_layout(),
     this->dsl_view_projection->get_vk_descriptor_set_layout()};
+  if(this->texture_table)
+    set_layouts.push_back(
+        this->texture_table->get_vk_descriptor_set_layout());
+
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(DrawConstants);
 
   VkPipelineLayoutCreateInfo pipeline_layout_info{};
   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipeline_layout_info.setLayoutCount = set_layouts.size();
   pipeline_layout_info.pSetLayouts = set_layouts.data();
-  pipeline_layout_info.pushConstantRangeCount = 0;
-  pipeline_layout_info.pPushConstantRanges = nullptr;
+  pipeline_layout_info.pushConstantRangeCount = 1;
+  pipeline_layout_info.pPushConstantRanges = &push_constant_range;
 
   if(vkCreatePipelineLayout(
          this->device->get_vk_device(), &pipeline_layout_info, nullptr,
@@ -4,11 +4,32 @@
 
 #include <memory>
 
+#include <glm/glm.hpp>
+
 #include "vk_descriptor_set_layout_model_instance.hpp"
 #include "vk_descriptor_set_layout_view_projection.hpp"
+#include "vk_texture_table.hpp"
 
 namespace BKVK
 {
+// Data sent with each draw as push constants, shared by every instance of a
+// mesh. Changing it does not bind descriptor sets. Members follow the std430
+// layout of the shaders: vectors first, scalars after them.
+struct DrawConstants
+{
+  glm::vec4 color;
+  // Quantized positions are scaled and then offset to model space. Float
+  // positions use a scale of one and no offset.
+  glm::vec4 position_scale;
+  glm::vec4 position_offset;
+  // Order of the draw in the frame.
+  uint32_t draw_id;
+  // Added to gl_InstanceIndex to find the data of an instance.
+  uint32_t instance_base;
+  // Slot of the texture in the texture table.
+  uint32_t texture_index;
+};
+
 class GraphicPipelineLayout
 {
   friend class Loader::Stack<GraphicPipelineLayout>;
@@ -21,7 +42,8 @@ class GraphicPipelineLayout
  public:
   explicit GraphicPipelineLayout(
       const std::shared_ptr<BKVK::DSL::ModelInstance> &dsl_model_instance,
-      const std::shared_ptr<BKVK::DSL::ViewProjection> &dsl_view_projection);
+      const std::shared_ptr<BKVK::DSL::ViewProjection> &dsl_view_projection,
+      const std::shared_ptr<BKVK::TextureTable> &texture_table);
 
   ~GraphicPipelineLayout();
 
@@ -31,6 +53,9 @@ class GraphicPipelineLayout
   { return this->dsl_model_instance; };
   inline std::shared_ptr<DSL::ViewProjection> get_dsl_view_projection() const
   { return this->dsl_view_projection; };
+  // Null when textures are bound per model instance.
+  inline std::shared_ptr<TextureTable> get_texture_table() const
+  { return this->texture_table; };
 
  private:
   Loader::Stack<GraphicPipelineLayout> loader;
@@ -40,6 +65,7 @@ class GraphicPipelineLayout
   std::shared_ptr<Device> device;
   std::shared_ptr<BKVK::DSL::ModelInstance> dsl_model_instance;
   std::shared_ptr<BKVK::DSL::ViewProjection> dsl_view_projection;
+  std::shared_ptr<BKVK::TextureTable> texture_table;
 
   void load_pipeline_layout();
   void unload_pipeline_layout();
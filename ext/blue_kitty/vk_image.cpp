@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: MIT
 #include "vk_image.hpp"
 
+#include <stdexcept>
+
 namespace BKVK::Image
 {
 Error::Error()
@@ -20,7 +22,7 @@ Error::Error(const char &m):
 void create(
     std::shared_ptr<Device> device,
     VkImage *vk_image,
-    VkDeviceMemory *vk_image_memory,
+    MemoryAllocation *memory_allocation,
     VkFormat vk_format,
     const VkExtent3D &vk_extent3d,
     uint32_t mip_levels,
@@ -53,20 +55,28 @@ void create(
   vkGetImageMemoryRequirements(device->get_vk_device(), *vk_image,
                                &vk_memory_requirements);
 
-  VkMemoryAllocateInfo memory_alloc_info{};
-  memory_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  memory_alloc_info.allocationSize = vk_memory_requirements.size;
-  memory_alloc_info.memoryTypeIndex = device->select_memory_type(
-      vk_memory_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  if(vkAllocateMemory(device->get_vk_device(), &memory_alloc_info, nullptr,
-                      vk_image_memory) != VK_SUCCESS)
+  try
+  {
+    *memory_allocation = device->get_memory_allocator()->allocate(
+        vk_memory_requirements,
+        device->select_memory_type(
+            vk_memory_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+        vk_image_tiling == VK_IMAGE_TILING_LINEAR);
+  }
+  catch(Loader::Error le)
   {
     vkDestroyImage(device->get_vk_device(), *vk_image, nullptr);
-    throw Error{"Failed to allocate memory for Vulkan image."};
+    throw Error{"Failed to allocate memory for Vulkan image → " + le.message};
+  }
+  catch(const std::runtime_error &error)
+  {
+    vkDestroyImage(device->get_vk_device(), *vk_image, nullptr);
+    throw Error{error.what()};
   }
 
-  vkBindImageMemory(device->get_vk_device(), *vk_image, *vk_image_memory, 0);
+  vkBindImageMemory(device->get_vk_device(), *vk_image,
+                    memory_allocation->vk_device_memory,
+                    memory_allocation->offset);
 }
 
 void create_view(
@@ -74,7 +84,9 @@ void create_view(
     VkImageView *vk_image_view,
     const VkImage &vk_image,
     VkFormat vk_format,
-    VkImageAspectFlags vk_image_aspect_flags)
+    VkImageAspectFlags vk_image_aspect_flags,
+    uint32_t mip_levels,
+    uint32_t base_mip_level)
 {
   VkImageViewCreateInfo image_view_info{};
   image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -88,8 +100,8 @@ void create_view(
   image_view_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
   image_view_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
   image_view_info.subresourceRange.aspectMask = vk_image_aspect_flags;
-  image_view_info.subresourceRange.baseMipLevel = 0;
-  image_view_info.subresourceRange.levelCount = 1;
+  image_view_info.subresourceRange.baseMipLevel = base_mip_level;
+  image_view_info.subresourceRange.levelCount = mip_levels;
   image_view_info.subresourceRange.baseArrayLayer = 0;
   image_view_info.subresourceRange.layerCount = 1;
 
@@ -21,7 +21,7 @@ class Error
 void create(
     std::shared_ptr<Device> device,
     VkImage *vk_image,
-    VkDeviceMemory *vk_image_memory,
+    MemoryAllocation *memory_allocation,
     VkFormat vk_format,
     const VkExtent3D &vk_extent3d,
     uint32_t mip_levels,
@@ -33,7 +33,9 @@ void create_view(
     VkImageView *vk_image_view,
     const VkImage &vk_image,
     VkFormat vk_format,
-    VkImageAspectFlags vk_image_aspect_flags);
+    VkImageAspectFlags vk_image_aspect_flags,
+    uint32_t mip_levels,
+    uint32_t base_mip_level = 0);
 }
 
 #endif /* BLUE_KITTY_VK_IMAGE_HPP */
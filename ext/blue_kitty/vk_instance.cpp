@@ -75,7 +75,20 @@ void Instance::load_vk_instance()
       FIX2INT(rb_ivar_get(bk_m, rb_intern("@@VERSION_MAJOR"))),
       FIX2INT(rb_ivar_get(bk_m, rb_intern("@@VERSION_MINOR"))),
       FIX2INT(rb_ivar_get(bk_m, rb_intern("@@VERSION_PATCH"))));
-  app_info.apiVersion = VK_API_VERSION_1_0;
+  // Vulkan 1.1 is needed to query optional device features, like descriptor
+  // indexing. Loaders older than 1.1 do not have vkEnumerateInstanceVersion.
+  {
+    auto enumerate_instance_version{
+      reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+          vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"))};
+    uint32_t loader_version{VK_API_VERSION_1_0};
+    if(enumerate_instance_version != nullptr)
+      enumerate_instance_version(&loader_version);
+
+    this->api_version = loader_version >= VK_API_VERSION_1_1 ?
+        VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
+  }
+  app_info.apiVersion = this->api_version;
 
   // Get extensions for SDL.
   if(!SDL_Vulkan_GetInstanceExtensions(
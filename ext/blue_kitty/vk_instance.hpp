@@ -31,12 +31,15 @@ class Instance
   { return this->surface; };
   inline VkInstance get_vk_instance() const
   { return this->vk_instance; };
+  inline uint32_t get_api_version() const
+  { return this->api_version; };
 
  private:
   Loader::Stack<Instance> loader;
   std::shared_ptr<bk_sCoreData> core_data;
   VkSurfaceKHR surface;
   VkInstance vk_instance;
+  uint32_t api_version;
 
   void load_vk_instance();
   void unload_vk_instance();
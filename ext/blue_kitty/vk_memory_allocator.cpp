@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: MIT
+#include "vk_memory_allocator.hpp"
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+namespace
+{
+uint32_t log2_ceil(VkDeviceSize value)
+{
+  uint32_t order{0};
+  while((static_cast<VkDeviceSize>(1) << order) < value) order++;
+  return order;
+}
+}
+
+namespace BKVK
+{
+// A single vkAllocateMemory split with the buddy system: every piece has a
+// power of two size and is aligned to its size, and a freed piece is merged
+// back with its buddy as soon as both are free.
+class MemoryBlock
+{
+ public:
+  VkDeviceMemory vk_device_memory;
+  uint8_t *mapped;
+  VkDeviceSize used_bytes;
+
+  MemoryBlock(VkDeviceMemory vk_device_memory, uint8_t *mapped,
+              uint32_t min_order, uint32_t max_order);
+
+  inline VkDeviceSize get_size() const
+  { return static_cast<VkDeviceSize>(1) << this->max_order; };
+  inline bool is_empty() const { return this->allocated.empty(); };
+
+  // Return false if there is no free piece big enough.
+  bool allocate(VkDeviceSize size, VkDeviceSize *offset);
+  void free(VkDeviceSize offset);
+
+ private:
+  uint32_t min_order, max_order;
+  // Free pieces of each order, indexed from min_order.
+  std::vector<std::set<VkDeviceSize>> free_pieces;
+  // Order of every allocated piece by offset.
+  std::unordered_map<VkDeviceSize, uint32_t> allocated;
+};
+
+MemoryBlock::MemoryBlock(VkDeviceMemory vk_device_memory, uint8_t *mapped,
+                         uint32_t min_order, uint32_t max_order):
+    vk_device_memory{vk_device_memory},
+    mapped{mapped},
+    used_bytes{0},
+    min_order{min_order},
+    max_order{max_order},
+    free_pieces(max_order - min_order + 1)
+{
+  this->free_pieces.back().insert(0);
+}
+
+bool MemoryBlock::allocate(VkDeviceSize size, VkDeviceSize *offset)
+{
+  uint32_t order{std::max(log2_ceil(size), this->min_order)};
+  if(order > this->max_order) return false;
+
+  // Find the smallest free piece that fits.
+  uint32_t found{order};
+  while(found <= this->max_order &&
+        this->free_pieces[found - this->min_order].empty())
+    found++;
+  if(found > this->max_order) return false;
+
+  auto &found_list{this->free_pieces[found - this->min_order]};
+  VkDeviceSize piece{*found_list.begin()};
+  found_list.erase(found_list.begin());
+
+  // Split it until it has the requested order, keeping the upper halves free.
+  while(found > order)
+  {
+    found--;
+    this->free_pieces[found - this->min_order].insert(
+        piece + (static_cast<VkDeviceSize>(1) << found));
+  }
+
+  this->allocated[piece] = order;
+  this->used_bytes += static_cast<VkDeviceSize>(1) << order;
+  *offset = piece;
+  return true;
+}
+
+void MemoryBlock::free(VkDeviceSize offset)
+{
+  auto allocated_piece{this->allocated.find(offset)};
+  uint32_t order{allocated_piece->second};
+  this->allocated.erase(allocated_piece);
+  this->used_bytes -= static_cast<VkDeviceSize>(1) << order;
+
+  while(order < this->max_order)
+  {
+    VkDeviceSize buddy{offset ^ (static_cast<VkDeviceSize>(1) << order)};
+    auto &list{this->free_pieces[order - this->min_order]};
+    auto buddy_piece{list.find(buddy)};
+    if(buddy_piece == list.end()) break;
+
+    list.erase(buddy_piece);
+    offset = std::min(offset, buddy);
+    order++;
+  }
+
+  this->free_pieces[order - this->min_order].insert(offset);
+}
+
+MemoryAllocator::MemoryAllocator(
+    VkDevice vk_device,
+    const VkPhysicalDeviceMemoryProperties &vk_memory_properties):
+    vk_device{vk_device},
+    vk_memory_properties(vk_memory_properties)
+{
+  this->heap_stats.resize(this->vk_memory_properties.memoryHeapCount);
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+  for(uint32_t memory_type{0}; memory_type < VK_MAX_MEMORY_TYPES;
+      memory_type++)
+    for(auto &kind_blocks: this->blocks[memory_type])
+      for(auto &block: kind_blocks)
+        vkFreeMemory(this->vk_device, block->vk_device_memory, nullptr);
+}
+
+MemoryAllocation MemoryAllocator::allocate(
+    const VkMemoryRequirements &vk_memory_requirements, uint32_t memory_type,
+    bool linear)
+{
+  MemoryAllocation allocation{};
+  allocation.size = vk_memory_requirements.size;
+  allocation.memory_type = memory_type;
+
+  // Buddy pieces are aligned to their own size.
+  VkDeviceSize piece_size{std::max(
+      vk_memory_requirements.size, vk_memory_requirements.alignment)};
+  VkDeviceSize block_size{this->block_size(memory_type)};
+
+  MemoryHeapStats &stats{this->heap_stats[
+      this->vk_memory_properties.memoryTypes[memory_type].heapIndex]};
+
+  // Resources bigger than half a block would waste most of it.
+  if(piece_size > block_size / 2)
+  {
+    allocation.vk_device_memory = this->allocate_device_memory(
+        vk_memory_requirements.size, memory_type, &allocation.mapped);
+    allocation.offset = 0;
+    allocation.block = nullptr;
+    stats.used_bytes += allocation.size;
+    stats.allocation_count++;
+    return allocation;
+  }
+
+  auto &kind_blocks{this->blocks[memory_type][linear ? 1 : 0]};
+  for(auto &block: kind_blocks)
+  {
+    if(block->allocate(piece_size, &allocation.offset))
+    {
+      allocation.block = block.get();
+      break;
+    }
+  }
+
+  if(!allocation.block)
+  {
+    uint8_t *mapped;
+    VkDeviceMemory vk_device_memory{this->allocate_device_memory(
+        block_size, memory_type, &mapped)};
+    kind_blocks.push_back(std::make_unique<MemoryBlock>(
+        vk_device_memory, mapped, log2_ceil(this->min_allocation_size),
+        log2_ceil(block_size)));
+    allocation.block = kind_blocks.back().get();
+    allocation.block->allocate(piece_size, &allocation.offset);
+    stats.block_count++;
+  }
+
+  allocation.vk_device_memory = allocation.block->vk_device_memory;
+  allocation.mapped = allocation.block->mapped ?
+      allocation.block->mapped + allocation.offset : nullptr;
+  stats.used_bytes += allocation.size;
+  stats.allocation_count++;
+
+  return allocation;
+}
+
+void MemoryAllocator::free(const MemoryAllocation &allocation)
+{
+  MemoryHeapStats &stats{this->heap_stats[
+      this->vk_memory_properties.memoryTypes[
+          allocation.memory_type].heapIndex]};
+  stats.used_bytes -= allocation.size;
+  stats.allocation_count--;
+
+  if(!allocation.block)
+  {
+    this->free_device_memory(
+        allocation.vk_device_memory, allocation.size, allocation.memory_type);
+    return;
+  }
+
+  allocation.block->free(allocation.offset);
+
+  // Keep one empty block of each kind so a resource that is created and
+  // destroyed every frame does not allocate device memory every time.
+  for(auto &kind_blocks: this->blocks[allocation.memory_type])
+  {
+    auto block{std::find_if(
+        kind_blocks.begin(), kind_blocks.end(),
+        [&allocation](const std::unique_ptr<MemoryBlock> &b)
+        { return b.get() == allocation.block; })};
+    if(block == kind_blocks.end()) continue;
+
+    if((*block)->is_empty() && kind_blocks.size() > 1)
+    {
+      this->free_device_memory((*block)->vk_device_memory,
+                               (*block)->get_size(), allocation.memory_type);
+      kind_blocks.erase(block);
+      stats.block_count--;
+    }
+    break;
+  }
+}
+
+VkDeviceSize MemoryAllocator::block_size(uint32_t memory_type) const
+{
+  const VkDeviceSize default_block_size{64 * 1024 * 1024};
+  VkDeviceSize heap_size{this->vk_memory_properties.memoryHeaps[
+      this->vk_memory_properties.memoryTypes[memory_type].heapIndex].size};
+
+  // Small heaps would be exhausted by a few big blocks.
+  VkDeviceSize size{default_block_size};
+  while(size > this->min_allocation_size && size > heap_size / 8) size /= 2;
+  return size;
+}
+
+VkDeviceMemory MemoryAllocator::allocate_device_memory(
+    VkDeviceSize size, uint32_t memory_type, uint8_t **mapped)
+{
+  VkMemoryAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.pNext = nullptr;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = memory_type;
+
+  VkDeviceMemory vk_device_memory;
+  if(vkAllocateMemory(this->vk_device, &alloc_info, nullptr,
+                      &vk_device_memory) != VK_SUCCESS)
+    throw Loader::Error{"Could not allocate Vulkan device memory."};
+
+  *mapped = nullptr;
+  if(this->vk_memory_properties.memoryTypes[memory_type].propertyFlags &
+     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+  {
+    void *data;
+    if(vkMapMemory(this->vk_device, vk_device_memory, 0, VK_WHOLE_SIZE, 0,
+                   &data) != VK_SUCCESS)
+    {
+      vkFreeMemory(this->vk_device, vk_device_memory, nullptr);
+      throw Loader::Error{"Could not map Vulkan device memory."};
+    }
+    *mapped = static_cast<uint8_t*>(data);
+  }
+
+  this->heap_stats[this->vk_memory_properties.memoryTypes[
+      memory_type].heapIndex].reserved_bytes += size;
+
+  return vk_device_memory;
+}
+
+void MemoryAllocator::free_device_memory(
+    VkDeviceMemory vk_device_memory, VkDeviceSize size, uint32_t memory_type)
+{
+  // Freeing memory implicitly unmaps it.
+  vkFreeMemory(this->vk_device, vk_device_memory, nullptr);
+  this->heap_stats[this->vk_memory_properties.memoryTypes[
+      memory_type].heapIndex].reserved_bytes -= size;
+}
+
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VK_MEMORY_ALLOCATOR_HPP
+#define BLUE_KITTY_VK_MEMORY_ALLOCATOR_HPP 1
+
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "loader.hpp"
+
+namespace BKVK
+{
+class MemoryBlock;
+
+// A region of device memory owned by a buffer or image.
+struct MemoryAllocation
+{
+  VkDeviceMemory vk_device_memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  // Null if the memory type is not host-visible.
+  uint8_t *mapped;
+  uint32_t memory_type;
+
+  // Null for resources too big to share a block.
+  MemoryBlock *block;
+};
+
+struct MemoryHeapStats
+{
+  // Device memory reserved from the driver, used or not.
+  VkDeviceSize reserved_bytes;
+  // Memory handed to buffers and images.
+  VkDeviceSize used_bytes;
+  uint32_t block_count;
+  uint32_t allocation_count;
+};
+
+/*
+  Reserve big blocks of device memory and split them between buffers and
+  images with a buddy allocator, so the engine does not call vkAllocateMemory
+  once per resource. Linear resources (buffers) and optimal-tiling resources
+  (images) never share a block, which satisfies bufferImageGranularity without
+  padding. Host-visible blocks are mapped for their whole lifetime since a
+  block can not be mapped twice.
+*/
+class MemoryAllocator
+{
+  MemoryAllocator(const MemoryAllocator &t) = delete;
+  MemoryAllocator& operator=(const MemoryAllocator &t) = delete;
+  MemoryAllocator(const MemoryAllocator &&t) = delete;
+  MemoryAllocator& operator=(const MemoryAllocator &&t) = delete;
+
+ public:
+  explicit MemoryAllocator(
+      VkDevice vk_device,
+      const VkPhysicalDeviceMemoryProperties &vk_memory_properties);
+  ~MemoryAllocator();
+
+  MemoryAllocation allocate(
+      const VkMemoryRequirements &vk_memory_requirements,
+      uint32_t memory_type, bool linear);
+  void free(const MemoryAllocation &allocation);
+
+  // One entry for each memory heap of the device.
+  inline const std::vector<MemoryHeapStats> &get_heap_stats() const
+  { return this->heap_stats; };
+
+ private:
+  VkDevice vk_device;
+  VkPhysicalDeviceMemoryProperties vk_memory_properties;
+  std::vector<MemoryHeapStats> heap_stats;
+
+  // Blocks of each memory type, index 0 for images and 1 for buffers.
+  std::vector<std::unique_ptr<MemoryBlock>> blocks[VK_MAX_MEMORY_TYPES][2];
+
+  // Smallest piece of a block given to a resource.
+  const VkDeviceSize min_allocation_size = 256;
+
+  VkDeviceSize block_size(uint32_t memory_type) const;
+  VkDeviceMemory allocate_device_memory(
+      VkDeviceSize size, uint32_t memory_type, uint8_t **mapped);
+  void free_device_memory(VkDeviceMemory vk_device_memory,
+                          VkDeviceSize size, uint32_t memory_type);
+};
+}
+
+#endif /* BLUE_KITTY_VK_MEMORY_ALLOCATOR_HPP */
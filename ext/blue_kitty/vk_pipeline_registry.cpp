@@ -0,0 +1,381 @@
+// SPDX-License-Identifier: MIT
+#include "vk_pipeline_registry.hpp"
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <sstream>
+
+#include "log.hpp"
+#include "vk_vertex.hpp"
+
+namespace BKVK
+{
+uint32_t PipelineState::key() const
+{
+  return static_cast<uint32_t>(this->shaders) |
+      static_cast<uint32_t>(this->vertex_layout) << 4 |
+      static_cast<uint32_t>(this->cull_mode) << 6 |
+      static_cast<uint32_t>(this->depth_test) << 8 |
+      static_cast<uint32_t>(this->depth_write) << 9 |
+      static_cast<uint32_t>(this->blend) << 10 |
+      static_cast<uint32_t>(this->topology) << 12;
+}
+
+PipelineRegistry::PipelineRegistry(
+    const std::shared_ptr<Device> &device,
+    const std::shared_ptr<GraphicPipelineLayout> &graphic_pipeline_layout,
+    VkRenderPass vk_render_pass):
+    device{device},
+    graphic_pipeline_layout{graphic_pipeline_layout},
+    vk_render_pass{vk_render_pass}
+{
+}
+
+PipelineRegistry::~PipelineRegistry()
+{
+  for(auto &thread: this->warm_threads) thread.join();
+
+  for(auto &pipeline: this->pipelines)
+  {
+    try
+    {
+      vkDestroyPipeline(this->device->get_vk_device(), pipeline.second.get(),
+                        nullptr);
+    }
+    catch(...)
+    {
+      // The pipeline failed to compile, there is nothing to destroy.
+    }
+  }
+}
+
+VkPipeline PipelineRegistry::get(const PipelineState &state)
+{
+  std::shared_future<VkPipeline> pipeline;
+  // Only a miss creates a promise, it allocates its shared state.
+  std::optional<std::promise<VkPipeline>> promise;
+  {
+    std::unique_lock<std::mutex> lock{this->pipelines_mutex};
+    auto found{this->pipelines.find(state.key())};
+    if(found == this->pipelines.end())
+    {
+      promise.emplace();
+      pipeline = promise->get_future().share();
+      this->pipelines.emplace(state.key(), pipeline);
+    }
+    else pipeline = found->second;
+  }
+
+  // Compile without the lock, so other states can be requested meanwhile.
+  if(promise)
+  {
+    try
+    {
+      promise->set_value(this->compile(state));
+    }
+    catch(...)
+    {
+      promise->set_exception(std::current_exception());
+    }
+  }
+
+  // Rethrows the error of a failed compilation.
+  return pipeline.get();
+}
+
+void PipelineRegistry::warm(const std::vector<PipelineState> &states)
+{
+  // Register the states now, so a get() before the thread starts waits for
+  // it instead of compiling the same pipeline.
+  std::vector<std::pair<PipelineState, std::promise<VkPipeline>>> missing;
+  {
+    std::unique_lock<std::mutex> lock{this->pipelines_mutex};
+    for(const auto &state: states)
+    {
+      if(this->pipelines.count(state.key()) > 0) continue;
+
+      missing.emplace_back(state, std::promise<VkPipeline>{});
+      this->pipelines.emplace(
+          state.key(), missing.back().second.get_future().share());
+    }
+  }
+  if(missing.empty()) return;
+
+  this->warm_threads.emplace_back(
+      [this](std::vector<std::pair<PipelineState, std::promise<VkPipeline>>>
+             missing)
+      {
+        for(auto &[state, promise]: missing)
+        {
+          try
+          {
+            promise.set_value(this->compile(state));
+          }
+          catch(...)
+          {
+            promise.set_exception(std::current_exception());
+          }
+        }
+      }, std::move(missing));
+}
+
+VkPipeline PipelineRegistry::compile(const PipelineState &state)
+{
+  bool quantized{state.vertex_layout == VertexLayout::quantized};
+
+  // Variants of a shader are specialization constants, not other modules.
+  VkBool32 vert_quantized{quantized ? VK_TRUE : VK_FALSE};
+  VkSpecializationMapEntry vert_specialization_entry{};
+  vert_specialization_entry.constantID = 0;
+  vert_specialization_entry.offset = 0;
+  vert_specialization_entry.size = sizeof(vert_quantized);
+
+  VkSpecializationInfo vert_specialization{};
+  vert_specialization.mapEntryCount = 1;
+  vert_specialization.pMapEntries = &vert_specialization_entry;
+  vert_specialization.dataSize = sizeof(vert_quantized);
+  vert_specialization.pData = &vert_quantized;
+
+  VkPipelineShaderStageCreateInfo vert_shader_stage_info = {};
+  vert_shader_stage_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  vert_shader_stage_info.pNext = nullptr;
+  vert_shader_stage_info.flags = 0;
+  vert_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  vert_shader_stage_info.module =
+      this->device->get_vk_shader_module(Shader::model_vert);
+  vert_shader_stage_info.pName = "main";
+  vert_shader_stage_info.pSpecializationInfo = &vert_specialization;
+
+  VkPipelineShaderStageCreateInfo frag_shader_stage_info = {};
+  frag_shader_stage_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  frag_shader_stage_info.pNext = nullptr;
+  frag_shader_stage_info.flags = 0;
+  frag_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  // The bindless variant reads textures from the texture table. It is a
+  // different module because its SPIR-V needs capabilities other devices
+  // may lack.
+  frag_shader_stage_info.module = this->device->get_vk_shader_module(
+      this->device->get_descriptor_indexing() ?
+      Shader::model_frag_bindless : Shader::model_frag);
+  frag_shader_stage_info.pName = "main";
+  frag_shader_stage_info.pSpecializationInfo = nullptr;
+
+  VkPipelineShaderStageCreateInfo shader_stages[] = {
+    vert_shader_stage_info,
+    frag_shader_stage_info
+  };
+
+  VkVertexInputBindingDescription vertex_input_binding{};
+  vertex_input_binding.binding = 0;
+  vertex_input_binding.stride = quantized ?
+      sizeof(QuantizedVertex) : sizeof(Vertex);
+  vertex_input_binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  // Both layouts put the normal and the texture coordinate after the
+  // position.
+  uint32_t position_size{quantized ?
+      sizeof(QuantizedVertex::position) : sizeof(Vertex::position)};
+
+  std::array<VkVertexInputAttributeDescription, 3> vertex_attribute{};
+  // Position.
+  vertex_attribute[0].location = 0;
+  vertex_attribute[0].binding = 0;
+  vertex_attribute[0].format = quantized ?
+      VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+  vertex_attribute[0].offset = 0;
+  // Normal.
+  vertex_attribute[1].location = 1;
+  vertex_attribute[1].binding = 0;
+  vertex_attribute[1].format = VK_FORMAT_R16G16_SNORM;
+  vertex_attribute[1].offset = position_size;
+  // Texture coordinate.
+  vertex_attribute[2].location = 2;
+  vertex_attribute[2].binding = 0;
+  vertex_attribute[2].format = VK_FORMAT_R16G16_SFLOAT;
+  vertex_attribute[2].offset = position_size + sizeof(Vertex::normal);
+
+  VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+  vertex_input_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertex_input_info.pNext = nullptr;
+  vertex_input_info.flags = 0;
+  vertex_input_info.vertexBindingDescriptionCount = 1;
+  vertex_input_info.pVertexBindingDescriptions = &vertex_input_binding;
+  vertex_input_info.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(vertex_attribute.size());
+  vertex_input_info.pVertexAttributeDescriptions = vertex_attribute.data();
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+  input_assembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly.pNext = nullptr;
+  input_assembly.flags = 0;
+  input_assembly.topology = state.topology;
+  input_assembly.primitiveRestartEnable = VK_FALSE;
+
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(
+      this->device->get_instance()->get_core_data()->screen_width);
+  viewport.height = static_cast<float>(
+      this->device->get_instance()->get_core_data()->screen_height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+
+  VkRect2D scissor = {};
+  scissor.offset = {0, 0};
+  scissor.extent = {
+    this->device->get_instance()->get_core_data()->screen_width,
+    this->device->get_instance()->get_core_data()->screen_height
+  };
+
+  VkPipelineViewportStateCreateInfo viewport_state = {};
+  viewport_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport_state.pNext = nullptr;
+  viewport_state.flags = 0;
+  viewport_state.viewportCount = 1;
+  viewport_state.pViewports = &viewport;
+  viewport_state.scissorCount = 1;
+  viewport_state.pScissors = &scissor;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer = {};
+  rasterizer.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.pNext = nullptr;
+  rasterizer.flags = 0;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.cullMode = state.cull_mode;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterizer.depthBiasEnable = VK_FALSE;
+  rasterizer.depthBiasConstantFactor = 0.0f;
+  rasterizer.depthBiasClamp = 0.0f;
+  rasterizer.depthBiasSlopeFactor = 0.0f;
+  rasterizer.lineWidth = 1.0f;
+
+  VkPipelineMultisampleStateCreateInfo multisampling = {};
+  multisampling.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.minSampleShading = 1.0f;
+  multisampling.pSampleMask = nullptr;
+  multisampling.alphaToCoverageEnable = VK_FALSE;
+  multisampling.alphaToOneEnable = VK_FALSE;
+
+  VkPipelineDepthStencilStateCreateInfo depth_stencil{};
+  depth_stencil.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depth_stencil.pNext = nullptr;
+  depth_stencil.flags = 0;
+  depth_stencil.depthTestEnable = state.depth_test ? VK_TRUE : VK_FALSE;
+  depth_stencil.depthWriteEnable = state.depth_write ? VK_TRUE : VK_FALSE;
+  depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  depth_stencil.depthBoundsTestEnable = VK_FALSE;
+  depth_stencil.stencilTestEnable = VK_FALSE;
+  depth_stencil.minDepthBounds = 0.0f;
+  depth_stencil.maxDepthBounds = 1.0f;
+
+  VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+  if(state.blend == BlendMode::alpha)
+  {
+    color_blend_attachment.blendEnable = VK_TRUE;
+    color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    color_blend_attachment.dstColorBlendFactor =
+        VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    color_blend_attachment.dstAlphaBlendFactor =
+        VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  }
+  else
+  {
+    color_blend_attachment.blendEnable = VK_FALSE;
+    color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  }
+  color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+  color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+  color_blend_attachment.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+  VkPipelineColorBlendStateCreateInfo color_blending = {};
+  color_blending.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  color_blending.pNext = nullptr;
+  color_blending.flags = 0;
+  color_blending.logicOpEnable = VK_FALSE;
+  color_blending.logicOp = VK_LOGIC_OP_COPY;
+  color_blending.attachmentCount = 1;
+  color_blending.pAttachments = &color_blend_attachment;
+  color_blending.blendConstants[0] = 0.0f;
+  color_blending.blendConstants[1] = 0.0f;
+  color_blending.blendConstants[2] = 0.0f;
+  color_blending.blendConstants[3] = 0.0f;
+
+  // The engine sets viewport and scissor when a frame begins.
+  VkDynamicState dynamic_states[] = {
+    VK_DYNAMIC_STATE_VIEWPORT,
+    VK_DYNAMIC_STATE_SCISSOR,
+    VK_DYNAMIC_STATE_LINE_WIDTH
+  };
+
+  VkPipelineDynamicStateCreateInfo dynamic_state_info = {};
+  dynamic_state_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic_state_info.dynamicStateCount = 3;
+  dynamic_state_info.pDynamicStates = dynamic_states;
+
+  VkGraphicsPipelineCreateInfo pipeline_info = {};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipeline_info.pNext = nullptr;
+  pipeline_info.flags = 0;
+  pipeline_info.stageCount = 2;
+  pipeline_info.pStages = shader_stages;
+  pipeline_info.pVertexInputState = &vertex_input_info;
+  pipeline_info.pInputAssemblyState = &input_assembly;
+  pipeline_info.pTessellationState = nullptr;
+  pipeline_info.pViewportState = &viewport_state;
+  pipeline_info.pRasterizationState = &rasterizer;
+  pipeline_info.pMultisampleState = &multisampling;
+  pipeline_info.pDepthStencilState = &depth_stencil;
+  pipeline_info.pColorBlendState = &color_blending;
+  pipeline_info.pDynamicState = &dynamic_state_info;
+  pipeline_info.layout =
+      this->graphic_pipeline_layout->get_vk_pipeline_layout();
+  pipeline_info.renderPass = this->vk_render_pass;
+  pipeline_info.subpass = 0;
+  pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+  pipeline_info.basePipelineIndex = -1;
+
+  auto start{std::chrono::steady_clock::now()};
+  VkPipeline vk_pipeline;
+  if(vkCreateGraphicsPipelines(
+         this->device->get_vk_device(), this->device->get_vk_pipeline_cache(),
+         1, &pipeline_info, nullptr, &vk_pipeline) != VK_SUCCESS)
+    throw Loader::Error{"Failed to create graphics pipeline."};
+
+  // Compare with a start without the cache file to see the time it saves.
+  if(this->device->get_instance()->get_core_data()->debug)
+  {
+    std::chrono::duration<double, std::milli> elapsed{
+      std::chrono::steady_clock::now() - start};
+    std::ostringstream txt;
+    txt << "Graphics pipeline " << std::hex << state.key() << std::dec <<
+        " created in " << elapsed.count() << " ms (" <<
+        this->device->get_pipeline_cache_loaded_size() <<
+        " bytes of pipeline cache loaded)";
+    BKGE::Log::standard(txt.str());
+  }
+
+  return vk_pipeline;
+}
+}
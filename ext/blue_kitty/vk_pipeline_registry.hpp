@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VK_PIPELINE_REGISTRY_HPP
+#define BLUE_KITTY_VK_PIPELINE_REGISTRY_HPP 1
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "vk_device.hpp"
+#include "vk_graphic_pipeline_layout.hpp"
+
+namespace BKVK
+{
+enum class ShaderSet: uint8_t
+{
+  model
+};
+
+enum class VertexLayout: uint8_t
+{
+  full, // Vertex
+  quantized // QuantizedVertex
+};
+
+enum class BlendMode: uint8_t
+{
+  opaque,
+  alpha
+};
+
+// Everything that makes two graphics pipelines of the engine different.
+struct PipelineState
+{
+  ShaderSet shaders;
+  VertexLayout vertex_layout;
+  VkCullModeFlags cull_mode;
+  bool depth_test;
+  bool depth_write;
+  BlendMode blend;
+  VkPrimitiveTopology topology;
+
+  // Pack every field in a few bits, equal states have equal keys.
+  uint32_t key() const;
+};
+
+/*
+  Create graphics pipelines the first time a state asks for them and keep
+  them until the render pass is destroyed. A pipeline can also be warmed on a
+  background thread before the first frame needs it; get() then waits for that
+  thread instead of compiling the pipeline again.
+*/
+class PipelineRegistry
+{
+  PipelineRegistry(const PipelineRegistry &t) = delete;
+  PipelineRegistry& operator=(const PipelineRegistry &t) = delete;
+  PipelineRegistry(const PipelineRegistry &&t) = delete;
+  PipelineRegistry& operator=(const PipelineRegistry &&t) = delete;
+
+ public:
+  explicit PipelineRegistry(
+      const std::shared_ptr<Device> &device,
+      const std::shared_ptr<GraphicPipelineLayout> &graphic_pipeline_layout,
+      VkRenderPass vk_render_pass);
+  ~PipelineRegistry();
+
+  // Does not allocate memory for states that were already requested.
+  VkPipeline get(const PipelineState &state);
+  // Compile the states that were never requested on a new thread.
+  void warm(const std::vector<PipelineState> &states);
+
+ private:
+  std::shared_ptr<Device> device;
+  std::shared_ptr<GraphicPipelineLayout> graphic_pipeline_layout;
+  VkRenderPass vk_render_pass;
+
+  std::mutex pipelines_mutex;
+  std::unordered_map<uint32_t, std::shared_future<VkPipeline>> pipelines;
+  std::vector<std::thread> warm_threads;
+
+  VkPipeline compile(const PipelineState &state);
+};
+}
+
+#endif /* BLUE_KITTY_VK_PIPELINE_REGISTRY_HPP */
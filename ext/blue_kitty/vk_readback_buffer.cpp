@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+#include "vk_readback_buffer.hpp"
+
+namespace BKVK
+{
+ReadbackBuffer::ReadbackBuffer(std::shared_ptr<Device> device,
+                               VkDeviceSize data_size):
+    initializer{this}
+{
+  this->device = device;
+  this->vk_device_size = data_size;
+  this->vk_buffer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  this->vk_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  // Reading uncached memory is slow.
+  this->vk_preferred_memory_properties = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+  this->initializer.add(&ReadbackBuffer::load_buffer,
+                        &ReadbackBuffer::unload_buffer);
+  this->initializer.add(&ReadbackBuffer::load_memory,
+                        &ReadbackBuffer::unload_memory);
+
+  try
+  {
+    this->initializer.load();
+  }
+  catch(Loader::Error le)
+  {
+    throw Loader::Error{"Could not initialize Vulkan readback buffer → " +
+          le.message};
+  }
+}
+
+ReadbackBuffer::~ReadbackBuffer()
+{
+  this->initializer.unload();
+}
+}
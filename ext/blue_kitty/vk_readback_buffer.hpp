@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VK_READBACK_BUFFER_HPP
+#define BLUE_KITTY_VK_READBACK_BUFFER_HPP 1
+
+#include <memory>
+
+#include "vk_base_buffer.hpp"
+
+namespace BKVK
+{
+// A host-visible buffer the GPU copies results into for the CPU to read,
+// after the fence of the commands that wrote it.
+class ReadbackBuffer: public BaseBuffer
+{
+  friend class Loader::Stack<ReadbackBuffer>;
+
+ public:
+  ReadbackBuffer(std::shared_ptr<Device> device, VkDeviceSize data_size);
+  ~ReadbackBuffer();
+
+  inline const uint8_t *get_mapped() const
+  { return this->memory_allocation.mapped; };
+
+ private:
+  Loader::Stack<ReadbackBuffer> initializer;
+};
+}
+
+#endif /* BLUE_KITTY_VK_READBACK_BUFFER_HPP */
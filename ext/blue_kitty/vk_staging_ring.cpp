@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: MIT
+#include "vk_staging_ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace BKVK
+{
+
+StagingRing::StagingRing(const std::shared_ptr<QueueFamily> &queue_family,
+                         VkDeviceSize ring_size, uint32_t slots_quantity):
+    loader{this},
+    queue_family{queue_family},
+    mapped_memory{nullptr},
+    head{0}
+{
+  this->device = queue_family->get_device();
+  this->vk_device_size = ring_size;
+  this->vk_buffer_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  this->vk_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  // Small enough for several uploads to be in flight at the same time.
+  this->max_chunk_size = ring_size / 4;
+  this->vk_fences.resize(slots_quantity);
+
+  this->loader.add(&StagingRing::load_buffer, &StagingRing::unload_buffer);
+  this->loader.add(&StagingRing::load_memory, &StagingRing::unload_memory);
+  this->loader.add(&StagingRing::load_memory_map,
+                   &StagingRing::unload_memory_map);
+  this->loader.add(&StagingRing::load_command_pool,
+                   &StagingRing::unload_command_pool);
+  this->loader.add(&StagingRing::load_fences, &StagingRing::unload_fences);
+
+  try
+  {
+    this->loader.load();
+  }
+  catch(Loader::Error le)
+  {
+    throw Loader::Error{"Could not initialize Vulkan staging ring → " +
+          le.message};
+  }
+}
+
+StagingRing::~StagingRing()
+{
+  this->loader.unload();
+}
+
+void StagingRing::copy_to_buffer(VkBuffer vk_dst_buffer,
+                                 VkDeviceSize dst_offset, const void *data,
+                                 VkDeviceSize size)
+{
+  const uint8_t *src_data{static_cast<const uint8_t*>(data)};
+
+  for(VkDeviceSize copied{0}; copied < size;)
+  {
+    VkDeviceSize chunk_size{std::min(size - copied, this->max_chunk_size)};
+
+    this->upload(
+        chunk_size, 4,
+        [&](uint8_t *dst_data){
+          memcpy(dst_data, src_data + copied, chunk_size);
+        },
+        [&](VkCommandBuffer vk_command_buffer, VkBuffer vk_src_buffer,
+            VkDeviceSize src_offset){
+          VkBufferCopy copy_region{};
+          copy_region.srcOffset = src_offset;
+          copy_region.dstOffset = dst_offset + copied;
+          copy_region.size = chunk_size;
+
+          vkCmdCopyBuffer(vk_command_buffer, vk_src_buffer, vk_dst_buffer, 1,
+                          &copy_region);
+        });
+
+    copied += chunk_size;
+  }
+}
+
+void StagingRing::reclaim()
+{
+  while(this->release_oldest(false));
+}
+
+void StagingRing::wait_idle()
+{
+  while(this->release_oldest(true));
+}
+
+void StagingRing::load_memory_map()
+{
+  // The allocator maps host-visible memory when it reserves it.
+  if(!this->memory_allocation.mapped)
+    throw Loader::Error{"Failed to map staging ring memory."};
+  this->mapped_memory = this->memory_allocation.mapped;
+}
+
+void StagingRing::unload_memory_map()
+{
+  this->mapped_memory = nullptr;
+}
+
+void StagingRing::load_command_pool()
+{
+  this->command_pool = std::make_unique<CommandPool>(
+      this->queue_family, this->vk_fences.size());
+  this->vk_command_buffers = this->command_pool->get_vk_command_buffers();
+}
+
+void StagingRing::unload_command_pool()
+{
+  this->vk_command_buffers.clear();
+  this->command_pool = nullptr;
+}
+
+void StagingRing::load_fences()
+{
+  VkFenceCreateInfo fence_info{};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_info.pNext = nullptr;
+  fence_info.flags = 0;
+
+  for(uint32_t i{0}; i < this->vk_fences.size(); i++)
+  {
+    if(vkCreateFence(this->device->get_vk_device(), &fence_info, nullptr,
+                     &this->vk_fences[i]) != VK_SUCCESS)
+    {
+      for(uint32_t ii{0}; ii < i; ii++)
+        vkDestroyFence(this->device->get_vk_device(), this->vk_fences[ii],
+                       nullptr);
+      throw Loader::Error{"Failed to create staging ring fences."};
+    }
+    this->free_slots.push_back(i);
+  }
+}
+
+void StagingRing::unload_fences()
+{
+  this->wait_idle();
+
+  for(auto vk_fence: this->vk_fences)
+    vkDestroyFence(this->device->get_vk_device(), vk_fence, nullptr);
+  this->free_slots.clear();
+}
+
+uint32_t StagingRing::acquire_slot()
+{
+  this->reclaim();
+  if(this->free_slots.empty()) this->release_oldest(true);
+
+  uint32_t slot{this->free_slots.back()};
+  this->free_slots.pop_back();
+  return slot;
+}
+
+VkDeviceSize StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+  if(size > this->vk_device_size)
+    throw Loader::Error{"Upload is bigger than the staging ring."};
+
+  while(true)
+  {
+    // When nothing is in flight the whole ring is free.
+    if(this->in_flight.empty())
+    {
+      this->head = size;
+      return 0;
+    }
+
+    VkDeviceSize tail{this->in_flight.front().begin};
+    VkDeviceSize offset{(this->head + alignment - 1) / alignment * alignment};
+
+    // Used memory is between tail and head, free memory is after head and
+    // before tail.
+    if(this->head > tail)
+    {
+      if(offset + size <= this->vk_device_size)
+      {
+        this->head = offset + size;
+        return offset;
+      }
+      if(size <= tail)
+      {
+        this->head = size;
+        return 0;
+      }
+    }
+    // Used memory wrapped around the end of the ring, free memory is between
+    // head and tail.
+    else if(this->head < tail && offset + size <= tail)
+    {
+      this->head = offset + size;
+      return offset;
+    }
+
+    this->release_oldest(true);
+  }
+}
+
+bool StagingRing::release_oldest(bool wait)
+{
+  if(this->in_flight.empty()) return false;
+
+  InFlight oldest{this->in_flight.front()};
+  VkFence vk_fence{this->vk_fences[oldest.slot]};
+
+  if(wait)
+    vkWaitForFences(this->device->get_vk_device(), 1, &vk_fence, VK_TRUE,
+                    std::numeric_limits<uint64_t>::max());
+  else if(vkGetFenceStatus(this->device->get_vk_device(), vk_fence) !=
+          VK_SUCCESS)
+    return false;
+
+  this->free_slots.push_back(oldest.slot);
+  this->in_flight.pop_front();
+  return true;
+}
+
+void StagingRing::submit(uint32_t slot, VkDeviceSize begin)
+{
+  auto queue{this->queue_family->get_queue()};
+
+  vkResetFences(this->device->get_vk_device(), 1, &this->vk_fences[slot]);
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.pNext = nullptr;
+  submit_info.waitSemaphoreCount = 0;
+  submit_info.pWaitSemaphores = nullptr;
+  submit_info.pWaitDstStageMask = nullptr;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &this->vk_command_buffers[slot];
+  submit_info.signalSemaphoreCount = 0;
+  submit_info.pSignalSemaphores = nullptr;
+
+  if(vkQueueSubmit(queue->get_vk_queue(), 1, &submit_info,
+                   this->vk_fences[slot]) != VK_SUCCESS)
+  {
+    this->free_slots.push_back(slot);
+    throw Loader::Error{"Failed to submit staging ring upload."};
+  }
+
+  this->in_flight.push_back({begin, slot});
+}
+
+}
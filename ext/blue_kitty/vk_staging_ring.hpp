@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VK_STAGING_RING_HPP
+#define BLUE_KITTY_VK_STAGING_RING_HPP 1
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "loader.hpp"
+#include "vk_base_buffer.hpp"
+#include "vk_command_pool.hpp"
+#include "vk_queue_family.hpp"
+
+namespace BKVK
+{
+/*
+  A fixed-size host-visible buffer that is mapped for its whole lifetime.
+  Uploads reserve a region of the ring, write their data into it, and record
+  the transfer commands. The region is reclaimed after the fence of the upload
+  signals, so staging memory never grows beyond the ring size.
+*/
+class StagingRing: public BaseBuffer
+{
+  friend class Loader::Stack<StagingRing>;
+
+  StagingRing(const StagingRing &t) = delete;
+  StagingRing& operator=(const StagingRing &t) = delete;
+  StagingRing(const StagingRing &&t) = delete;
+  StagingRing& operator=(const StagingRing &&t) = delete;
+
+ public:
+  explicit StagingRing(const std::shared_ptr<QueueFamily> &queue_family,
+                       VkDeviceSize ring_size, uint32_t slots_quantity);
+  ~StagingRing();
+
+  inline std::shared_ptr<QueueFamily> get_queue_family() const
+  { return this->queue_family; };
+  // Uploads bigger than this must be split into several chunks.
+  inline VkDeviceSize get_max_chunk_size() const
+  { return this->max_chunk_size; };
+  inline bool is_idle() const { return this->in_flight.empty(); };
+
+  // Reserve "size" bytes from the ring. "write" receives a pointer to the
+  // reserved memory and must fill it, "commands" receives the command buffer,
+  // the ring buffer and the offset of the reserved region and must record the
+  // transfer.
+  template<typename W, typename C>
+  void upload(VkDeviceSize size, VkDeviceSize alignment, W write,
+              C commands);
+
+  // Record and submit commands that do not need staging memory, like a
+  // layout transition.
+  template<typename C>
+  void submit_commands(C commands);
+
+  // Copy data of any size into a buffer, splitting it if necessary.
+  void copy_to_buffer(VkBuffer vk_dst_buffer, VkDeviceSize dst_offset,
+                      const void *data, VkDeviceSize size);
+
+  // Free space of uploads that are already finished without blocking.
+  void reclaim();
+  // Block until all uploads are finished.
+  void wait_idle();
+
+ private:
+  struct InFlight
+  {
+    VkDeviceSize begin;
+    uint32_t slot;
+  };
+
+  Loader::Stack<StagingRing> loader;
+
+  std::shared_ptr<QueueFamily> queue_family;
+  std::unique_ptr<CommandPool> command_pool;
+  std::vector<VkCommandBuffer> vk_command_buffers;
+  std::vector<VkFence> vk_fences;
+  std::vector<uint32_t> free_slots;
+  std::deque<InFlight> in_flight;
+
+  uint8_t *mapped_memory;
+  VkDeviceSize head;
+  VkDeviceSize max_chunk_size;
+
+  void load_memory_map();
+  void unload_memory_map();
+
+  void load_command_pool();
+  void unload_command_pool();
+
+  void load_fences();
+  void unload_fences();
+
+  uint32_t acquire_slot();
+  VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment);
+  bool release_oldest(bool wait);
+  void submit(uint32_t slot, VkDeviceSize begin);
+};
+
+template<typename W, typename C>
+void StagingRing::upload(VkDeviceSize size, VkDeviceSize alignment, W write,
+                         C commands)
+{
+  uint32_t slot{this->acquire_slot()};
+  VkDeviceSize offset;
+
+  try
+  {
+    offset = this->allocate(size, alignment);
+  }
+  catch(Loader::Error le)
+  {
+    this->free_slots.push_back(slot);
+    throw;
+  }
+
+  VkCommandBuffer vk_command_buffer{this->vk_command_buffers[slot]};
+
+  write(this->mapped_memory + offset);
+
+  VkCommandBufferBeginInfo buffer_begin_info{};
+  buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(vk_command_buffer, &buffer_begin_info);
+
+  commands(vk_command_buffer, this->vk_buffer, offset);
+
+  vkEndCommandBuffer(vk_command_buffer);
+
+  this->submit(slot, offset);
+}
+
+template<typename C>
+void StagingRing::submit_commands(C commands)
+{
+  uint32_t slot{this->acquire_slot()};
+  VkCommandBuffer vk_command_buffer{this->vk_command_buffers[slot]};
+
+  VkCommandBufferBeginInfo buffer_begin_info{};
+  buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(vk_command_buffer, &buffer_begin_info);
+
+  commands(vk_command_buffer);
+
+  vkEndCommandBuffer(vk_command_buffer);
+
+  // Nothing was reserved, so the ring does not advance.
+  this->submit(slot, this->head);
+}
+
+}
+
+#endif /* BLUE_KITTY_VK_STAGING_RING_HPP */
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+#include "vk_storage_buffer.hpp"
+
+namespace BKVK
+{
+StorageBuffer::StorageBuffer(std::shared_ptr<Device> device,
+                             VkDeviceSize data_size):
+    initializer{this}
+{
+  this->device = device;
+  this->vk_device_size = data_size;
+  this->vk_buffer_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  this->vk_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  if(this->device->get_direct_upload())
+    this->vk_preferred_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+  this->initializer.add(&StorageBuffer::load_buffer,
+                        &StorageBuffer::unload_buffer);
+  this->initializer.add(&StorageBuffer::load_memory,
+                        &StorageBuffer::unload_memory);
+
+  try
+  {
+    this->initializer.load();
+  }
+  catch(Loader::Error le)
+  {
+    throw Loader::Error{"Could not initialize Vulkan storage buffer → " +
+          le.message};
+  }
+}
+
+StorageBuffer::~StorageBuffer()
+{
+  this->initializer.unload();
+}
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VK_STORAGE_BUFFER_HPP
+#define BLUE_KITTY_VK_STORAGE_BUFFER_HPP 1
+
+#include <memory>
+
+#include "vk_base_buffer.hpp"
+
+namespace BKVK
+{
+// A host-visible buffer shaders read as an array of any size. The CPU writes
+// only the part a frame uses, straight into the mapped memory.
+class StorageBuffer: public BaseBuffer
+{
+  friend class Loader::Stack<StorageBuffer>;
+
+ public:
+  StorageBuffer(std::shared_ptr<Device> device, VkDeviceSize data_size);
+  ~StorageBuffer();
+
+  inline uint8_t *get_mapped() const
+  { return this->memory_allocation.mapped; };
+
+ private:
+  Loader::Stack<StorageBuffer> initializer;
+};
+}
+
+#endif /* BLUE_KITTY_VK_STORAGE_BUFFER_HPP */
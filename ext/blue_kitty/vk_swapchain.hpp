@@ -26,7 +26,7 @@ class Swapchain
   { return this->vk_swapchain; };
   inline  VkFormat get_vk_image_format() const
   { return this->vk_image_format; };
-  inline std::vector<VkImageView> get_vk_image_views() const
+  inline const std::vector<VkImageView> &get_vk_image_views() const
   { return this->vk_image_views; };
 
  private:
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: MIT
+#include "vk_texture_table.hpp"
+
+namespace BKVK
+{
+TextureTable::TextureTable(const std::shared_ptr<Device> &device):
+    loader{this},
+    device{device},
+    size{device->get_max_bindless_textures()}
+{
+  for(uint32_t i{0}; i < this->size; i++) this->free_slots.push_back(i);
+
+  this->loader.add(&TextureTable::load_descriptor_set_layout,
+                   &TextureTable::unload_descriptor_set_layout);
+  this->loader.add(&TextureTable::load_pool, &TextureTable::unload_pool);
+  this->loader.add(&TextureTable::load_set, &TextureTable::unload_set);
+
+  try
+  {
+    this->loader.load();
+  }
+  catch(Loader::Error le)
+  {
+    throw Loader::Error{"Could not initialize Vulkan texture table → " +
+          le.message};
+  }
+}
+
+TextureTable::~TextureTable()
+{
+  this->loader.unload();
+}
+
+uint32_t TextureTable::add(VkImageView vk_image_view, VkSampler vk_sampler)
+{
+  if(this->free_slots.empty())
+    throw Loader::Error{"Texture table is full."};
+
+  uint32_t index{this->free_slots.front()};
+  this->free_slots.pop_front();
+
+  VkDescriptorImageInfo image_info{};
+  image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  image_info.imageView = vk_image_view;
+  image_info.sampler = vk_sampler;
+
+  VkWriteDescriptorSet write_descriptor{};
+  write_descriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write_descriptor.dstSet = this->vk_descriptor_set;
+  write_descriptor.dstBinding = 0;
+  write_descriptor.dstArrayElement = index;
+  write_descriptor.descriptorCount = 1;
+  write_descriptor.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write_descriptor.pBufferInfo = nullptr;
+  write_descriptor.pImageInfo = &image_info;
+  write_descriptor.pTexelBufferView = nullptr;
+
+  vkUpdateDescriptorSets(
+      this->device->get_vk_device(), 1, &write_descriptor, 0, nullptr);
+
+  return index;
+}
+
+void TextureTable::remove(uint32_t index)
+{
+  // The descriptor is partially bound, so a stale slot is harmless as long as
+  // no draw selects it.
+  this->free_slots.push_back(index);
+}
+
+void TextureTable::load_descriptor_set_layout()
+{
+  VkDescriptorSetLayoutBinding layout_binding{};
+  layout_binding.binding = 0;
+  layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  layout_binding.descriptorCount = this->size;
+  layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  layout_binding.pImmutableSamplers = nullptr;
+
+  VkDescriptorBindingFlagsEXT binding_flags{
+    VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+    VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+    VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT};
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info{};
+  binding_flags_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  binding_flags_info.pNext = nullptr;
+  binding_flags_info.bindingCount = 1;
+  binding_flags_info.pBindingFlags = &binding_flags;
+
+  VkDescriptorSetLayoutCreateInfo layout_info{};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.pNext = &binding_flags_info;
+  layout_info.flags =
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+  layout_info.bindingCount = 1;
+  layout_info.pBindings = &layout_binding;
+
+  if(vkCreateDescriptorSetLayout(
+         this->device->get_vk_device(), &layout_info, nullptr,
+         &this->vk_descriptor_set_layout) != VK_SUCCESS)
+    throw Loader::Error{
+      "Failed to create Vulkan descriptor set layout for texture table."};
+}
+
+void TextureTable::unload_descriptor_set_layout()
+{
+  vkDestroyDescriptorSetLayout(this->device->get_vk_device(),
+                               this->vk_descriptor_set_layout, nullptr);
+}
+
+void TextureTable::load_pool()
+{
+  VkDescriptorPoolSize descriptor_pool_size{};
+  descriptor_pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptor_pool_size.descriptorCount = this->size;
+
+  VkDescriptorPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.pNext = nullptr;
+  pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+  pool_info.maxSets = 1;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &descriptor_pool_size;
+
+  if(vkCreateDescriptorPool(
+         this->device->get_vk_device(), &pool_info, nullptr,
+         &this->vk_descriptor_pool) != VK_SUCCESS)
+    throw Loader::Error{
+      "Failed to create a Vulkan descriptor pool for texture table."};
+}
+
+void TextureTable::unload_pool()
+{
+  vkDestroyDescriptorPool(this->device->get_vk_device(),
+                          this->vk_descriptor_pool, nullptr);
+}
+
+void TextureTable::load_set()
+{
+  VkDescriptorSetAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = this->vk_descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &this->vk_descriptor_set_layout;
+
+  if(vkAllocateDescriptorSets(
+         this->device->get_vk_device(), &alloc_info,
+         &this->vk_descriptor_set) != VK_SUCCESS)
+    throw Loader::Error{
+      "Failed to create Vulkan descriptor set for texture table."};
+}
+
+void TextureTable::unload_set()
+{
+  // The set is freed together with its pool.
+}
+
+}
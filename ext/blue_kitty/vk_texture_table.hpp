@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: MIT
+#ifndef BLUE_KITTY_VK_TEXTURE_TABLE_HPP
+#define BLUE_KITTY_VK_TEXTURE_TABLE_HPP 1
+
+#include <deque>
+#include <memory>
+
+#include "loader.hpp"
+#include "vk_device.hpp"
+
+namespace BKVK
+{
+/*
+  A single descriptor set with an array of every loaded texture. Shaders
+  select a texture by its index, so drawing a model with a different texture
+  does not require binding another descriptor set. It is only available when
+  the device supports descriptor indexing.
+*/
+class TextureTable
+{
+  friend class Loader::Stack<TextureTable>;
+
+  TextureTable(const TextureTable &t) = delete;
+  TextureTable& operator=(const TextureTable &t) = delete;
+  TextureTable(const TextureTable &&t) = delete;
+  TextureTable& operator=(const TextureTable &&t) = delete;
+
+ public:
+  explicit TextureTable(const std::shared_ptr<Device> &device);
+  ~TextureTable();
+
+  inline std::shared_ptr<Device> get_device() const
+  { return this->device; };
+  inline uint32_t get_size() const { return this->size; };
+  inline VkDescriptorSetLayout get_vk_descriptor_set_layout() const
+  { return this->vk_descriptor_set_layout; };
+  inline VkDescriptorSet get_vk_descriptor_set() const
+  { return this->vk_descriptor_set; };
+
+  // Write the texture into a free slot and return its index.
+  uint32_t add(VkImageView vk_image_view, VkSampler vk_sampler);
+  // The slot is not written again until every other free slot was used, so
+  // frames still in flight never see it change.
+  void remove(uint32_t index);
+
+ private:
+  Loader::Stack<TextureTable> loader;
+
+  std::shared_ptr<Device> device;
+  uint32_t size;
+  std::deque<uint32_t> free_slots;
+
+  VkDescriptorSetLayout vk_descriptor_set_layout;
+  VkDescriptorPool vk_descriptor_pool;
+  VkDescriptorSet vk_descriptor_set;
+
+  void load_descriptor_set_layout();
+  void unload_descriptor_set_layout();
+
+  void load_pool();
+  void unload_pool();
+
+  void load_set();
+  void unload_set();
+};
+}
+
+#endif /* BLUE_KITTY_VK_TEXTURE_TABLE_HPP */
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: MIT
 #include "vk_uniform_buffer.hpp"
 
+#include <cstring>
+
 namespace BKVK
 {
 UniformBuffer::UniformBuffer(std::shared_ptr<Device> device,
@@ -12,6 +14,9 @@ UniformBuffer::UniformBuffer(std::shared_ptr<Device> device,
   this->vk_buffer_usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
   this->vk_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  // Shaders read instance data faster from video memory.
+  if(this->device->get_direct_upload())
+    this->vk_preferred_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
   this->initializer.add(&UniformBuffer::load_buffer,
                         &UniformBuffer::unload_buffer);
@@ -36,10 +41,7 @@ UniformBuffer::~UniformBuffer()
 
 void UniformBuffer::copy_data(void *ubo)
 {
-  void *data;
-  vkMapMemory(this->device->get_vk_device(), this->vk_device_memory, 0,
-              this->vk_device_size, 0, &data);
-  memcpy(data, ubo, this->vk_device_size);
-  vkUnmapMemory(this->device->get_vk_device(), this->vk_device_memory);
+  // Host-visible memory stays mapped by the allocator.
+  memcpy(this->memory_allocation.mapped, ubo, this->vk_device_size);
 }
 }
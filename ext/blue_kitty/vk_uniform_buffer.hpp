@@ -10,11 +10,6 @@
 
 namespace BKVK
 {
-struct UBOModelInstance
-{
-  glm::mat4 model[128];
-};
-
 struct UBOViewProjection
 {
   glm::mat4 view;
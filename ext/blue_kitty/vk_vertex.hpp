@@ -2,17 +2,74 @@
 #ifndef BLUE_KITTY_VK_VERTEX_H
 #define BLUE_KITTY_VK_VERTEX_H 1
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 
 namespace BKVK
 {
+  // Normals are octahedral encoded snorm16x2 and texture coordinates are
+  // half-floats. Color is not a vertex attribute, it is the same for every
+  // vertex of a mesh and is sent with each draw.
   typedef struct Vertex_t
   {
     glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texture_coord;
-    glm::vec3 color;
+    int16_t normal[2];
+    uint16_t texture_coord[2];
   } Vertex;
+
+  // Same as Vertex, but the position is unorm16 relative to the bounds of the
+  // geometry. The fourth component only keeps the attribute aligned.
+  typedef struct QuantizedVertex_t
+  {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t texture_coord[2];
+  } QuantizedVertex;
+
+  inline int16_t pack_snorm16(float value)
+  {
+    return static_cast<int16_t>(
+        std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+  }
+
+  inline uint16_t pack_unorm16(float value)
+  {
+    return static_cast<uint16_t>(
+        std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+  }
+
+  // Project the unit vector into an octahedron and unfold it into a square.
+  inline void pack_normal(const glm::vec3 &normal, int16_t packed[2])
+  {
+    float sum{std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z)};
+    if(sum == 0.0f)
+    {
+      packed[0] = packed[1] = 0;
+      return;
+    }
+
+    float x{normal.x / sum}, y{normal.y / sum};
+    if(normal.z < 0.0f)
+    {
+      float folded_x{(1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f)};
+      float folded_y{(1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f)};
+      x = folded_x;
+      y = folded_y;
+    }
+
+    packed[0] = pack_snorm16(x);
+    packed[1] = pack_snorm16(y);
+  }
+
+  inline void pack_texture_coord(const glm::vec2 &coord, uint16_t packed[2])
+  {
+    packed[0] = glm::packHalf1x16(coord.x);
+    packed[1] = glm::packHalf1x16(coord.y);
+  }
 }
 
 #endif /* BLUE_KITTY_VK_VERTEX_H */
@@ -18,6 +18,8 @@ module BlueKitty
       end
 
       @position = new_position
+      # The engine caches a matrix made from the old vector.
+      @transform&.invalidate
     end
 
     def rotation=(new_rotation)
@@ -26,6 +28,7 @@ module BlueKitty
       end
 
       @rotation = new_rotation
+      @transform&.invalidate
     end
   end
 end
@@ -18,6 +18,24 @@ module BlueKitty
     #   Integer value each: +:major+, +:minor+ and +:patch+. These values are
     #   used by Vulkan.
     #
+    # It may also contain:
+    #
+    # - memory_budget: an Integer with how many bytes of video memory the game
+    #   may use before the engine unloads textures and models that were not
+    #   drawn recently. If missing, the budget reported by the driver is used.
+    # - quantize_positions: a boolean value, if true vertex positions are
+    #   stored with 16 bits per axis relative to the bounds of each model.
+    #   Saves video memory but loses precision on big models. Default false.
+    # - lod_screen_sizes: an Array with up to three decreasing Floats between
+    #   0 and 1. Models are simplified when loaded, each level of detail with
+    #   about half the triangles of the one before; level i + 1 is drawn when
+    #   a model covers less than the i-th value of the screen height. An empty
+    #   Array disables levels of detail. Default [0.25, 0.125, 0.0625].
+    # - occlusion_culling: a boolean value, if true models hidden behind
+    #   others in a recent frame are not drawn. The test uses depth one or two
+    #   frames old, so a model uncovered by a fast move may appear a frame
+    #   late. Default true.
+    #
     # @param file_path [String] path to yaml file
     # @author Frederico Linhares
     def self.load_configuration(config_path)
@@ -63,6 +81,37 @@ module BlueKitty
               "that zero"
       end
 
+      if config.has_key?(:memory_budget) and
+        ((not config[:memory_budget].is_a?(Integer)) or
+         (config[:memory_budget] < 0)) then
+        raise BlueKitty::Error,
+              "Failed to parse configuration file: 'memory_budget' must be "\
+              "an Integer bigger or equal to zero"
+      end
+
+      # Force value to be boolean.
+      config[:quantize_positions] = !! config[:quantize_positions]
+
+      lod_error_message =
+        "Failed to parse configuration file: 'lod_screen_sizes' must be an "\
+        "Array with up to three decreasing Floats between 0 and 1"
+      config[:lod_screen_sizes] ||= [0.25, 0.125, 0.0625]
+      if(not config[:lod_screen_sizes].is_a?(Array)) or
+        (config[:lod_screen_sizes].size > 3) then
+        raise BlueKitty::Error, lod_error_message
+      end
+      config[:lod_screen_sizes].each_with_index do |size, i|
+        if(not size.is_a?(Numeric)) or (size <= 0) or (size >= 1) or
+          (i > 0 and size >= config[:lod_screen_sizes][i - 1]) then
+          raise BlueKitty::Error, lod_error_message
+        end
+      end
+
+      # Force value to be boolean.
+      config[:occlusion_culling] = true unless
+        config.has_key?(:occlusion_culling)
+      config[:occlusion_culling] = !! config[:occlusion_culling]
+
       @@configurations = config
     end
 